@@ -0,0 +1,49 @@
+/*
+ CRC32Builder.h - incremental CRC-32
+
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ESP8266_CRC32_BUILDER__
+#define __ESP8266_CRC32_BUILDER__
+
+#include <Print.h>
+#include <coredecls.h>
+
+// Same CRC as crc32(), over everything added or printed since begin():
+//   CRC32Builder crc;
+//   crc.printf("%u;%d\n", ts, value);
+//   crc.add(payload, len);
+//   record.crc = crc.getCRC();
+class CRC32Builder: public Print
+{
+public:
+    CRC32Builder () { begin(); }
+
+    void begin () { _crc = 0xffffffff; }
+    void add (const void* data, size_t len) { _crc = crc32(data, len, _crc); }
+    uint32_t getCRC () const { return _crc; }
+
+    size_t write (uint8_t c) override { add(&c, 1); return 1; }
+    size_t write (const uint8_t* data, size_t len) override { add(data, len); return len; }
+
+protected:
+    uint32_t _crc;
+};
+
+#endif // __ESP8266_CRC32_BUILDER__
@@ -24,6 +24,7 @@
 #include <memory>
 #include "interrupts.h"
 #include "MD5Builder.h"
+#include "FlashHash.h"
 #include "umm_malloc/umm_malloc.h"
 #include "cont.h"
 #include "coredecls.h"
@@ -602,7 +603,16 @@ bool EspClass::updateSketch(Stream& in, uint32_t size, bool restartOnFail, bool
 
 static const int FLASH_INT_MASK = ((B10 << 8) | B00111010);
 
+// FlashHash.cpp overrides this, and is always linked in by getSketchMD5()
+// below: the no-op only keeps Esp.cpp usable without it
+extern "C" void flash_hash_invalidate(uint32_t address, uint32_t size) __attribute__((weak));
+extern "C" void flash_hash_invalidate(uint32_t address, uint32_t size) {
+    (void) address;
+    (void) size;
+}
+
 bool EspClass::flashEraseSector(uint32_t sector) {
+    flash_hash_invalidate(sector * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE);
     int rc = spi_flash_erase_sector(sector);
     return rc == 0;
 }
@@ -652,6 +662,7 @@ static SpiFlashOpResult spi_flash_write_puya(uint32_t offset, uint32_t *data, si
 #endif
 
 bool EspClass::flashWrite(uint32_t offset, uint32_t *data, size_t size) {
+    flash_hash_invalidate(offset, size);
     SpiFlashOpResult rc = SPI_FLASH_RESULT_OK;
 #if PUYA_SUPPORT
     if (getFlashChipVendorId() == SPI_FLASH_VENDOR_PUYA) {
@@ -672,29 +683,9 @@ bool EspClass::flashRead(uint32_t offset, uint32_t *data, size_t size) {
 
 String EspClass::getSketchMD5()
 {
-    static String result;
-    if (result.length()) {
-        return result;
-    }
-    uint32_t lengthLeft = getSketchSize();
-    const size_t bufSize = 512;
-    std::unique_ptr<uint8_t[]> buf(new uint8_t[bufSize]);
-    uint32_t offset = 0;
-    if(!buf.get()) {
+    uint8_t md5[16];
+    if (!FlashHash.getSketch(FlashHashType::MD5, md5)) {
         return String();
     }
-    MD5Builder md5;
-    md5.begin();
-    while( lengthLeft > 0) {
-        size_t readBytes = (lengthLeft < bufSize) ? lengthLeft : bufSize;
-        if (!flashRead(offset, reinterpret_cast<uint32_t*>(buf.get()), (readBytes + 3) & ~3)) {
-            return String();
-        }
-        md5.add(buf.get(), readBytes);
-        lengthLeft -= readBytes;
-        offset += readBytes;
-    }
-    md5.calculate();
-    result = md5.toString();
-    return result;
+    return FlashHashClass::toString(md5, sizeof(md5));
 }
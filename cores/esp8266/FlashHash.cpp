@@ -0,0 +1,330 @@
+/*
+ FlashHash.cpp - cached and incremental hashing of flash regions
+
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <Arduino.h>
+#include "FlashHash.h"
+#include "Schedule.h"
+#include "base16.h"
+#include "coredecls.h"
+#include "md5.h"
+#ifndef FLASH_HASH_NO_SHA256
+#include <bearssl/bearssl_hash.h>
+#endif
+
+extern "C" uint32_t _FS_start;
+extern "C" uint32_t _FS_end;
+
+struct FlashHashClass::Job
+{
+    Job* next;
+    FlashHashType type;
+    uint32_t address;
+    uint32_t size;
+    uint32_t done;
+    Callback cb;
+    union
+    {
+        uint32_t crc;
+        md5_context_t md5;
+#ifndef FLASH_HASH_NO_SHA256
+        br_sha256_context sha256;
+#endif
+    } ctx;
+};
+
+static bool overlaps (uint32_t a, uint32_t aSize, uint32_t b, uint32_t bSize)
+{
+    return a < b + bSize && b < a + aSize;
+}
+
+size_t FlashHashClass::length (FlashHashType type)
+{
+    switch (type)
+    {
+    case FlashHashType::CRC32:
+        return 4;
+    case FlashHashType::MD5:
+        return 16;
+#ifndef FLASH_HASH_NO_SHA256
+    case FlashHashType::SHA256:
+        return 32;
+#endif
+    default:
+        return 0;
+    }
+}
+
+String FlashHashClass::toString (const uint8_t* digest, size_t length)
+{
+    return base16::encode(digest, length);
+}
+
+FlashHashClass::Entry* FlashHashClass::find (FlashHashType type, uint32_t address, uint32_t size)
+{
+    for (Entry& e : _cache)
+        if (e.lastUse && e.type == type && e.address == address && e.size == size)
+            return &e;
+    return nullptr;
+}
+
+bool FlashHashClass::cached (FlashHashType type, uint32_t address, uint32_t size, uint8_t* digest)
+{
+    Entry* e = find(type, address, size);
+    if (!e)
+        return false;
+    e->lastUse = ++_uses;
+    memcpy(digest, e->digest, length(type));
+    return true;
+}
+
+void FlashHashClass::store (const Job* job, const uint8_t* digest)
+{
+    Entry* e = find(job->type, job->address, job->size);
+    if (!e)
+    {
+        // least recently used, unused ones first
+        e = &_cache[0];
+        for (Entry& c : _cache)
+            if (c.lastUse < e->lastUse)
+                e = &c;
+    }
+    e->type = job->type;
+    e->address = job->address;
+    e->size = job->size;
+    e->lastUse = ++_uses;
+    memcpy(e->digest, digest, length(job->type));
+}
+
+// Hashes up to maxBytes more, returns 1 when digest is ready, 0 when there
+// is more to do, -1 on read error
+int FlashHashClass::step (Job* job, uint32_t maxBytes, uint8_t* digest)
+{
+    if (!job->done)
+    {
+        switch (job->type)
+        {
+        case FlashHashType::CRC32:
+            job->ctx.crc = 0xffffffff;
+            break;
+        case FlashHashType::MD5:
+            MD5Init(&job->ctx.md5);
+            break;
+#ifndef FLASH_HASH_NO_SHA256
+        case FlashHashType::SHA256:
+            br_sha256_init(&job->ctx.sha256);
+            break;
+#endif
+        default:
+            break;
+        }
+    }
+
+    uint32_t buf[64];
+    uint32_t end = job->done + std::min(maxBytes, job->size - job->done);
+    while (job->done < end)
+    {
+        uint32_t n = std::min((uint32_t)sizeof(buf), end - job->done);
+        if (!ESP.flashRead(job->address + job->done, buf, (n + 3) & ~3))
+            return -1;
+        switch (job->type)
+        {
+        case FlashHashType::CRC32:
+            job->ctx.crc = crc32(buf, n, job->ctx.crc);
+            break;
+        case FlashHashType::MD5:
+            MD5Update(&job->ctx.md5, (const uint8_t*)buf, n);
+            break;
+#ifndef FLASH_HASH_NO_SHA256
+        case FlashHashType::SHA256:
+            br_sha256_update(&job->ctx.sha256, buf, n);
+            break;
+#endif
+        default:
+            break;
+        }
+        job->done += n;
+    }
+    if (job->done < job->size)
+        return 0;
+
+    switch (job->type)
+    {
+    case FlashHashType::CRC32:
+        for (int i = 0; i < 4; i++)
+            digest[i] = job->ctx.crc >> (24 - 8 * i);
+        break;
+    case FlashHashType::MD5:
+        MD5Final(digest, &job->ctx.md5);
+        break;
+#ifndef FLASH_HASH_NO_SHA256
+    case FlashHashType::SHA256:
+        br_sha256_out(&job->ctx.sha256, digest);
+        break;
+#endif
+    default:
+        break;
+    }
+    store(job, digest);
+    return 1;
+}
+
+void FlashHashClass::complete (Job* job, const uint8_t* digest)
+{
+    for (Job** link = &_first, *prev = nullptr; *link; prev = *link, link = &(*link)->next)
+        if (*link == job)
+        {
+            *link = job->next;
+            if (_last == job)
+                _last = prev;
+            break;
+        }
+    if (job->cb)
+        job->cb(digest, digest? length(job->type): 0);
+    delete job;
+}
+
+bool FlashHashClass::runBackground ()
+{
+    if (_first)
+    {
+        uint8_t digest[FLASH_HASH_MAX_LENGTH];
+        Job* job = _first;
+        int ret = 1;
+        // an identical request may have completed meanwhile
+        if (job->done || !cached(job->type, job->address, job->size, digest))
+            ret = step(job, FLASH_HASH_SLICE_BYTES, digest);
+        if (ret)
+            complete(job, ret > 0? digest: nullptr);
+    }
+    _scheduled = _first != nullptr;
+    return _scheduled;
+}
+
+bool FlashHashClass::get (FlashHashType type, uint32_t address, uint32_t size, uint8_t* digest)
+{
+    if (!length(type) || (address & 3))
+        return false;
+    if (cached(type, address, size, digest))
+        return true;
+
+    // finish a background request of the same region instead of starting over
+    for (Job* job = _first; job; job = job->next)
+        if (job->type == type && job->address == address && job->size == size)
+        {
+            int ret = step(job, ~0U, digest);
+            complete(job, ret > 0? digest: nullptr);
+            return ret > 0;
+        }
+
+    Job job;
+    job.type = type;
+    job.address = address;
+    job.size = size;
+    job.done = 0;
+    return step(&job, ~0U, digest) > 0;
+}
+
+bool FlashHashClass::request (FlashHashType type, uint32_t address, uint32_t size, Callback cb)
+{
+    if (!length(type) || (address & 3))
+        return false;
+
+    uint8_t digest[FLASH_HASH_MAX_LENGTH];
+    if (cached(type, address, size, digest))
+    {
+        if (cb)
+            cb(digest, length(type));
+        return true;
+    }
+
+    Job* job = new (std::nothrow) Job;
+    if (!job)
+        return false;
+    job->next = nullptr;
+    job->type = type;
+    job->address = address;
+    job->size = size;
+    job->done = 0;
+    job->cb = cb;
+    if (_last)
+        _last->next = job;
+    else
+        _first = job;
+    _last = job;
+
+    if (!_scheduled)
+    {
+        _scheduled = schedule_recurrent_function_us([this]() { return runBackground(); }, 0);
+        if (!_scheduled)
+        {
+            complete(job, nullptr);
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t FlashHashClass::pending () const
+{
+    size_t count = 0;
+    for (Job* job = _first; job; job = job->next)
+        count++;
+    return count;
+}
+
+void FlashHashClass::invalidate (uint32_t address, uint32_t size)
+{
+    for (Entry& e : _cache)
+        if (e.lastUse && overlaps(e.address, e.size, address, size))
+            e.lastUse = 0;
+    for (Job* job = _first; job; job = job->next)
+        if (overlaps(job->address, job->size, address, size))
+            job->done = 0;
+}
+
+bool FlashHashClass::getSketch (FlashHashType type, uint8_t* digest)
+{
+    return get(type, 0, ESP.getSketchSize(), digest);
+}
+
+bool FlashHashClass::requestSketch (FlashHashType type, Callback cb)
+{
+    return request(type, 0, ESP.getSketchSize(), cb);
+}
+
+bool FlashHashClass::getFS (FlashHashType type, uint8_t* digest)
+{
+    return get(type, (uintptr_t)&_FS_start - 0x40200000, (uintptr_t)&_FS_end - (uintptr_t)&_FS_start, digest);
+}
+
+bool FlashHashClass::requestFS (FlashHashType type, Callback cb)
+{
+    return request(type, (uintptr_t)&_FS_start - 0x40200000, (uintptr_t)&_FS_end - (uintptr_t)&_FS_start, cb);
+}
+
+// Called by ESP.flashWrite(), ESP.flashEraseSector() and SPIEraseAreaEx(),
+// overrides the weak no-op of Esp.cpp
+extern "C" void flash_hash_invalidate (uint32_t address, uint32_t size)
+{
+    FlashHash.invalidate(address, size);
+}
+
+FlashHashClass FlashHash;
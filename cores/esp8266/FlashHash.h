@@ -0,0 +1,114 @@
+/*
+ FlashHash.h - cached and incremental hashing of flash regions
+
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __ESP8266_FLASH_HASH__
+#define __ESP8266_FLASH_HASH__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <WString.h>
+
+// Hashes flash regions (the sketch, the filesystem partition or any 4 byte
+// aligned range) either at once with get(), or in the background with
+// request(): FLASH_HASH_SLICE_BYTES are hashed from a recurrent scheduled
+// function at every yield()/loop(), and get() on a region being hashed
+// finishes the job instead of starting over.
+//
+// The last FLASH_HASH_CACHE_SIZE results are kept until ESP.flashWrite() or
+// ESP.flashEraseSector() touches their region (the Updater, filesystems and
+// EEPROM all go through them).
+//
+//   void setup() {
+//       FlashHash.requestSketch(FlashHashType::MD5); // ESP.getSketchMD5() is then immediate
+//   }
+
+enum class FlashHashType: uint8_t
+{
+    CRC32,  // crc32() value, 4 bytes MSB first
+    MD5,    // 16 bytes
+    SHA256, // 32 bytes, BearSSL (not with FLASH_HASH_NO_SHA256)
+};
+
+#define FLASH_HASH_MAX_LENGTH 32
+
+#ifndef FLASH_HASH_CACHE_SIZE
+#define FLASH_HASH_CACHE_SIZE 4
+#endif
+
+#ifndef FLASH_HASH_SLICE_BYTES
+#define FLASH_HASH_SLICE_BYTES 2048
+#endif
+
+class FlashHashClass
+{
+public:
+    // Called from CONT when a request() completes, digest is nullptr on error
+    using Callback = std::function<void(const uint8_t* digest, size_t length)>;
+
+    static size_t length (FlashHashType type);
+    static String toString (const uint8_t* digest, size_t length);
+
+    // Blocking, returns the cached digest when there is one
+    bool get (FlashHashType type, uint32_t address, uint32_t size, uint8_t* digest);
+    // Hash in the background, cb may be called before returning on cache hits
+    bool request (FlashHashType type, uint32_t address, uint32_t size, Callback cb = nullptr);
+    // Only looks at the cache
+    bool cached (FlashHashType type, uint32_t address, uint32_t size, uint8_t* digest);
+    // Requests not completed yet
+    size_t pending () const;
+
+    // Forget results for regions overlapping [address, address + size)
+    void invalidate (uint32_t address, uint32_t size);
+
+    bool getSketch (FlashHashType type, uint8_t* digest);
+    bool requestSketch (FlashHashType type, Callback cb = nullptr);
+    bool getFS (FlashHashType type, uint8_t* digest);
+    bool requestFS (FlashHashType type, Callback cb = nullptr);
+
+protected:
+    struct Entry
+    {
+        FlashHashType type;
+        uint32_t address;
+        uint32_t size;
+        uint32_t lastUse; // 0: unused
+        uint8_t digest[FLASH_HASH_MAX_LENGTH];
+    };
+
+    struct Job;
+
+    Entry* find (FlashHashType type, uint32_t address, uint32_t size);
+    void store (const Job* job, const uint8_t* digest);
+    int step (Job* job, uint32_t maxBytes, uint8_t* digest);
+    void complete (Job* job, const uint8_t* digest);
+    bool runBackground ();
+
+    Entry _cache[FLASH_HASH_CACHE_SIZE];
+    uint32_t _uses;
+    Job* _first;
+    Job* _last;
+    bool _scheduled;
+};
+
+extern FlashHashClass FlashHash;
+
+#endif // __ESP8266_FLASH_HASH__
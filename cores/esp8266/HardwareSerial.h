@@ -95,12 +95,21 @@ public:
 
     void updateBaudRate(unsigned long baud);
 
+    // Rounded up to a power of 2
     size_t setRxBufferSize(size_t size);
     size_t getRxBufferSize()
     {
         return uart_get_rx_buffer_size(_uart);
     }
 
+    // Interrupt driven transmit: write() returns as soon as the data fits
+    // in the buffer, flush() waits until it is sent. 0 (default) disables it.
+    size_t setTxBufferSize(size_t size);
+    size_t getTxBufferSize()
+    {
+        return uart_get_tx_buffer_size(_uart);
+    }
+
     void swap()
     {
         swap(1);
@@ -192,6 +201,27 @@ public:
         return uart_has_rx_error(_uart);
     }
 
+    // After begin(): receive interrupt after fifoFull bytes (default 16), or
+    // after timeout character times of silence (default 0: disabled). Lower
+    // values for latency, higher ones for fewer interrupts at high speed.
+    void setRxThresholds(uint8_t fifoFull, uint8_t timeout = 0)
+    {
+        uart_set_rx_thresholds(_uart, fifoFull, timeout);
+    }
+
+    // Receive counters since begin() or resetRxStats()
+    uart_rx_stats_t getRxStats(void)
+    {
+        uart_rx_stats_t stats = { };
+        uart_get_rx_stats(_uart, &stats);
+        return stats;
+    }
+
+    void resetRxStats(void)
+    {
+        uart_reset_rx_stats(_uart);
+    }
+
     void startDetectBaudrate();
 
     unsigned long testBaudrate();
@@ -202,6 +232,7 @@ protected:
     int _uart_nr;
     uart_t* _uart = nullptr;
     size_t _rx_size;
+    size_t _tx_size;
 };
 
 extern HardwareSerial Serial;
@@ -1,11 +1,6 @@
 #include <Arduino.h>
 #include <MD5Builder.h>
-
-uint8_t hex_char_to_byte(uint8_t c){
-    return  (c >= 'a' && c <= 'f') ? (c - ((uint8_t)'a' - 0xa)) :
-            (c >= 'A' && c <= 'F') ? (c - ((uint8_t)'A' - 0xA)) :
-            (c >= '0' &&  c<= '9') ? (c - (uint8_t)'0') : 0;
-}
+#include <base16.h>
 
 void MD5Builder::begin(void){
     memset(_buf, 0x00, 16);
@@ -17,44 +12,46 @@ void MD5Builder::add(const uint8_t * data, const uint16_t len){
 }
 
 void MD5Builder::addHexString(const char * data){
-    uint16_t i, len = strlen(data);
-    uint8_t * tmp = (uint8_t*)malloc(len/2);
-    if(tmp == NULL) {
-        return;
-    }
-    for(i=0; i<len; i+=2) {
-        uint8_t high = hex_char_to_byte(data[i]);
-        uint8_t low = hex_char_to_byte(data[i+1]);
-        tmp[i/2] = (high & 0x0F) << 4 | (low & 0x0F);
+    // decoded in blocks, the bytes before the first invalid digit are
+    // hashed, a lone last digit is ignored
+    uint8_t buf[32];
+    size_t len = strlen(data) & ~1;
+    for(size_t i = 0; i < len; i += 2 * sizeof(buf)) {
+        size_t n = std::min(len - i, 2 * sizeof(buf));
+        size_t valid = 0;
+        while(valid < n && isxdigit((unsigned char)data[i + valid])) {
+            valid++;
+        }
+        valid &= ~1;
+        if(valid) {
+            add(buf, base16::decode(data + i, valid, buf, sizeof(buf)));
+        }
+        if(valid < n) {
+            return;
+        }
     }
-    add(tmp, len/2);
-    free(tmp);
 }
 
 bool MD5Builder::addStream(Stream & stream, const size_t maxLen){
-    const int buf_size = 512;
-    int maxLengthLeft = maxLen;
-    uint8_t * buf = (uint8_t*) malloc(buf_size);
-
-    if(!buf) {
-        return false;
-    }
+    // on the stack rather than a heap buffer per call
+    uint8_t buf[128];
+    size_t maxLengthLeft = maxLen;
 
     int bytesAvailable = stream.available();
     while((bytesAvailable > 0) && (maxLengthLeft > 0)) {
 
         // determine number of bytes to read
-        int readBytes = bytesAvailable;
+        size_t readBytes = bytesAvailable;
         if(readBytes > maxLengthLeft) {
             readBytes = maxLengthLeft ;    // read only until max_len
         }
-        if(readBytes > buf_size) {
-            readBytes = buf_size;    // not read more the buffer can handle
+        if(readBytes > sizeof(buf)) {
+            readBytes = sizeof(buf);    // not read more the buffer can handle
         }
 
         // read data and check if we got something
-        int numBytesRead = stream.readBytes(buf, readBytes);
-        if(numBytesRead< 1) {
+        size_t numBytesRead = stream.readBytes(buf, readBytes);
+        if(numBytesRead < 1) {
             return false;
         }
 
@@ -67,7 +64,6 @@ bool MD5Builder::addStream(Stream & stream, const size_t maxLen){
         maxLengthLeft -= numBytesRead;
         bytesAvailable = stream.available();
     }
-    free(buf);
     return true;
 }
 
@@ -80,9 +76,7 @@ void MD5Builder::getBytes(uint8_t * output){
 }
 
 void MD5Builder::getChars(char * output){
-    for(uint8_t i = 0; i < 16; i++) {
-        sprintf(output + (i * 2), "%02x", _buf[i]);
-    }
+    base16::encode(_buf, 16, output);
 }
 
 String MD5Builder::toString(void){
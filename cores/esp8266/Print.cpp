@@ -29,6 +29,471 @@
 
 #include "Print.h"
 
+// Formatted output ////////////////////////////////////////////////////////////
+
+// Writes n right-aligned ending at end, at least minDigits digits, and
+// returns the first one. There is no hardware divider: two digits are
+// produced per division, the second one with a multiplication.
+static char* formatDecimal(char *end, uint32_t n, int minDigits) {
+    char *str = end;
+    while (n >= 100) {
+        uint32_t q = n / 100;
+        uint32_t r = n - 100 * q;
+        uint32_t t = (r * 103) >> 10; // r / 10 for r < 100
+        *--str = '0' + r - 10 * t;
+        *--str = '0' + t;
+        n = q;
+    }
+    if (n >= 10) {
+        uint32_t t = (n * 103) >> 10;
+        *--str = '0' + n - 10 * t;
+        *--str = '0' + t;
+    } else {
+        *--str = '0' + n;
+    }
+    while (end - str < minDigits)
+        *--str = '0';
+    return str;
+}
+
+static char* formatDigits(char *end, unsigned long long n, unsigned base, bool upper) {
+    if (base == 10) {
+        // 64 bit divisions are slow, take 9 digits at a time
+        while (n > 0xffffffffULL) {
+            unsigned long long q = n / 1000000000;
+            end = formatDecimal(end, n - q * 1000000000, 9);
+            n = q;
+        }
+        return formatDecimal(end, n, 1);
+    }
+    const char letters = (upper ? 'A' : 'a') - 10;
+    if (!(base & (base - 1))) {
+        int shift = __builtin_ctz(base);
+        do {
+            unsigned d = n & (base - 1);
+            *--end = d < 10 ? '0' + d : letters + d;
+            n >>= shift;
+        } while (n);
+        return end;
+    }
+    do {
+        unsigned long long q = n / base;
+        unsigned d = n - q * base;
+        *--end = d < 10 ? '0' + d : letters + d;
+        n = q;
+    } while (n);
+    return end;
+}
+
+// a * b - p, exactly, where p is a * b rounded (Dekker's product)
+static double productError(double a, double b, double p) {
+    const double split = 134217729.0; // 2^27 + 1
+    double t = split * a;
+    double ah = t - (t - a);
+    double al = a - ah;
+    t = split * b;
+    double bh = t - (t - b);
+    double bl = b - bh;
+    return ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+}
+
+// Integer and fractional digits of 0 <= x < 2^31 with prec <= 9 decimals,
+// rounded like the C library does: to the nearest value, ties to even,
+// deciding on the exact binary value of x
+static void fixedDigits(double x, int prec, uint32_t &ip, uint32_t &fp) {
+    uint32_t scale = 1;
+    for (int i = 0; i < prec; i++)
+        scale *= 10;
+    double integer = floor(x);
+    double frac = x - integer; // exact
+    double scaled = frac * scale;
+    double rounded = floor(scaled);
+    double half = scaled - rounded;
+    ip = integer;
+    fp = rounded;
+    bool up = half > 0.5;
+    if (half == 0.5) {
+        // only the rounding error of the product can tell
+        double err = productError(frac, scale, scaled);
+        up = err > 0 || (err == 0 && ((prec ? fp : ip) & 1));
+    }
+    if (up && ++fp == scale) {
+        fp = 0;
+        ip++;
+    }
+}
+
+static inline bool isFlash(const char *str) {
+#ifdef CORE_MOCK
+    (void) str;
+    return false;
+#else
+    return (uintptr_t) str >= 0x40200000;
+#endif
+}
+
+namespace {
+
+// printf() engine: conversions are done in place and the output is handed
+// to Print::write(buffer, size) in blocks of up to 64 bytes. Nothing is
+// formatted twice and nothing is allocated, except for the floating point
+// conversions left to the C library (%e, %g, %f out of the fast path) when
+// their result exceeds 40 characters.
+class PrintFormatter {
+public:
+    PrintFormatter(Print &out) : _out(out), _len(0), _total(0), _failed(false) {
+    }
+
+    size_t format(const char *fmt, bool pgm, va_list arg);
+
+private:
+    enum {
+        LEFT  = 1,
+        PLUS  = 2,
+        SPACE = 4,
+        ALT   = 8,
+        ZERO  = 16,
+    };
+
+    void put(char c) {
+        if (_len == sizeof(_buf))
+            flush();
+        _buf[_len++] = c;
+    }
+    void put(const char *str, size_t len, bool pgm);
+    void fill(char c, int count);
+    void field(const char *prefix, int zeros, const char *body, size_t len, int width, int flags);
+    void integer(unsigned long long n, const char *prefix, unsigned base, bool upper, int width, int prec, int flags);
+    void floating(double x, char conv, int width, int prec, int flags);
+    void flush();
+
+    Print &_out;
+    size_t _len;
+    size_t _total;
+    bool _failed;
+    char _buf[64] __attribute__((aligned(4)));
+};
+
+void PrintFormatter::flush() {
+    if (_len && !_failed) {
+        size_t written = _out.write((const uint8_t*) _buf, _len);
+        _total += written;
+        _failed = written != _len;
+    }
+    _len = 0;
+}
+
+void PrintFormatter::put(const char *str, size_t len, bool pgm) {
+    if (len >= sizeof(_buf) && !(pgm && isFlash(str))) {
+        // large RAM blocks go straight through
+        flush();
+        if (!_failed) {
+            size_t written = _out.write((const uint8_t*) str, len);
+            _total += written;
+            _failed = written != len;
+        }
+        return;
+    }
+    while (len) {
+        if (_len == sizeof(_buf))
+            flush();
+        size_t chunk = std::min(len, sizeof(_buf) - _len);
+        if (pgm)
+            memcpy_P(_buf + _len, str, chunk);
+        else
+            memcpy(_buf + _len, str, chunk);
+        _len += chunk;
+        str += chunk;
+        len -= chunk;
+    }
+}
+
+void PrintFormatter::fill(char c, int count) {
+    while (count > 0) {
+        if (_len == sizeof(_buf))
+            flush();
+        int chunk = std::min(count, (int) (sizeof(_buf) - _len));
+        memset(_buf + _len, c, chunk);
+        _len += chunk;
+        count -= chunk;
+    }
+}
+
+void PrintFormatter::field(const char *prefix, int zeros, const char *body, size_t len, int width, int flags) {
+    size_t prefixLen = strlen(prefix);
+    int pad = width - (int) (prefixLen + zeros + len);
+    if (!(flags & (LEFT | ZERO)))
+        fill(' ', pad);
+    put(prefix, prefixLen, false);
+    if ((flags & (LEFT | ZERO)) == ZERO)
+        fill('0', pad);
+    fill('0', zeros);
+    put(body, len, false);
+    if (flags & LEFT)
+        fill(' ', pad);
+}
+
+void PrintFormatter::integer(unsigned long long n, const char *prefix, unsigned base, bool upper, int width, int prec, int flags) {
+    char buf[8 * sizeof(n) / 3 + 1];
+    char *end = &buf[sizeof(buf)];
+    char *digits = (n || prec) ? formatDigits(end, n, base, upper) : end;
+    int len = end - digits;
+    int zeros = prec > len ? prec - len : 0;
+    if (base == 8 && (flags & ALT) && !zeros && (!len || *digits != '0'))
+        zeros = 1;
+    if (prec >= 0)
+        flags &= ~ZERO;
+    field(prefix, zeros, digits, len, width, flags);
+}
+
+void PrintFormatter::floating(double x, char conv, int width, int prec, int flags) {
+    if ((conv == 'f' || conv == 'F') && prec <= 9 && fabs(x) < 2147483648.0) {
+        uint32_t ip, fp;
+        if (prec < 0)
+            prec = 6;
+        fixedDigits(fabs(x), prec, ip, fp);
+        char buf[20];
+        char *end = &buf[sizeof(buf)];
+        char *str = end;
+        if (prec)
+            str = formatDecimal(str, fp, prec);
+        if (prec || (flags & ALT))
+            *--str = '.';
+        str = formatDecimal(str, ip, 1);
+        const char *sign = signbit(x) ? "-" : (flags & PLUS) ? "+" : (flags & SPACE) ? " " : "";
+        field(sign, 0, str, end - str, width, flags);
+        return;
+    }
+
+    char spec[12];
+    char *s = spec;
+    *s++ = '%';
+    if (flags & LEFT)
+        *s++ = '-';
+    if (flags & PLUS)
+        *s++ = '+';
+    if (flags & SPACE)
+        *s++ = ' ';
+    if (flags & ALT)
+        *s++ = '#';
+    if (flags & ZERO)
+        *s++ = '0';
+    *s++ = '*';
+    *s++ = '.';
+    *s++ = '*';
+    *s++ = conv;
+    *s = 0;
+
+    // a negative precision is taken as omitted
+    char buf[40];
+    int len = snprintf(buf, sizeof(buf), spec, width, prec, x);
+    if (len < (int) sizeof(buf)) {
+        put(buf, std::max(len, 0), false);
+        return;
+    }
+    char *big = new char[len + 1];
+    if (big) {
+        snprintf(big, len + 1, spec, width, prec, x);
+        put(big, len, false);
+        delete[] big;
+    }
+}
+
+size_t PrintFormatter::format(const char *fmt, bool pgm, va_list arg) {
+    auto peek = [&]() -> char {
+        return pgm ? pgm_read_byte(fmt) : *fmt;
+    };
+    auto next = [&]() -> char {
+        char c = peek();
+        fmt++;
+        return c;
+    };
+
+    for (;;) {
+        const char *text = fmt;
+        if (pgm) {
+            while (peek() && peek() != '%')
+                fmt++;
+        } else {
+            fmt += strcspn(fmt, "%");
+        }
+        put(text, fmt - text, pgm);
+        if (!peek() || _failed)
+            break;
+        fmt++;
+
+        int flags = 0;
+        for (;; fmt++) {
+            char c = peek();
+            if (c == '-')
+                flags |= LEFT;
+            else if (c == '+')
+                flags |= PLUS;
+            else if (c == ' ')
+                flags |= SPACE;
+            else if (c == '#')
+                flags |= ALT;
+            else if (c == '0')
+                flags |= ZERO;
+            else
+                break;
+        }
+
+        int width = 0;
+        if (peek() == '*') {
+            fmt++;
+            width = va_arg(arg, int);
+            if (width < 0) {
+                flags |= LEFT;
+                width = -width;
+            }
+        } else {
+            while (peek() >= '0' && peek() <= '9')
+                width = 10 * width + (next() - '0');
+        }
+
+        int prec = -1;
+        if (peek() == '.') {
+            fmt++;
+            prec = 0;
+            if (peek() == '*') {
+                fmt++;
+                prec = va_arg(arg, int);
+                if (prec < 0)
+                    prec = -1;
+            } else {
+                while (peek() >= '0' && peek() <= '9')
+                    prec = 10 * prec + (next() - '0');
+            }
+        }
+
+        // length modifier: 'H' hh, 'l' l, 'q' ll, 'L', 'j', 'z', 't'
+        char size = 0;
+        switch (peek()) {
+        case 'h':
+        case 'l':
+            size = peek();
+            fmt++;
+            if (peek() == size) {
+                size = size == 'h' ? 'H' : 'q';
+                fmt++;
+            }
+            break;
+        case 'L':
+        case 'j':
+        case 'z':
+        case 't':
+        case 'q':
+            size = peek();
+            fmt++;
+            break;
+        }
+
+        char conv = peek();
+        if (!conv)
+            break;
+        fmt++;
+
+        switch (conv) {
+        case 'd':
+        case 'i': {
+            long long n;
+            switch (size) {
+            case 'H': n = (signed char) va_arg(arg, int); break;
+            case 'h': n = (short) va_arg(arg, int); break;
+            case 'l': n = va_arg(arg, long); break;
+            case 'q':
+            case 'L': n = va_arg(arg, long long); break;
+            case 'j': n = va_arg(arg, intmax_t); break;
+            case 'z':
+            case 't': n = va_arg(arg, ptrdiff_t); break;
+            default: n = va_arg(arg, int); break;
+            }
+            const char *sign = n < 0 ? "-" : (flags & PLUS) ? "+" : (flags & SPACE) ? " " : "";
+            integer(n < 0 ? -(unsigned long long) n : n, sign, 10, false, width, prec, flags);
+            break;
+        }
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o': {
+            unsigned long long n;
+            switch (size) {
+            case 'H': n = (unsigned char) va_arg(arg, unsigned); break;
+            case 'h': n = (unsigned short) va_arg(arg, unsigned); break;
+            case 'l': n = va_arg(arg, unsigned long); break;
+            case 'q':
+            case 'L': n = va_arg(arg, unsigned long long); break;
+            case 'j': n = va_arg(arg, uintmax_t); break;
+            case 'z':
+            case 't': n = va_arg(arg, size_t); break;
+            default: n = va_arg(arg, unsigned); break;
+            }
+            unsigned base = conv == 'u' ? 10 : conv == 'o' ? 8 : 16;
+            const char *prefix = (base == 16 && (flags & ALT) && n) ? (conv == 'X' ? "0X" : "0x") : "";
+            integer(n, prefix, base, conv == 'X', width, prec, flags);
+            break;
+        }
+        case 'p':
+            integer((uintptr_t) va_arg(arg, void*), "0x", 16, false, width, prec, flags);
+            break;
+        case 'c': {
+            char c = va_arg(arg, int);
+            field("", 0, &c, 1, width, flags & LEFT);
+            break;
+        }
+        case 's': {
+            // may be a PROGMEM string
+            const char *str = va_arg(arg, const char*);
+            if (!str)
+                str = "(null)";
+            size_t len = strnlen_P(str, prec >= 0 ? (size_t) prec : SIZE_MAX);
+            if (!(flags & LEFT))
+                fill(' ', width - (int) len);
+            put(str, len, true);
+            if (flags & LEFT)
+                fill(' ', width - (int) len);
+            break;
+        }
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            floating(size == 'L' ? (double) va_arg(arg, long double) : va_arg(arg, double), conv, width, prec, flags);
+            break;
+        case 'n': {
+            size_t count = _total + _len;
+            switch (size) {
+            case 'H': *va_arg(arg, signed char*) = count; break;
+            case 'h': *va_arg(arg, short*) = count; break;
+            case 'l': *va_arg(arg, long*) = count; break;
+            case 'q': *va_arg(arg, long long*) = count; break;
+            case 'z': *va_arg(arg, size_t*) = count; break;
+            default: *va_arg(arg, int*) = count; break;
+            }
+            break;
+        }
+        case '%':
+            put('%');
+            break;
+        default:
+            // unknown conversion, shown as is
+            put('%');
+            put(conv);
+            break;
+        }
+    }
+
+    flush();
+    return _total;
+}
+
+} // namespace
+
 // Public Methods //////////////////////////////////////////////////////////////
 
 /* default implementation: may be overridden */
@@ -58,49 +523,27 @@ size_t Print::write(const uint8_t *buffer, size_t size) {
 size_t Print::printf(const char *format, ...) {
     va_list arg;
     va_start(arg, format);
-    char temp[64];
-    char* buffer = temp;
-    size_t len = vsnprintf(temp, sizeof(temp), format, arg);
+    size_t len = vprintf(format, arg);
     va_end(arg);
-    if (len > sizeof(temp) - 1) {
-        buffer = new char[len + 1];
-        if (!buffer) {
-            return 0;
-        }
-        va_start(arg, format);
-        vsnprintf(buffer, len + 1, format, arg);
-        va_end(arg);
-    }
-    len = write((const uint8_t*) buffer, len);
-    if (buffer != temp) {
-        delete[] buffer;
-    }
     return len;
 }
 
 size_t Print::printf_P(PGM_P format, ...) {
     va_list arg;
     va_start(arg, format);
-    char temp[64];
-    char* buffer = temp;
-    size_t len = vsnprintf_P(temp, sizeof(temp), format, arg);
+    size_t len = vprintf_P(format, arg);
     va_end(arg);
-    if (len > sizeof(temp) - 1) {
-        buffer = new char[len + 1];
-        if (!buffer) {
-            return 0;
-        }
-        va_start(arg, format);
-        vsnprintf_P(buffer, len + 1, format, arg);
-        va_end(arg);
-    }
-    len = write((const uint8_t*) buffer, len);
-    if (buffer != temp) {
-        delete[] buffer;
-    }
     return len;
 }
 
+size_t Print::vprintf(const char *format, va_list arg) {
+    return PrintFormatter(*this).format(format, false, arg);
+}
+
+size_t Print::vprintf_P(PGM_P format, va_list arg) {
+    return PrintFormatter(*this).format(format, true, arg);
+}
+
 size_t Print::print(const __FlashStringHelper *ifsh) {
     PGM_P p = reinterpret_cast<PGM_P>(ifsh);
 
@@ -148,13 +591,11 @@ size_t Print::print(unsigned int n, int base) {
 size_t Print::print(long n, int base) {
     if(base == 0) {
         return write(n);
-    } else if(base == 10) {
-        if(n < 0) {
-            int t = print('-');
-            n = -n;
-            return printNumber(n, 10) + t;
-        }
-        return printNumber(n, 10);
+    } else if(base == 10 && n < 0) {
+        char buf[3 * sizeof(long) + 1];
+        char *str = formatDigits(&buf[sizeof(buf)], -(unsigned long) n, 10, false);
+        *--str = '-';
+        return write(str, &buf[sizeof(buf)] - str);
     } else {
         return printNumber(n, base);
     }
@@ -248,23 +689,14 @@ size_t Print::println(const Printable& x) {
 // Private Methods /////////////////////////////////////////////////////////////
 
 size_t Print::printNumber(unsigned long n, uint8_t base) {
-    char buf[8 * sizeof(long) + 1]; // Assumes 8-bit chars plus zero byte.
-    char *str = &buf[sizeof(buf) - 1];
-
-    *str = '\0';
+    char buf[8 * sizeof(long)];
 
     // prevent crash if called with base == 1
     if(base < 2)
         base = 10;
 
-    do {
-        unsigned long m = n;
-        n /= base;
-        char c = m - base * n;
-        *--str = c < 10 ? c + '0' : c + 'A' - 10;
-    } while(n);
-
-    return write(str);
+    char *str = formatDigits(&buf[sizeof(buf)], n, base, true);
+    return write(str, &buf[sizeof(buf)] - str);
 }
 
 size_t Print::printFloat(double number, uint8_t digits) {
@@ -22,6 +22,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdarg.h>
 
 #include "WString.h"
 #include "Printable.h"
@@ -77,6 +78,8 @@ class Print {
 
         size_t printf(const char * format, ...)  __attribute__ ((format (printf, 2, 3)));
         size_t printf_P(PGM_P format, ...) __attribute__((format(printf, 2, 3)));
+        size_t vprintf(const char * format, va_list arg) __attribute__ ((format (printf, 2, 0)));
+        size_t vprintf_P(PGM_P format, va_list arg) __attribute__((format(printf, 2, 0)));
         size_t print(const __FlashStringHelper *);
         size_t print(const String &);
         size_t print(const char[]);
@@ -5,12 +5,18 @@
 #include "PolledTimeout.h"
 #include "interrupts.h"
 #include "coredecls.h"
+#include "ets_sys.h"
+#include "task_profiler.h"
 
 typedef std::function<void(void)> mSchedFuncT;
 struct scheduled_fn_t
 {
     scheduled_fn_t* mNext = nullptr;
     mSchedFuncT mFunc;
+#ifdef CORE_TASK_PROFILER
+    uint32_t mSite;   // caller of schedule_function()
+    uint32_t mQueued; // micros()
+#endif
 };
 
 static scheduled_fn_t* sFirst = nullptr;
@@ -23,13 +29,70 @@ struct recurrent_fn_t
 {
     recurrent_fn_t* mNext = nullptr;
     mRecFuncT mFunc;
-    esp8266::polledTimeout::periodicFastUs callNow;
+    uint32_t mInterval;
+    uint32_t mDeadline; // micros()
+    recurrent_fn_id_t mId;
+    bool mCancelled = false;
     std::function<bool(void)> alarm = nullptr;
-    recurrent_fn_t(esp8266::polledTimeout::periodicFastUs interval) : callNow(interval) { }
+#ifdef CORE_TASK_PROFILER
+    uint32_t mSite; // caller of schedule_recurrent_function_us()
+#endif
 };
 
+// Functions without alarm, sorted by deadline (FIFO for equal deadlines):
+// only the due ones at the head are looked at.
 static recurrent_fn_t* rFirst = nullptr;
-static recurrent_fn_t* rLast = nullptr;
+// Functions with alarm, polled at every run.
+static recurrent_fn_t* aFirst = nullptr;
+// Due functions during a run
+static recurrent_fn_t* rDue = nullptr;
+static recurrent_fn_t* rCurrent = nullptr;
+static recurrent_fn_id_t rLastId = 0;
+static bool rRunning = false;
+static int rCancelled = 0;
+
+static_assert((SCHEDULED_ISR_FN_MAX_COUNT & (SCHEDULED_ISR_FN_MAX_COUNT - 1)) == 0,
+    "SCHEDULED_ISR_FN_MAX_COUNT must be a power of 2");
+
+struct isr_fn_t
+{
+    scheduled_isr_fn_t mFunc;
+    void* mArg;
+#ifdef CORE_TASK_PROFILER
+    uint32_t mQueued; // micros()
+#endif
+};
+
+// Single producer / single consumer ring. Indexes run freely, only the
+// producer writes mHead and only run_scheduled_functions() writes mTail.
+struct isr_ring_t
+{
+    uint32_t mHead = 0;
+    uint32_t mTail = 0;
+    uint32_t mOverflows = 0;
+    uint32_t mMaxQueued = 0;
+    isr_fn_t mItems[SCHEDULED_ISR_FN_MAX_COUNT];
+};
+
+// [0]: SYS and CONT, [1]: interrupts
+static isr_ring_t sIsrRings[2];
+
+#ifdef CORE_MOCK
+// On host, each thread of the tests plays one context
+thread_local bool mock_schedule_from_isr = false;
+#define SCHEDULE_FROM_ISR() mock_schedule_from_isr
+#else
+#define SCHEDULE_FROM_ISR() ETS_INTR_WITHINISR()
+#endif
+
+// yield() in cont stack, while running scheduled functions
+static void yield_within_run()
+{
+    esp_schedule();
+    TASK_PROFILER__SUSPEND(TASK_PROFILER_YIELD);
+    cont_yield(g_pcont);
+    TASK_PROFILER__RESUME(TASK_PROFILER_YIELD);
+}
 
 // Returns a pointer to an unused sched_fn_t,
 // or if none are available allocates a new one,
@@ -75,6 +138,10 @@ bool schedule_function(const std::function<void(void)>& fn)
 
     item->mFunc = fn;
     item->mNext = nullptr;
+#ifdef CORE_TASK_PROFILER
+    item->mSite = (uint32_t)(uintptr_t)__builtin_return_address(0);
+    item->mQueued = micros();
+#endif
 
     if (sFirst)
         sLast->mNext = item;
@@ -85,40 +152,185 @@ bool schedule_function(const std::function<void(void)>& fn)
     return true;
 }
 
-bool schedule_recurrent_function_us(const std::function<bool(void)>& fn,
+IRAM_ATTR // (not only) called from ISR
+bool schedule_isr_function(scheduled_isr_fn_t fn, void* arg)
+{
+    if (!fn)
+        return false;
+
+    isr_ring_t& ring = sIsrRings[SCHEDULE_FROM_ISR()? 1: 0];
+
+    uint32_t head = ring.mHead;
+    uint32_t queued = head - __atomic_load_n(&ring.mTail, __ATOMIC_ACQUIRE);
+    if (queued >= SCHEDULED_ISR_FN_MAX_COUNT)
+    {
+        ++ring.mOverflows;
+        return false;
+    }
+    if (queued >= ring.mMaxQueued)
+        ring.mMaxQueued = queued + 1;
+
+    isr_fn_t& item = ring.mItems[head & (SCHEDULED_ISR_FN_MAX_COUNT - 1)];
+    item.mFunc = fn;
+    item.mArg = arg;
+#ifdef CORE_TASK_PROFILER
+    item.mQueued = micros();
+#endif
+    // publish the item
+    __atomic_store_n(&ring.mHead, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+scheduled_isr_stats_t get_scheduled_isr_stats()
+{
+    scheduled_isr_stats_t stats = { 0, 0, 0 };
+    for (const isr_ring_t& ring : sIsrRings)
+    {
+        stats.scheduled += __atomic_load_n(&ring.mHead, __ATOMIC_RELAXED);
+        stats.overflows += ring.mOverflows;
+        if (ring.mMaxQueued > stats.maxQueued)
+            stats.maxQueued = ring.mMaxQueued;
+    }
+    return stats;
+}
+
+// deadlines are compared modulo 2^32 us
+static inline bool before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+static void insert_recurrent_unsafe(recurrent_fn_t* item)
+{
+    recurrent_fn_t** link = &rFirst;
+    if (item->alarm)
+    {
+        link = &aFirst;
+        while (*link)
+            link = &(*link)->mNext;
+    }
+    else
+    {
+        while (*link && !before(item->mDeadline, (*link)->mDeadline))
+            link = &(*link)->mNext;
+    }
+    item->mNext = *link;
+    *link = item;
+}
+
+static bool unlink_recurrent_unsafe(recurrent_fn_t** list, recurrent_fn_t* item)
+{
+    for (recurrent_fn_t** link = list; *link; link = &(*link)->mNext)
+        if (*link == item)
+        {
+            *link = item->mNext;
+            return true;
+        }
+    return false;
+}
+
+recurrent_fn_id_t schedule_recurrent_function_us(const std::function<bool(void)>& fn,
     uint32_t repeat_us, const std::function<bool(void)>& alarm)
 {
-    assert(repeat_us < decltype(recurrent_fn_t::callNow)::neverExpires); //~26800000us (26.8s)
+    assert(repeat_us < 0x40000000); // ~17.9mn, deadlines are compared on 32 bits
 
     if (!fn)
-        return false;
+        return 0;
 
-    recurrent_fn_t* item = new (std::nothrow) recurrent_fn_t(repeat_us);
+    recurrent_fn_t* item = new (std::nothrow) recurrent_fn_t;
     if (!item)
-        return false;
+        return 0;
 
     item->mFunc = fn;
     item->alarm = alarm;
+    item->mInterval = repeat_us;
+    item->mDeadline = micros() + repeat_us;
+#ifdef CORE_TASK_PROFILER
+    item->mSite = (uint32_t)(uintptr_t)__builtin_return_address(0);
+#endif
 
     esp8266::InterruptLock lockAllInterruptsInThisScope;
 
-    if (rLast)
+    if (!++rLastId)
+        ++rLastId;
+    item->mId = rLastId;
+    insert_recurrent_unsafe(item);
+
+    return item->mId;
+}
+
+static recurrent_fn_t* find_recurrent(recurrent_fn_t* list, recurrent_fn_id_t id)
+{
+    for (; list; list = list->mNext)
+        if (list->mId == id)
+            return list;
+    return nullptr;
+}
+
+bool cancel_recurrent_function(recurrent_fn_id_t id)
+{
+    if (!id)
+        return false;
+
+    recurrent_fn_t* item = rCurrent && rCurrent->mId == id? rCurrent: find_recurrent(rFirst, id);
+    if (!item)
+        item = find_recurrent(aFirst, id);
+    if (!item)
+        item = find_recurrent(rDue, id);
+    if (!item || item->mCancelled)
+        return false;
+
+    if (rRunning)
     {
-        rLast->mNext = item;
+        // the lists are being walked, removed at the end of the run
+        item->mCancelled = true;
+        ++rCancelled;
+        return true;
     }
-    else
+
     {
-        rFirst = item;
+        esp8266::InterruptLock lockAllInterruptsInThisScope;
+        if (!unlink_recurrent_unsafe(&rFirst, item))
+            unlink_recurrent_unsafe(&aFirst, item);
     }
-    rLast = item;
-
+    delete item;
     return true;
 }
 
+uint32_t get_scheduled_recurrent_delay_us()
+{
+    if (aFirst)
+        return 0;
+    if (!rFirst)
+        return ~0U;
+    int32_t delay = rFirst->mDeadline - micros();
+    return delay > 0? delay: 0;
+}
+
 void run_scheduled_functions()
 {
     esp8266::polledTimeout::periodicFastMs yieldNow(100); // yield every 100ms
 
+    for (isr_ring_t& ring : sIsrRings)
+    {
+        // prevent scheduling of new functions during this run
+        uint32_t stop = __atomic_load_n(&ring.mHead, __ATOMIC_ACQUIRE);
+        for (uint32_t tail = ring.mTail; tail != stop; )
+        {
+            isr_fn_t item = ring.mItems[tail & (SCHEDULED_ISR_FN_MAX_COUNT - 1)];
+            // release the slot before the call, which may schedule again
+            __atomic_store_n(&ring.mTail, ++tail, __ATOMIC_RELEASE);
+
+            TASK_PROFILER__BEGIN(TASK_PROFILER_SCHEDULED, NULL, (uint32_t)(uintptr_t)item.mFunc, micros() - item.mQueued);
+            item.mFunc(item.mArg);
+            TASK_PROFILER__END();
+
+            if (yieldNow)
+                yield_within_run();
+        }
+    }
+
     // prevent scheduling of new functions during this run
     auto stop = sLast;
     bool done = false;
@@ -126,7 +338,9 @@ void run_scheduled_functions()
     {
         done = sFirst == stop;
 
+        TASK_PROFILER__BEGIN(TASK_PROFILER_SCHEDULED, NULL, sFirst->mSite, micros() - sFirst->mQueued);
         sFirst->mFunc();
+        TASK_PROFILER__END();
 
         {
             // remove function from stack
@@ -144,90 +358,121 @@ void run_scheduled_functions()
         }
 
         if (yieldNow)
+            // because scheduled functions might last too long for watchdog etc
+            yield_within_run();
+    }
+}
+
+static void purge_cancelled_unsafe(recurrent_fn_t** list)
+{
+    for (recurrent_fn_t** link = list; *link; )
+    {
+        recurrent_fn_t* item = *link;
+        if (item->mCancelled)
         {
-            // because scheduled functions might last too long for watchdog etc,
-            // this is yield() in cont stack:
-            esp_schedule();
-            cont_yield(g_pcont);
+            *link = item->mNext;
+            delete item;
         }
+        else
+            link = &item->mNext;
     }
 }
 
 void run_scheduled_recurrent_functions()
 {
-    esp8266::polledTimeout::periodicFastMs yieldNow(100); // yield every 100ms
-
     // Note to the reader:
-    // There is no exposed API to remove a scheduled function:
-    // Scheduled functions are removed only from this function, and
-    // its purpose is that it is never called from an interrupt
-    // (always on cont stack).
+    // Scheduled functions are removed only from this function or
+    // cancel_recurrent_function(), and their purpose is that they are
+    // never called from an interrupt (always on cont stack).
 
-    auto current = rFirst;
-    if (!current)
+    if (!rFirst && !aFirst)
+        return;
+    const uint32_t now = micros();
+    if (!aFirst && before(now, rFirst->mDeadline))
+        // nothing is due
         return;
 
-    static bool fence = false;
-    {
-        // fence is like a mutex but as we are never called from ISR,
-        // locking is useless here. Leaving comment for reference.
-        //esp8266::InterruptLock lockAllInterruptsInThisScope;
-
-        if (fence)
-            // prevent recursive calls from yield()
-            // (even if they are not allowed)
-            return;
-        fence = true;
-    }
+    if (rRunning)
+        // prevent recursive calls from yield()
+        // (even if they are not allowed)
+        return;
+    rRunning = true;
 
-    recurrent_fn_t* prev = nullptr;
-    // prevent scheduling of new functions during this run
-    auto stop = rLast;
+    esp8266::polledTimeout::periodicFastMs yieldNow(100); // yield every 100ms
 
-    bool done;
-    do
+    // Collect the due functions, in order, so that functions rescheduled or
+    // scheduled during this run wait for the next one
+    recurrent_fn_t** dueLast = &rDue;
     {
-        done = current == stop;
-        const bool wakeup = current->alarm && current->alarm();
-        bool callNow = current->callNow;
-
-        if ((wakeup || callNow) && !current->mFunc())
+        esp8266::InterruptLock lockAllInterruptsInThisScope;
+        while (rFirst && !before(now, rFirst->mDeadline))
+        {
+            *dueLast = rFirst;
+            dueLast = &rFirst->mNext;
+            rFirst = rFirst->mNext;
+        }
+        *dueLast = nullptr;
+    }
+    for (recurrent_fn_t** link = &aFirst; *link; )
+    {
+        recurrent_fn_t* item = *link;
+        if (!item->mCancelled && (item->alarm() || !before(now, item->mDeadline)))
         {
-            // remove function from stack
             esp8266::InterruptLock lockAllInterruptsInThisScope;
+            *link = item->mNext;
+            item->mNext = nullptr;
+            *dueLast = item;
+            dueLast = &item->mNext;
+        }
+        else
+            link = &item->mNext;
+    }
 
-            auto to_ditch = current;
-
-            // removing rLast
-            if (rLast == current)
-                rLast = prev;
+    while (rDue)
+    {
+        recurrent_fn_t* current = rDue;
+        rDue = current->mNext;
 
-            current = current->mNext;
-            if (prev)
-            {
-                prev->mNext = current;
-            }
-            else
-            {
-                rFirst = current;
-            }
+        rCurrent = current;
+        TASK_PROFILER__BEGIN(TASK_PROFILER_RECURRENT, NULL, current->mSite,
+            before(now, current->mDeadline)? 0: micros() - current->mDeadline);
+        bool keep = !current->mCancelled && current->mFunc();
+        TASK_PROFILER__END();
+        rCurrent = nullptr;
 
-            delete(to_ditch);
+        if (!keep || current->mCancelled)
+        {
+            if (current->mCancelled)
+                --rCancelled;
+            delete current;
         }
         else
         {
-            prev = current;
-            current = current->mNext;
+            // same catch-up as periodicFastUs: skip the missed periods,
+            // the deadline is kept when an alarm triggered the call
+            if (!before(now, current->mDeadline))
+            {
+                if (current->mInterval)
+                    current->mDeadline += ((now - current->mDeadline) / current->mInterval + 1) * current->mInterval;
+                else
+                    current->mDeadline = now;
+            }
+            esp8266::InterruptLock lockAllInterruptsInThisScope;
+            insert_recurrent_unsafe(current);
         }
 
         if (yieldNow)
-        {
-            // because scheduled functions might last too long for watchdog etc,
-            // this is yield() in cont stack:
-            esp_schedule();
-            cont_yield(g_pcont);
-        }
-    } while (current && !done);
+            // because scheduled functions might last too long for watchdog etc
+            yield_within_run();
+    }
+
+    if (rCancelled)
+    {
+        esp8266::InterruptLock lockAllInterruptsInThisScope;
+        purge_cancelled_unsafe(&rFirst);
+        purge_cancelled_unsafe(&aFirst);
+        rCancelled = 0;
+    }
 
-    fence = false;
+    rRunning = false;
 }
@@ -2,6 +2,7 @@
 #define ESP_SCHEDULE_H
 
 #include <functional>
+#include <stdint.h>
 
 #define SCHEDULED_FN_MAX_COUNT 32
 
@@ -38,6 +39,36 @@
 
 bool schedule_function (const std::function<void(void)>& fn);
 
+// scheduled functions from interrupts, without lock nor allocation:
+//
+// * Add fn(arg) to a preallocated fifo of SCHEDULED_ISR_FN_MAX_COUNT plain
+//   function pointers and arguments, which is run when `loop` function
+//   returns, before the functions scheduled with `schedule_function()`.
+// * Interrupts are not disabled and the heap is not used: there is one
+//   single producer / single consumer ring for interrupts and one for
+//   system and user context (CONT). Interrupts of the same level don't
+//   preempt each other, so each ring has one producer at a time.
+// * A captureless lambda can be given for fn: `[](void* arg) { ... }`.
+// * Must not be called from an NMI (like timer1 with NMI level).
+// * Returns false and counts an overflow when the ring is full.
+
+#ifndef SCHEDULED_ISR_FN_MAX_COUNT
+#define SCHEDULED_ISR_FN_MAX_COUNT 32 // per ring, power of 2
+#endif
+
+typedef void (*scheduled_isr_fn_t)(void* arg);
+
+bool schedule_isr_function (scheduled_isr_fn_t fn, void* arg = nullptr);
+
+struct scheduled_isr_stats_t
+{
+    uint32_t scheduled;  // functions queued since boot
+    uint32_t overflows;  // functions rejected because a ring was full
+    uint32_t maxQueued;  // highest number of functions waiting in a ring
+};
+
+scheduled_isr_stats_t get_scheduled_isr_stats ();
+
 // Run all scheduled functions.
 // Use this function if your are not using `loop`,
 // or `loop` does not return on a regular basis.
@@ -46,26 +77,43 @@ void run_scheduled_functions();
 
 // recurrent scheduled function:
 //
-// * Internal queue is a FIFO.
+// * Functions are kept sorted by deadline, FIFO for equal deadlines, so
+//   that only the due ones are looked at.
 // * Run the lambda periodically about every <repeat_us> microseconds until
-//   it returns false.
+//   it returns false or is cancelled. <repeat_us> must be less than 2^30
+//   (~17 minutes).
 // * Note that it may be more than <repeat_us> microseconds between calls if
 //   `yield` is not called frequently, and therefore should not be used for
 //   timing critical operations.
 // * Please ensure variables or instances used from inside lambda will exist
 //   when lambda is later called.
-// * There is no mechanism for externally cancelling recurrent scheduled
-//   functions.  However a user function returning false will cancel itself.
+// * Returns an id for `cancel_recurrent_function()`, or 0 on memory shortage
+//   (ids only evaluate as false on failure, like the former bool result).
 // * Long running operations or yield() or delay() are not allowed in the
 //   recurrent function.
 // * If alarm is used, anytime during scheduling when it returns true,
 //   any remaining delay from repeat_us is disregarded, and fn is executed.
+//   Functions with alarm are polled at every run.
+
+typedef uint32_t recurrent_fn_id_t;
 
-bool schedule_recurrent_function_us(const std::function<bool(void)>& fn,
+recurrent_fn_id_t schedule_recurrent_function_us(const std::function<bool(void)>& fn,
     uint32_t repeat_us, const std::function<bool(void)>& alarm = nullptr);
 
+// Remove a recurrent function, including from within a recurrent function.
+// Returns false if it has already ended. Not to be called from an interrupt.
+
+bool cancel_recurrent_function(recurrent_fn_id_t id);
+
+// Microseconds until the next recurrent function is due: 0 if one is due or
+// if an alarm has to be polled, ~0 if there is none. Lets callers know how
+// long they can sleep or skip yielding.
+
+uint32_t get_scheduled_recurrent_delay_us();
+
 // Test recurrence and run recurrent scheduled functions.
-// (internally called at every `yield()` and `loop()`)
+// (internally called at every `yield()` and `loop()`, costs one time read
+// when nothing is due)
 
 void run_scheduled_recurrent_functions();
 
@@ -0,0 +1,94 @@
+/*
+ StringBuilder.cpp - build long strings without reallocating them
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <algorithm>
+#include <Arduino.h>
+#include "StringBuilder.h"
+
+StringBuilder::StringBuilder(size_t chunkSize) :
+    _head(nullptr), _tail(nullptr), _chunkSize(chunkSize ? chunkSize : 1), _length(0) {
+}
+
+StringBuilder::~StringBuilder() {
+    clear();
+}
+
+void StringBuilder::clear() {
+    while (_head) {
+        Chunk *next = _head->next;
+        free(_head);
+        _head = next;
+    }
+    _tail = nullptr;
+    _length = 0;
+    clearWriteError();
+}
+
+size_t StringBuilder::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t StringBuilder::write(const uint8_t *buffer, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        if (!_tail || _tail->used == _chunkSize) {
+            // +1: String::concat() reads the byte following the data
+            Chunk *chunk = (Chunk *) malloc(sizeof(Chunk) + _chunkSize + 1);
+            if (!chunk) {
+                setWriteError();
+                break;
+            }
+            chunk->next = nullptr;
+            chunk->used = 0;
+            if (_tail) {
+                _tail->next = chunk;
+            } else {
+                _head = chunk;
+            }
+            _tail = chunk;
+        }
+        size_t room = _chunkSize - _tail->used;
+        size_t len = std::min(room, size - done);
+        memcpy(_tail->data() + _tail->used, buffer + done, len);
+        _tail->used += len;
+        done += len;
+    }
+    _length += done;
+    return done;
+}
+
+String StringBuilder::toString() const {
+    String s;
+    if (!s.reserve(_length)) {
+        return s;
+    }
+    for (Chunk *chunk = _head; chunk; chunk = chunk->next) {
+        s.concat(chunk->data(), chunk->used);
+    }
+    return s;
+}
+
+size_t StringBuilder::printTo(Print& p) const {
+    size_t done = 0;
+    for (Chunk *chunk = _head; chunk; chunk = chunk->next) {
+        done += p.write((const uint8_t *) chunk->data(), chunk->used);
+    }
+    return done;
+}
@@ -0,0 +1,78 @@
+/*
+ StringBuilder.h - build long strings without reallocating them
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef STRINGBUILDER_H_
+#define STRINGBUILDER_H_
+
+#include <Print.h>
+#include <Printable.h>
+#include <WString.h>
+
+/** Collects text (anything Print can format) into a chain of fixed size
+ heap chunks. Data already written never moves, so building a large
+ response costs one allocation per chunk instead of one reallocation per
+ append. The result is materialised once with toString() (a single exact
+ allocation) or streamed without copying with printTo(), e.g.
+ server.sendContent() / client.print(builder).
+ An allocation failure sets the write error (getWriteError()).
+ */
+class StringBuilder: public Print, public Printable {
+public:
+    explicit StringBuilder(size_t chunkSize = 256);
+    ~StringBuilder();
+
+    StringBuilder(const StringBuilder&) = delete;
+    StringBuilder& operator=(const StringBuilder&) = delete;
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+
+    template<typename T>
+    StringBuilder& operator +=(const T& value) {
+        print(value);
+        return *this;
+    }
+
+    size_t length() const {
+        return _length;
+    }
+    void clear();
+
+    // an empty String when the heap can not hold the result
+    String toString() const;
+    size_t printTo(Print& p) const override;
+
+protected:
+    struct Chunk {
+        Chunk *next;
+        size_t used;
+        char *data() {
+            return reinterpret_cast<char *>(this + 1);
+        }
+    };
+
+    Chunk *_head;
+    Chunk *_tail;
+    size_t _chunkSize;
+    size_t _length;
+};
+
+#endif /* STRINGBUILDER_H_ */
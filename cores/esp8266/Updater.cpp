@@ -25,6 +25,35 @@ extern "C" {
 extern "C" uint32_t _FS_start;
 extern "C" uint32_t _FS_end;
 
+// Delta patch format, as produced by tools/delta.py (little endian):
+//   header: magic "\xd1DLT", u32 old size, u32 new size,
+//           MD5 of the old image with bytes 2 and 3 (flash mode and size,
+//           which esptool or the updater may rewrite) set to zero,
+//           MD5 of the new image
+//   then commands until the new image is complete:
+//     'C' u32 offset, u32 length: copy from the running sketch
+//     'D' u32 length, data:       literal bytes
+#define DELTA_MAGIC          0x544c44d1
+#define DELTA_HEADER_SIZE    44
+#define DELTA_OP_COPY        'C'
+#define DELTA_OP_DATA        'D'
+
+struct UpdaterDelta {
+  enum { HEADER, OP, ARGS, DATA, DONE } state;
+  uint8_t op;
+  uint8_t have; // bytes collected in args
+  uint8_t args[DELTA_HEADER_SIZE];
+  uint32_t oldSize;
+  uint32_t newSize;
+  uint32_t left; // literal bytes left in the current 'D' command
+  uint8_t newMd5[16];
+  MD5Builder input;
+};
+
+static uint32_t deltaU32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
 UpdaterClass::UpdaterClass()
 : _async(false)
 , _error(0)
@@ -33,7 +62,13 @@ UpdaterClass::UpdaterClass()
 , _size(0)
 , _startAddress(0)
 , _currentAddress(0)
+, _eraseAddress(0)
+, _endAddress(0)
 , _command(U_FLASH)
+, _eraseAhead(false)
+, _eraseAll(false)
+, _delta(nullptr)
+, _deltaIn(0)
 , _hash(nullptr)
 , _verify(nullptr)
 , _progress_callback(nullptr)
@@ -53,8 +88,14 @@ void UpdaterClass::_reset() {
     delete[] _buffer;
   _buffer = 0;
   _bufferLen = 0;
+  if (_delta)
+    delete _delta;
+  _delta = nullptr;
+  _deltaIn = 0;
   _startAddress = 0;
   _currentAddress = 0;
+  _eraseAddress = 0;
+  _endAddress = 0;
   _size = 0;
   _command = U_FLASH;
 
@@ -164,6 +205,8 @@ bool UpdaterClass::begin(size_t size, int command, int ledPin, uint8_t ledOn) {
   //initialize
   _startAddress = updateStartAddress;
   _currentAddress = _startAddress;
+  _eraseAddress = _startAddress;
+  _endAddress = _startAddress + roundedSize;
   _size = size;
   if (ESP.getFreeHeap() > 2 * FLASH_SECTOR_SIZE) {
     _bufferSize = FLASH_SECTOR_SIZE;
@@ -182,6 +225,16 @@ bool UpdaterClass::begin(size_t size, int command, int ledPin, uint8_t ledOn) {
   if (!_verify) {
     _md5.begin();
   }
+
+  if (_eraseAll) {
+    while (_eraseAddress < _endAddress) {
+      if (!_eraseNext()) {
+        _setError(UPDATE_ERROR_ERASE);
+        return false;
+      }
+      if(!_async) yield();
+    }
+  }
   return true;
 }
 
@@ -211,7 +264,12 @@ bool UpdaterClass::end(bool evenIfRemaining){
     return false;
   }
 
-  if(evenIfRemaining) {
+  if (_delta) {
+    if (!_deltaEnd()) {
+      _reset();
+      return false;
+    }
+  } else if(evenIfRemaining) {
     if(_bufferLen > 0) {
       _writeBuffer();
     }
@@ -320,9 +378,9 @@ bool UpdaterClass::_writeBuffer(){
   #define FLASH_MODE_OFFSET  2
 
   bool eraseResult = true, writeResult = true;
-  if (_currentAddress % FLASH_SECTOR_SIZE == 0) {
+  while (eraseResult && _eraseAddress < _currentAddress + _bufferLen) {
     if(!_async) yield();
-    eraseResult = ESP.flashEraseSector(_currentAddress/FLASH_SECTOR_SIZE);
+    eraseResult = _eraseNext();
   }
 
   // If the flash settings don't match what we already have, modify them.
@@ -376,10 +434,36 @@ bool UpdaterClass::_writeBuffer(){
   return true;
 }
 
+bool UpdaterClass::_eraseNext() {
+  if (!ESP.flashEraseSector(_eraseAddress/FLASH_SECTOR_SIZE))
+    return false;
+  _eraseAddress += FLASH_SECTOR_SIZE;
+  return true;
+}
+
+// Called while waiting for data: erase the next sector now so that writing
+// it later does not stall the stream
+bool UpdaterClass::_eraseIdle() {
+  if (!_eraseAhead || _eraseAddress >= _endAddress || hasError() || !isRunning())
+    return false;
+  if (!_eraseNext()) {
+    _currentAddress = (_startAddress + _size);
+    _setError(UPDATE_ERROR_ERASE);
+  }
+  return true;
+}
+
 size_t UpdaterClass::write(uint8_t *data, size_t len) {
   if(hasError() || !isRunning())
     return 0;
 
+  if(!_delta && len && data[0] == DELTA_MAGIC_BYTE && _command == U_FLASH && progress() == 0 && _bufferLen == 0) {
+    if(!_deltaBegin())
+      return 0;
+  }
+  if(_delta)
+    return _deltaWrite(data, len);
+
   if(progress() + _bufferLen + len > _size) {
     _setError(UPDATE_ERROR_SPACE);
     return 0;
@@ -409,10 +493,210 @@ size_t UpdaterClass::write(uint8_t *data, size_t len) {
   return len;
 }
 
+bool UpdaterClass::_deltaBegin() {
+  _delta = new (std::nothrow) UpdaterDelta;
+  if (!_delta) {
+    _setError(UPDATE_ERROR_DELTA);
+    return false;
+  }
+  _delta->state = UpdaterDelta::HEADER;
+  _delta->have = 0;
+  _delta->input.begin();
+  _deltaIn = 0;
+  return true;
+}
+
+size_t UpdaterClass::_deltaWrite(const uint8_t *data, size_t len) {
+  if(_deltaIn + len > _size) {
+    _setError(UPDATE_ERROR_SPACE);
+    return 0;
+  }
+  _delta->input.add(data, len);
+
+  size_t done = 0;
+  while (done < len) {
+    UpdaterDelta *d = _delta;
+    if (d->state == UpdaterDelta::HEADER || d->state == UpdaterDelta::ARGS) {
+      size_t want = d->state == UpdaterDelta::HEADER ? DELTA_HEADER_SIZE : d->op == DELTA_OP_COPY ? 8 : 4;
+      size_t n = std::min(want - d->have, len - done);
+      memcpy(d->args + d->have, data + done, n);
+      d->have += n;
+      done += n;
+      _deltaIn += n;
+      if (d->have < want)
+        break;
+      d->have = 0;
+      if (d->state == UpdaterDelta::HEADER) {
+        if (!_deltaHeader())
+          return done - n;
+        d->state = UpdaterDelta::OP;
+      } else if (d->op == DELTA_OP_COPY) {
+        if (!_deltaCopy(deltaU32(d->args), deltaU32(d->args + 4)))
+          return done - n;
+        d->state = UpdaterDelta::OP;
+      } else {
+        d->left = deltaU32(d->args);
+        d->state = UpdaterDelta::DATA;
+      }
+    } else if (d->state == UpdaterDelta::OP) {
+      d->op = data[done];
+      if (d->op != DELTA_OP_COPY && d->op != DELTA_OP_DATA) {
+        _setError(UPDATE_ERROR_DELTA);
+        return done;
+      }
+      d->state = UpdaterDelta::ARGS;
+      ++done;
+      ++_deltaIn;
+    } else if (d->state == UpdaterDelta::DATA) {
+      size_t n = std::min((size_t)d->left, len - done);
+      if (!_deltaOutput(data + done, n))
+        return done;
+      d->left -= n;
+      done += n;
+      _deltaIn += n;
+      if (!d->left)
+        d->state = UpdaterDelta::OP;
+    } else {
+      // The new image is complete, nothing else may follow
+      _setError(UPDATE_ERROR_DELTA);
+      return done;
+    }
+    if (d->state == UpdaterDelta::OP && _currentAddress == _startAddress + d->newSize)
+      d->state = UpdaterDelta::DONE;
+  }
+  return done;
+}
+
+bool UpdaterClass::_deltaHeader() {
+  UpdaterDelta *d = _delta;
+  d->oldSize = deltaU32(d->args + 4);
+  d->newSize = deltaU32(d->args + 8);
+  if (deltaU32(d->args) != DELTA_MAGIC || !d->oldSize || !d->newSize) {
+    _setError(UPDATE_ERROR_DELTA);
+    return false;
+  }
+
+  // The staging area was sized for the patch, move it for the new image
+  uintptr_t updateEndAddress = (uintptr_t)&_FS_start - 0x40200000;
+  size_t currentSketchSize = (ESP.getSketchSize() + FLASH_SECTOR_SIZE - 1) & (~(FLASH_SECTOR_SIZE - 1));
+  size_t roundedSize = (d->newSize + FLASH_SECTOR_SIZE - 1) & (~(FLASH_SECTOR_SIZE - 1));
+  uintptr_t updateStartAddress = (updateEndAddress > roundedSize)? (updateEndAddress - roundedSize) : 0;
+  if (updateStartAddress < currentSketchSize || updateStartAddress < d->oldSize) {
+    _setError(UPDATE_ERROR_SPACE);
+    return false;
+  }
+  _startAddress = updateStartAddress;
+  _currentAddress = _startAddress;
+  _eraseAddress = _startAddress;
+  _endAddress = _startAddress + roundedSize;
+  memcpy(d->newMd5, d->args + 28, sizeof(d->newMd5));
+
+#ifdef DEBUG_UPDATER
+  DEBUG_UPDATER.printf_P(PSTR("[delta] old:%u new:%u staged at 0x%08X\n"), d->oldSize, d->newSize, _startAddress);
+#endif
+
+  // Make sure the patch applies to the running sketch
+  MD5Builder md5;
+  md5.begin();
+  uint32_t buff[32];
+  for (uint32_t pos = 0; pos < d->oldSize; pos += sizeof(buff)) {
+    size_t n = std::min((size_t)(d->oldSize - pos), sizeof(buff));
+    if (!ESP.flashRead(pos, buff, (n + 3) & ~3)) {
+      _setError(UPDATE_ERROR_READ);
+      return false;
+    }
+    if (pos == 0) {
+      ((uint8_t*)buff)[2] = 0;
+      ((uint8_t*)buff)[3] = 0;
+    }
+    md5.add((uint8_t*)buff, n);
+    if (!_async && (pos & 0xfff) == 0) yield();
+  }
+  md5.calculate();
+  uint8_t oldMd5[16];
+  md5.getBytes(oldMd5);
+  if (memcmp(oldMd5, d->args + 12, sizeof(oldMd5))) {
+#ifdef DEBUG_UPDATER
+    DEBUG_UPDATER.println(F("[delta] patch is not for the running sketch"));
+#endif
+    _setError(UPDATE_ERROR_DELTA);
+    return false;
+  }
+  return true;
+}
+
+bool UpdaterClass::_deltaOutput(const uint8_t *data, size_t len) {
+  uint32_t end = _startAddress + _delta->newSize;
+  if (_currentAddress + _bufferLen + len > end) {
+    _setError(UPDATE_ERROR_DELTA);
+    return false;
+  }
+  while (len) {
+    size_t n = std::min(len, _bufferSize - _bufferLen);
+    memcpy(_buffer + _bufferLen, data, n);
+    _bufferLen += n;
+    data += n;
+    len -= n;
+    if (_bufferLen == _bufferSize || _currentAddress + _bufferLen == end) {
+      if (!_writeBuffer())
+        return false;
+    }
+  }
+  return true;
+}
+
+bool UpdaterClass::_deltaCopy(uint32_t offset, uint32_t len) {
+  if (offset + len > _delta->oldSize || offset + len < offset) {
+    _setError(UPDATE_ERROR_DELTA);
+    return false;
+  }
+  uint32_t buff[32];
+  while (len) {
+    uint32_t aligned = offset & ~3;
+    size_t skip = offset - aligned;
+    size_t n = std::min((size_t)len, sizeof(buff) - skip);
+    if (!ESP.flashRead(aligned, buff, (skip + n + 3) & ~3)) {
+      _setError(UPDATE_ERROR_READ);
+      return false;
+    }
+    if (!_deltaOutput((uint8_t*)buff + skip, n))
+      return false;
+    offset += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool UpdaterClass::_deltaEnd() {
+  if (_delta->state != UpdaterDelta::DONE) {
+    _setError(UPDATE_ERROR_DELTA);
+    return false;
+  }
+
+  // An expected MD5 describes the transferred patch, the rebuilt image is
+  // then checked against the MD5 carried by the patch
+  _delta->input.calculate();
+  if (_target_md5.length() && strcasecmp(_target_md5.c_str(), _delta->input.toString().c_str())) {
+    _md5 = _delta->input;
+    _setError(UPDATE_ERROR_MD5);
+    return false;
+  }
+  char newMd5[33];
+  for (int i = 0; i < 16; i++)
+    sprintf(newMd5 + i * 2, "%02x", _delta->newMd5[i]);
+  _target_md5 = newMd5;
+
+  _size = _delta->newSize;
+  delete _delta;
+  _delta = nullptr;
+  _deltaIn = 0;
+  return true;
+}
+
 bool UpdaterClass::_verifyHeader(uint8_t data) {
     if(_command == U_FLASH) {
-        // check for valid first magic byte (is always 0xE9)
-        if ((data != 0xE9) && (data != 0x1f)) {
+        // check for valid first magic byte (is always 0xE9, 0x1f for gzip, 0xd1 for a delta patch)
+        if ((data != 0xE9) && (data != 0x1f) && (data != DELTA_MAGIC_BYTE)) {
             _currentAddress = (_startAddress + _size);
             _setError(UPDATE_ERROR_MAGIC_BYTE);
             return false;
@@ -488,14 +772,25 @@ size_t UpdaterClass::writeStream(Stream &data) {
         if(_ledPin != -1) {
             digitalWrite(_ledPin, _ledOn); // Switch LED on
         }
-        size_t bytesToRead = _bufferSize - _bufferLen;
+        // Until the format is known, and for delta patches, data goes
+        // through write(uint8_t*) instead of straight into the flash buffer
+        uint8_t chunk[128];
+        bool direct = !_delta && (progress() > 0 || _bufferLen > 0);
+        uint8_t *dst = direct ? _buffer + _bufferLen : chunk;
+        size_t bytesToRead = direct ? _bufferSize - _bufferLen : sizeof(chunk);
         if(bytesToRead > remaining()) {
             bytesToRead = remaining();
         }
-        toRead = data.readBytes(_buffer + _bufferLen,  bytesToRead);
+        while(!data.available() && _eraseIdle()) {
+            yield();
+        }
+        if(hasError()) {
+            return written;
+        }
+        toRead = data.readBytes(dst,  bytesToRead);
         if(toRead == 0) { //Timeout
             delay(100);
-            toRead = data.readBytes(_buffer + _bufferLen, bytesToRead);
+            toRead = data.readBytes(dst, bytesToRead);
             if(toRead == 0) { //Timeout
                 _currentAddress = (_startAddress + _size);
                 _setError(UPDATE_ERROR_STREAM);
@@ -505,9 +800,14 @@ size_t UpdaterClass::writeStream(Stream &data) {
         if(_ledPin != -1) {
             digitalWrite(_ledPin, !_ledOn); // Switch LED off
         }
-        _bufferLen += toRead;
-        if((_bufferLen == remaining() || _bufferLen == _bufferSize) && !_writeBuffer())
-            return written;
+        if(!direct) {
+            if(write(chunk, toRead) != toRead)
+                return written;
+        } else {
+            _bufferLen += toRead;
+            if((_bufferLen == remaining() || _bufferLen == _bufferSize) && !_writeBuffer())
+                return written;
+        }
         written += toRead;
         if(_progress_callback) {
             _progress_callback(progress(), _size);
@@ -556,6 +856,8 @@ void UpdaterClass::printError(Print &out){
     out.println(F("Magic byte is wrong, not 0xE9"));
   } else if (_error == UPDATE_ERROR_BOOTSTRAP){
     out.println(F("Invalid bootstrapping state, reset ESP8266 before updating"));
+  } else if (_error == UPDATE_ERROR_DELTA){
+    out.println(F("Delta patch is invalid or not for this sketch"));
   } else {
     out.println(F("UNKNOWN"));
   }
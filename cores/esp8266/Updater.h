@@ -19,17 +19,24 @@
 #define UPDATE_ERROR_MAGIC_BYTE         (10)
 #define UPDATE_ERROR_BOOTSTRAP          (11)
 #define UPDATE_ERROR_SIGN               (12)
+#define UPDATE_ERROR_DELTA              (13)
 
 #define U_FLASH   0
 #define U_FS      100
 #define U_AUTH    200
 
+// First byte of a U_FLASH stream holding a delta patch (tools/delta.py)
+// instead of a full image
+#define DELTA_MAGIC_BYTE  0xd1
+
 #ifdef DEBUG_ESP_UPDATER
 #ifdef DEBUG_ESP_PORT
 #define DEBUG_UPDATER DEBUG_ESP_PORT
 #endif
 #endif
 
+struct UpdaterDelta;
+
 // Abstract class to implement whatever signing hash desired
 class UpdaterHashClass {
   public:
@@ -68,9 +75,20 @@ class UpdaterClass {
     */
     void runAsync(bool async){ _async = async; }
 
+    /*
+      Erase flash sectors ahead of the incoming data while the stream
+      has nothing available, instead of right before each sector is written.
+      With eraseAll, the whole target region is erased by begin().
+      Must be called before begin()
+    */
+    void eraseAhead(bool enable, bool eraseAll = false){ _eraseAhead = enable; _eraseAll = enable && eraseAll; }
+
     /*
       Writes a buffer to the flash and increments the address
       Returns the amount written
+      A U_FLASH stream starting with a delta patch (tools/delta.py) is
+      applied against the running sketch, size and progress then count
+      patch bytes
     */
     size_t write(uint8_t *data, size_t len);
 
@@ -125,10 +143,10 @@ class UpdaterClass {
     void clearError(){ _error = UPDATE_ERROR_OK; }
     bool hasError(){ return _error != UPDATE_ERROR_OK; }
     bool isRunning(){ return _size > 0; }
-    bool isFinished(){ return _currentAddress == (_startAddress + _size); }
+    bool isFinished(){ return progress() == _size; }
     size_t size(){ return _size; }
-    size_t progress(){ return _currentAddress - _startAddress; }
-    size_t remaining(){ return _size - (_currentAddress - _startAddress); }
+    size_t progress(){ return _delta ? _deltaIn : _currentAddress - _startAddress; }
+    size_t remaining(){ return _size - progress(); }
 
     /*
       Template to write from objects that expose
@@ -144,29 +162,44 @@ class UpdaterClass {
 
       size_t available = data.available();
       while(available) {
-        if(_bufferLen + available > remaining()){
-          available = remaining() - _bufferLen;
-        }
-        if(_bufferLen + available > _bufferSize) {
-          size_t toBuff = _bufferSize - _bufferLen;
-          data.read(_buffer + _bufferLen, toBuff);
-          _bufferLen += toBuff;
-          if(!_writeBuffer())
+        if(_delta || (progress() == 0 && _bufferLen == 0)) {
+          // Go through write(uint8_t*) which recognizes and applies delta patches
+          uint8_t chunk[128];
+          size_t toWrite = std::min(std::min(available, sizeof(chunk)), remaining());
+          data.read(chunk, toWrite);
+          size_t done = write(chunk, toWrite);
+          written += done;
+          if(done != toWrite || remaining() == 0)
             return written;
-          written += toBuff;
+          available = data.available();
+          if(available)
+            continue;
         } else {
-          data.read(_buffer + _bufferLen, available);
-          _bufferLen += available;
-          written += available;
-          if(_bufferLen == remaining()) {
-            if(!_writeBuffer()) {
+          if(_bufferLen + available > remaining()){
+            available = remaining() - _bufferLen;
+          }
+          if(_bufferLen + available > _bufferSize) {
+            size_t toBuff = _bufferSize - _bufferLen;
+            data.read(_buffer + _bufferLen, toBuff);
+            _bufferLen += toBuff;
+            if(!_writeBuffer())
               return written;
+            written += toBuff;
+          } else {
+            data.read(_buffer + _bufferLen, available);
+            _bufferLen += available;
+            written += available;
+            if(_bufferLen == remaining()) {
+              if(!_writeBuffer()) {
+                return written;
+              }
             }
           }
         }
         if(remaining() == 0)
           return written;
-        delay(1);
+        if(!_eraseIdle())
+          delay(1);
         available = data.available();
       }
       return written;
@@ -175,6 +208,15 @@ class UpdaterClass {
   private:
     void _reset();
     bool _writeBuffer();
+    bool _eraseNext();
+    bool _eraseIdle();
+
+    bool _deltaBegin();
+    size_t _deltaWrite(const uint8_t *data, size_t len);
+    bool _deltaHeader();
+    bool _deltaOutput(const uint8_t *data, size_t len);
+    bool _deltaCopy(uint32_t offset, uint32_t len);
+    bool _deltaEnd();
 
     bool _verifyHeader(uint8_t data);
     bool _verifyEnd();
@@ -189,7 +231,15 @@ class UpdaterClass {
     size_t _size;
     uint32_t _startAddress;
     uint32_t _currentAddress;
+    uint32_t _eraseAddress; // first sector of the region not yet erased
+    uint32_t _endAddress; // end of the region, rounded to a sector
     uint32_t _command;
+    bool _eraseAhead;
+    bool _eraseAll;
+
+    // Delta patch decoder, only allocated while applying a patch
+    UpdaterDelta *_delta;
+    size_t _deltaIn; // patch bytes consumed
 
     String _target_md5;
     MD5Builder _md5;
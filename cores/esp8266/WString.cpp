@@ -151,6 +151,32 @@ unsigned char String::reserve(unsigned int size) {
     return 0;
 }
 
+// Used when appending: grow by half the current capacity (at least to size)
+// so building a string piece by piece only reallocates O(log n) times
+// instead of every 16 bytes. Falls back to the exact size when the heap
+// cannot provide the extra room.
+unsigned char String::grow(unsigned int size) {
+    if(buffer() && capacity() >= size)
+        return 1;
+    unsigned int cap = buffer() ? capacity() : 0;
+    unsigned int want = cap + (cap >> 1);
+    if(want > CAPACITY_MAX - 16)
+        want = CAPACITY_MAX - 16;
+    if(want > size && reserve(want))
+        return 1;
+    return reserve(size);
+}
+
+void String::shrink_to_fit(void) {
+    if(!buffer() || isSSO())
+        return;
+    unsigned int oldLen = len();
+    if(oldLen >= sizeof(sso.buff) - 1 && ((oldLen + 16) & (~0xf)) >= capacity() + 1)
+        return;
+    if(changeBuffer(oldLen))
+        wbuffer()[oldLen] = 0;
+}
+
 unsigned char String::changeBuffer(unsigned int maxStrLen) {
     // Can we use SSO here to avoid allocation?
     if (maxStrLen < sizeof(sso.buff) - 1) {
@@ -310,7 +336,7 @@ unsigned char String::concat(const String &s) {
             return 0;
         if (s.len() == 0)
             return 1;
-        if (!reserve(newlen))
+        if (!grow(newlen))
             return 0;
         memmove_P(wbuffer() + len(), buffer(), len());
         setLen(newlen);
@@ -327,7 +353,7 @@ unsigned char String::concat(const char *cstr, unsigned int length) {
         return 0;
     if (length == 0)
         return 1;
-    if (!reserve(newlen))
+    if (!grow(newlen))
         return 0;
     memmove_P(wbuffer() + len(), cstr, length + 1);
     setLen(newlen);
@@ -395,7 +421,7 @@ unsigned char String::concat(const __FlashStringHelper * str) {
     int length = strlen_P((PGM_P)str);
     if (length == 0) return 1;
     unsigned int newlen = len() + length;
-    if (!reserve(newlen)) return 0;
+    if (!grow(newlen)) return 0;
     memcpy_P(wbuffer() + len(), (PGM_P)str, length + 1);
     setLen(newlen);
     return 1;
@@ -75,6 +75,9 @@ class String {
         // is left unchanged).  reserve(0), if successful, will validate an
         // invalid string (i.e., "if (s)" will be true afterwards)
         unsigned char reserve(unsigned int size);
+        // release the unused part of the buffer (moving back into the
+        // object itself for short strings) once a string is complete
+        void shrink_to_fit(void);
         inline unsigned int length(void) const {
             if(buffer()) {
                 return len();
@@ -312,6 +315,7 @@ class String {
         void init(void);
         void invalidate(void);
         unsigned char changeBuffer(unsigned int maxStrLen);
+        unsigned char grow(unsigned int size);
 
         // copy and move
         String & copy(const char *cstr, unsigned int length);
@@ -21,6 +21,9 @@
 #include <debug.h>
 #include <Arduino.h>
 #include <cxxabi.h>
+#ifdef UMM_HEAP_PROFILER
+#include "heap_profiler.h"
+#endif
 
 using __cxxabiv1::__guard;
 
@@ -40,6 +43,9 @@ void *operator new(size_t size)
         umm_last_fail_alloc_addr = __builtin_return_address(0);
         umm_last_fail_alloc_size = size;
     }
+#ifdef UMM_HEAP_PROFILER
+    heap_profiler_retag(ret, NULL, (uint32_t)__builtin_return_address(0));
+#endif
    return ret;
 }
 
@@ -50,6 +56,9 @@ void *operator new[](size_t size)
         umm_last_fail_alloc_addr = __builtin_return_address(0);
         umm_last_fail_alloc_size = size;
     }
+#ifdef UMM_HEAP_PROFILER
+    heap_profiler_retag(ret, NULL, (uint32_t)__builtin_return_address(0));
+#endif
     return ret;
 }
 #endif // arduino's std::new legacy
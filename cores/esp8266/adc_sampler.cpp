@@ -0,0 +1,210 @@
+/*
+ adc_sampler.cpp - ADC sampling at a fixed rate into a ring buffer
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <Arduino.h>
+#include <osapi.h>
+#include <user_interface.h>
+#include "adc_sampler.h"
+
+// The ring is written by the timer task (or the burst) and read from CONT:
+// each side only moves its own index
+static uint16_t *_ring;
+static size_t _size;
+static volatile size_t _head; // next write
+static volatile size_t _tail; // next read
+
+static uint32_t _period;      // cycles, timer paced
+static uint32_t _next;        // cycle count of the next reading
+static ETSTimer _timer;
+
+static volatile uint32_t _samples;
+static volatile uint32_t _dropped;
+static volatile uint32_t _taken;      // timer paced readings, stored or not
+static volatile uint16_t _min;
+static volatile uint16_t _max;
+static volatile uint64_t _sum;
+static uint32_t _rate;        // requested, or measured by the last burst
+static uint64_t _start;       // micros64() at reset
+
+static void store(uint16_t value)
+{
+    size_t next = _head + 1;
+    if (next == _size) {
+        next = 0;
+    }
+    if (next == _tail) {
+        _dropped++;
+        return;
+    }
+    _ring[_head] = value;
+    _head = next;
+    if (!_samples || value < _min) {
+        _min = value;
+    }
+    if (!_samples || value > _max) {
+        _max = value;
+    }
+    _sum += value;
+    _samples++;
+}
+
+// Runs from the SDK's timer task, not from an interrupt: the flash cache is
+// on and system_adc_read() may be called
+static void onTick(void*)
+{
+    if ((int32_t)(ESP.getCycleCount() - _next) < 0) {
+        return;
+    }
+    store(system_adc_read());
+    _taken++;
+    _next += _period;
+    uint32_t late = ESP.getCycleCount() - _next;
+    if ((int32_t)late >= 0) {
+        // The loop held the timer task for whole periods: count them and
+        // move the schedule past now, on the same grid
+        uint32_t missed = late / _period + 1;
+        _dropped += missed;
+        _next += missed * _period;
+    }
+}
+
+bool adc_sampler_begin(uint32_t rate_hz, size_t size)
+{
+    adc_sampler_end();
+    if (size < 2 || rate_hz > ADC_SAMPLER_MAX_RATE) {
+        return false;
+    }
+    if (rate_hz) {
+        // A reading must fit well within a period
+        uint32_t start = ESP.getCycleCount();
+        (void)system_adc_read();
+        uint32_t read = ESP.getCycleCount() - start;
+        if (2 * read > ESP.getCpuFreqMHz() * 1000000 / rate_hz) {
+            return false;
+        }
+    }
+    _ring = (uint16_t*)malloc(size * sizeof(_ring[0]));
+    if (!_ring) {
+        return false;
+    }
+    _size = size;
+    _head = _tail = 0;
+    adc_sampler_reset_stats();
+
+    if (rate_hz) {
+        _period = ESP.getCpuFreqMHz() * 1000000 / rate_hz;
+        _rate = rate_hz;
+        _next = ESP.getCycleCount() + _period;
+        // The SDK timer has a 1ms resolution: tick at the sampling period
+        // when it is a whole number of ms, otherwise every ms and let the
+        // cycle counter decide
+        uint32_t ms = (1000 % rate_hz) ? 1 : 1000 / rate_hz;
+        os_timer_setfn(&_timer, onTick, nullptr);
+        os_timer_arm(&_timer, ms, true);
+    }
+    return true;
+}
+
+void adc_sampler_end(void)
+{
+    if (_period) {
+        os_timer_disarm(&_timer);
+        _period = 0;
+    }
+    free(_ring);
+    _ring = nullptr;
+    _size = 0;
+}
+
+size_t adc_sampler_burst(size_t count, uint8_t clk_div)
+{
+    if (!_ring || _period) {
+        return 0;
+    }
+    uint16_t chunk[64];
+    size_t done = 0;
+    while (done < count) {
+        uint16_t n = std::min(count - done, sizeof(chunk) / sizeof(chunk[0]));
+        uint32_t start = ESP.getCycleCount();
+        system_adc_read_fast(chunk, n, clk_div);
+        uint32_t cycles = ESP.getCycleCount() - start;
+        if (cycles) {
+            _rate = (uint64_t)n * ESP.getCpuFreqMHz() * 1000000 / cycles;
+        }
+        for (uint16_t i = 0; i < n; i++) {
+            store(chunk[i]);
+        }
+        done += n;
+        optimistic_yield(10000);
+    }
+    return done;
+}
+
+size_t adc_sampler_available(void)
+{
+    size_t head = _head;
+    return (head >= _tail) ? head - _tail : _size - _tail + head;
+}
+
+size_t adc_sampler_read(uint16_t *samples, size_t max)
+{
+    size_t n = 0;
+    size_t tail = _tail;
+    while (n < max && tail != _head) {
+        samples[n++] = _ring[tail];
+        if (++tail == _size) {
+            tail = 0;
+        }
+    }
+    _tail = tail;
+    return n;
+}
+
+void adc_sampler_stats(adc_sampler_stats_t *stats)
+{
+    uint64_t us = micros64() - _start;
+    uint32_t savedPS = xt_rsil(15);
+    uint64_t sum = _sum;
+    stats->samples = _samples;
+    stats->dropped = _dropped;
+    stats->min = _min;
+    stats->max = _max;
+    uint32_t taken = _taken;
+    xt_wsr_ps(savedPS);
+    stats->mean = stats->samples ? sum / stats->samples : 0;
+    stats->rate = _rate;
+    if (_period && us > 100000) {
+        // Timer paced: readings actually taken, over at least 100ms
+        stats->rate = (uint64_t)taken * 1000000 / us;
+    }
+}
+
+void adc_sampler_reset_stats(void)
+{
+    uint32_t savedPS = xt_rsil(15);
+    _samples = 0;
+    _dropped = 0;
+    _taken = 0;
+    _min = 0;
+    _max = 0;
+    _sum = 0;
+    xt_wsr_ps(savedPS);
+    _start = micros64();
+}
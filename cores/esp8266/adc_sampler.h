@@ -0,0 +1,84 @@
+/*
+ adc_sampler.h - ADC sampling at a fixed rate into a ring buffer
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+/*
+ * Collects ADC (A0) readings into a ring buffer, either:
+ *
+ * - paced by an SDK timer: adc_sampler_begin() takes one reading per
+ *   period, scheduled on the cycle counter so that samples stay on an even
+ *   grid, up to ADC_SAMPLER_MAX_RATE readings per second. The SDK's
+ *   system_adc_read() is not in IRAM, so readings are taken from the SDK's
+ *   timer task rather than from an interrupt: they wait while loop() runs
+ *   without yielding, and are 1ms late at worst when the period is not a
+ *   whole number of ms. Periods missed while the loop was busy are counted
+ *   as dropped. Rates whose period is not at least twice the time of a
+ *   reading are refused.
+ *
+ * - in bursts: adc_sampler_burst() blocks while the SDK's
+ *   system_adc_read_fast() reads at the hardware rate (tens of kHz, set by
+ *   clk_div 8..32). It can only be used with WiFi off
+ *   (WiFi.forceSleepBegin()), interrupts are disabled meanwhile.
+ *
+ * Readings are read back from the loop with adc_sampler_read(). Samples
+ * that don't fit in the ring, and missed periods, are counted as dropped.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ADC_SAMPLER_MAX_RATE
+#define ADC_SAMPLER_MAX_RATE 1000
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t rate;      // measured readings per second since reset (after 100ms), 0 until known
+    uint32_t samples;   // stored since reset
+    uint32_t dropped;   // lost since reset
+    uint16_t min;       // of the stored samples
+    uint16_t max;
+    uint16_t mean;
+} adc_sampler_stats_t;
+
+// Allocates a ring of size samples, with timer pacing when rate_hz is not 0
+bool adc_sampler_begin(uint32_t rate_hz, size_t size);
+void adc_sampler_end(void);
+// Fast readings into the ring, returns the count stored
+size_t adc_sampler_burst(size_t count, uint8_t clk_div);
+
+// Samples waiting in the ring
+size_t adc_sampler_available(void);
+// Copies up to max samples, oldest first, returns the count
+size_t adc_sampler_read(uint16_t *samples, size_t max);
+
+void adc_sampler_stats(adc_sampler_stats_t *stats);
+void adc_sampler_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADC_SAMPLER_H
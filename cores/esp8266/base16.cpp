@@ -0,0 +1,106 @@
+/**
+ * base16.cpp - hexadecimal encoding and decoding
+ *
+ * Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ * This file is part of the ESP8266 core for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "Arduino.h"
+#include "base16.h"
+
+static const char base16Digits[] PROGMEM = "0123456789abcdef0123456789ABCDEF";
+
+// Value of every ASCII character, 0xff when it is not a digit
+static const uint8_t base16Values[128] PROGMEM = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+static char* encodeDigits(const uint8_t * data, size_t length, char * out, bool upperCase)
+{
+    const char* digits = base16Digits + (upperCase ? 16 : 0);
+    for (size_t i = 0; i < length; i++)
+    {
+        uint8_t b = data[i];
+        char high = pgm_read_byte(digits + (b >> 4));
+        char low = pgm_read_byte(digits + (b & 0xf));
+        out[2 * i] = high;
+        out[2 * i + 1] = low;
+    }
+    return out + 2 * length;
+}
+
+size_t base16::encode(const uint8_t * data, size_t length, char * out, bool upperCase)
+{
+    *encodeDigits(data, length, out, upperCase) = 0;
+    return 2 * length;
+}
+
+size_t base16::encode(const uint8_t * data, size_t length, Print& out, bool upperCase)
+{
+    char buf[64];
+    size_t written = 0;
+    for (size_t done = 0; done < length; done += sizeof(buf) / 2)
+    {
+        size_t n = std::min(sizeof(buf) / 2, length - done);
+        encodeDigits(data + done, n, buf, upperCase);
+        size_t w = out.write((const uint8_t*)buf, 2 * n);
+        written += w;
+        if (w != 2 * n)
+            break;
+    }
+    return written;
+}
+
+String base16::encode(const uint8_t * data, size_t length, bool upperCase)
+{
+    String s;
+    if (s.reserve(2 * length))
+    {
+        char buf[65];
+        for (size_t done = 0; done < length; done += (sizeof(buf) - 1) / 2)
+        {
+            size_t n = std::min((sizeof(buf) - 1) / 2, length - done);
+            encodeDigits(data + done, n, buf, upperCase);
+            s.concat(buf, 2 * n);
+        }
+    }
+    return s;
+}
+
+int base16::decode(const char * in, size_t length, uint8_t * out, size_t outSize)
+{
+    if ((length & 1) || length / 2 > outSize)
+        return -1;
+    const uint8_t* s = (const uint8_t*)in;
+    for (size_t i = 0; i < length / 2; i++, s += 2)
+    {
+        uint8_t high = s[0] < 128 ? pgm_read_byte(base16Values + s[0]) : 0xff;
+        uint8_t low = s[1] < 128 ? pgm_read_byte(base16Values + s[1]) : 0xff;
+        if ((high | low) & 0xf0)
+            return -1;
+        out[i] = high << 4 | low;
+    }
+    return length / 2;
+}
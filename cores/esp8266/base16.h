@@ -0,0 +1,49 @@
+/**
+ * base16.h - hexadecimal encoding and decoding
+ *
+ * Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ * This file is part of the ESP8266 core for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef CORE_BASE16_H_
+#define CORE_BASE16_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <WString.h>
+#include <Print.h>
+
+class base16
+{
+public:
+    // Writes 2 * length digits and a terminating zero to out,
+    // returns the number of digits
+    static size_t encode(const uint8_t * data, size_t length, char * out, bool upperCase = false);
+    static size_t encode(const uint8_t * data, size_t length, Print& out, bool upperCase = false);
+    static String encode(const uint8_t * data, size_t length, bool upperCase = false);
+
+    // Either case is accepted. Returns the number of bytes written to out,
+    // or -1 when a digit is invalid, length is odd or out is too small.
+    static int decode(const char * in, size_t length, uint8_t * out, size_t outSize);
+    static int inline decode(const String& text, uint8_t * out, size_t outSize)
+    {
+        return decode(text.c_str(), text.length(), out, outSize);
+    }
+};
+
+#endif /* CORE_BASE16_H_ */
@@ -28,6 +28,171 @@ extern "C" {
 }
 #include "base64.h"
 
+static const char base64Symbols[] PROGMEM = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#define B64_SKIP    0x40 // whitespace
+#define B64_PAD     0x41 // '='
+#define B64_INVALID 0x80
+
+// Value of every ASCII character
+static const uint8_t base64Values[128] PROGMEM = {
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x40, 0x40, 0x80, 0x80, 0x40, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x40, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x3e, 0x80, 0x3e, 0x80, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x80, 0x80, 0x80, 0x41, 0x80, 0x80,
+    0x80, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x80, 0x80, 0x80, 0x80, 0x3f,
+    0x80, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0x80, 0x80, 0x80, 0x80, 0x80,
+};
+
+// Input bytes encoded per block, 64 characters
+#define BLOCK_BYTES 48
+
+static inline char symbol(uint32_t v)
+{
+    return pgm_read_byte(base64Symbols + (v & 0x3f));
+}
+
+// Encodes the length / 3 complete groups of data, with a newline every
+// BASE64_CHARS_PER_LINE characters unless groups is negative (like libb64),
+// returns the end of the output
+static char* encodeGroups(const uint8_t * data, size_t length, char * out, int8_t& groups)
+{
+    for (const uint8_t * end = data + length / 3 * 3; data < end; data += 3)
+    {
+        uint32_t v = data[0] << 16 | data[1] << 8 | data[2];
+        out[0] = symbol(v >> 18);
+        out[1] = symbol(v >> 12);
+        out[2] = symbol(v >> 6);
+        out[3] = symbol(v);
+        out += 4;
+        if (groups >= 0 && ++groups == BASE64_CHARS_PER_LINE / 4)
+        {
+            *out++ = '\n';
+            groups = 0;
+        }
+    }
+    return out;
+}
+
+// The last 1 or 2 bytes and their padding
+static char* encodeTail(const uint8_t * data, size_t length, char * out)
+{
+    uint32_t v = data[0] << 16 | (length > 1 ? data[1] << 8 : 0);
+    out[0] = symbol(v >> 18);
+    out[1] = symbol(v >> 12);
+    out[2] = length > 1 ? symbol(v >> 6) : '=';
+    out[3] = '=';
+    return out + 4;
+}
+
+static inline uint8_t value(uint8_t c)
+{
+    return c < 128 ? pgm_read_byte(base64Values + c) : B64_INVALID;
+}
+
+// Returns the number of bytes written to out, or -1 on invalid input or
+// when out is full
+static int decodeChars(Base64Decoder::State& s, const uint8_t * in, size_t length, uint8_t * out, size_t outSize)
+{
+    uint8_t * o = out;
+    uint8_t * outEnd = out + outSize;
+    const uint8_t * end = in + length;
+    uint32_t bits = s.bits;
+    uint8_t count = s.count;
+    while (in < end)
+    {
+        if (!count && end - in >= 4)
+        {
+            // 4 symbols in a row, the common case
+            uint8_t a = value(in[0]);
+            uint8_t b = value(in[1]);
+            uint8_t c = value(in[2]);
+            uint8_t d = value(in[3]);
+            if (!((a | b | c | d) & 0xc0))
+            {
+                if (s.done || outEnd - o < 3)
+                    return -1;
+                bits = a << 18 | b << 12 | c << 6 | d;
+                o[0] = bits >> 16;
+                o[1] = bits >> 8;
+                o[2] = bits;
+                o += 3;
+                in += 4;
+                continue;
+            }
+        }
+
+        uint8_t v = value(*in++);
+        if (v < 64)
+        {
+            if (s.padding || s.done)
+                return -1;
+            bits = bits << 6 | v;
+            if (++count == 4)
+            {
+                if (outEnd - o < 3)
+                    return -1;
+                o[0] = bits >> 16;
+                o[1] = bits >> 8;
+                o[2] = bits;
+                o += 3;
+                count = 0;
+            }
+        }
+        else if (v == B64_PAD)
+        {
+            if (count < 2 || count + ++s.padding > 4)
+                return -1;
+            if (count + s.padding == 4)
+            {
+                // 2 symbols make 1 byte, 3 make 2
+                if (outEnd - o < count - 1)
+                    return -1;
+                if (count == 2)
+                {
+                    *o++ = bits >> 4;
+                }
+                else
+                {
+                    *o++ = bits >> 10;
+                    *o++ = bits >> 2;
+                }
+                count = 0;
+                s.padding = 0;
+                s.done = true;
+            }
+        }
+        else if (v != B64_SKIP)
+        {
+            return -1;
+        }
+    }
+    s.bits = bits;
+    s.count = count;
+    return o - out;
+}
+
+// What is left of unpadded input
+static int decodeEnd(Base64Decoder::State& s, uint8_t * out, size_t outSize)
+{
+    if (s.padding || s.count == 1 || (s.count && outSize < (size_t)s.count - 1))
+        return -1;
+    int n = 0;
+    if (s.count == 2)
+    {
+        out[n++] = s.bits >> 4;
+    }
+    else if (s.count == 3)
+    {
+        out[n++] = s.bits >> 10;
+        out[n++] = s.bits >> 2;
+    }
+    s.count = 0;
+    return n;
+}
+
 /**
  * convert input data to base64
  * @param data const uint8_t *
@@ -38,39 +203,188 @@ String base64::encode(const uint8_t * data, size_t length, bool doNewLines)
 {
     String base64;
 
-    // base64 needs more size then the source data, use cencode.h macros
-    size_t size = ((doNewLines ? base64_encode_expected_len( length )
-                    : base64_encode_expected_len_nonewlines( length )) + 1);
+    if (base64.reserve(encodedLength(length, doNewLines)))
+    {
+        int8_t groups = doNewLines ? 0 : -1;
+        char buf[BLOCK_BYTES / 3 * 4 + 1 /* newline */];
+        for (size_t len = 0; len < length; len += BLOCK_BYTES)
+        {
+            size_t blocklen = std::min((size_t)BLOCK_BYTES, length - len);
+            char* end = encodeGroups(data + len, blocklen, buf, groups);
+            if (blocklen % 3)
+                end = encodeTail(data + len + blocklen / 3 * 3, blocklen % 3, end);
+            base64.concat(buf, end - buf);
+        }
+    }
+    else
+    {
+        base64 = F("-FAIL-");
+    }
+
+    return base64;
+}
 
-    if (base64.reserve(size))
+size_t base64::encodedLength(size_t length, bool doNewLines)
+{
+    // a newline follows every complete line, even the last one
+    return (length + 2) / 3 * 4 + (doNewLines ? length / (BASE64_CHARS_PER_LINE / 4 * 3) : 0);
+}
+
+size_t base64::encode(const uint8_t * data, size_t length, char * out, size_t outSize, bool doNewLines)
+{
+    if (outSize < encodedLength(length, doNewLines) + 1)
+        return 0;
+    int8_t groups = doNewLines ? 0 : -1;
+    char* end = encodeGroups(data, length, out, groups);
+    if (length % 3)
+        end = encodeTail(data + length / 3 * 3, length % 3, end);
+    *end = 0;
+    return end - out;
+}
+
+size_t base64::encode(const uint8_t * data, size_t length, Print& out, bool doNewLines)
+{
+    Base64Encoder encoder(out, doNewLines);
+    encoder.write(data, length);
+    return encoder.end();
+}
+
+size_t base64::encode(Stream& in, Print& out, size_t maxLength, bool doNewLines)
+{
+    Base64Encoder encoder(out, doNewLines);
+    uint8_t buf[BLOCK_BYTES];
+    while (maxLength)
     {
+        size_t n = in.readBytes(buf, std::min(sizeof(buf), maxLength));
+        if (!n || encoder.write(buf, n) != n)
+            break;
+        maxLength -= n;
+    }
+    return encoder.end();
+}
+
+int base64::decode(const char * in, size_t length, uint8_t * out, size_t outSize)
+{
+    Base64Decoder::State state = { 0, 0, 0, false };
+    int n = decodeChars(state, (const uint8_t*)in, length, out, outSize);
+    if (n < 0)
+        return -1;
+    int last = decodeEnd(state, out + n, outSize - n);
+    return last < 0 ? -1 : n + last;
+}
+
+Base64Encoder::Base64Encoder(Print& out, bool doNewLines):
+    _out(out), _written(0), _pendingLength(0), _groups(doNewLines ? 0 : -1)
+{
+}
+
+size_t Base64Encoder::write(uint8_t c)
+{
+    return write(&c, 1);
+}
 
-        base64_encodestate _state;
-        if (doNewLines)
+size_t Base64Encoder::write(const uint8_t * data, size_t length)
+{
+    // the pending group, 16 more groups and 2 newlines at most
+    char buf[4 + BLOCK_BYTES / 3 * 4 + 2];
+    char* end = buf;
+    size_t done = 0;
+
+    if (_pendingLength)
+    {
+        while (_pendingLength < 3 && done < length)
         {
-            base64_init_encodestate(&_state);
+            if (_pendingLength == 2)
+            {
+                uint8_t group[3] = { _pending[0], _pending[1], data[done++] };
+                end = encodeGroups(group, 3, end, _groups);
+                _pendingLength = 0;
+                break;
+            }
+            _pending[_pendingLength++] = data[done++];
         }
-        else
+    }
+
+    while (length - done >= 3)
+    {
+        size_t blocklen = std::min((size_t)BLOCK_BYTES, (length - done) / 3 * 3);
+        end = encodeGroups(data + done, blocklen, end, _groups);
+        done += blocklen;
+        size_t n = end - buf;
+        size_t written = _out.write((const uint8_t*)buf, n);
+        _written += written;
+        if (written != n)
         {
-            base64_init_encodestate_nonewlines(&_state);
+            setWriteError();
+            return 0;
         }
+        end = buf;
+    }
 
-        constexpr size_t BUFSIZE = 48;
-        char buf[BUFSIZE + 1 /* newline */ + 1 /* NUL */];
-        for (size_t len = 0; len < length; len += BUFSIZE * 3 / 4)
+    if (end != buf)
+    {
+        size_t n = end - buf;
+        size_t written = _out.write((const uint8_t*)buf, n);
+        _written += written;
+        if (written != n)
         {
-            size_t blocklen = base64_encode_block((const char*) data + len,
-                                                  std::min( BUFSIZE * 3 / 4, length - len ), buf, &_state);
-            buf[blocklen] = '\0';
-            base64 += buf;
+            setWriteError();
+            return 0;
         }
-        if (base64_encode_blockend(buf, &_state))
-            base64 += buf;
     }
-    else
+
+    while (done < length)
+        _pending[_pendingLength++] = data[done++];
+    return length;
+}
+
+size_t Base64Encoder::end()
+{
+    if (_pendingLength)
     {
-        base64 = F("-FAIL-");
+        char buf[4];
+        encodeTail(_pending, _pendingLength, buf);
+        _written += _out.write((const uint8_t*)buf, sizeof(buf));
+        _pendingLength = 0;
     }
+    return _written;
+}
 
-    return base64;
+Base64Decoder::Base64Decoder(Print& out): _out(out), _state{ 0, 0, 0, false }
+{
+}
+
+size_t Base64Decoder::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t Base64Decoder::write(const uint8_t * data, size_t length)
+{
+    if (getWriteError())
+        return 0;
+    uint8_t buf[BLOCK_BYTES];
+    for (size_t done = 0; done < length; done += BLOCK_BYTES / 3 * 4)
+    {
+        // 64 characters and the 3 pending ones make 16 groups at most
+        int n = decodeChars(_state, data + done, std::min((size_t)BLOCK_BYTES / 3 * 4, length - done), buf, sizeof(buf));
+        if (n < 0 || _out.write(buf, n) != (size_t)n)
+        {
+            setWriteError();
+            return 0;
+        }
+    }
+    return length;
+}
+
+bool Base64Decoder::end()
+{
+    uint8_t buf[2];
+    int n = getWriteError() ? -1 : decodeEnd(_state, buf, sizeof(buf));
+    if (n < 0 || _out.write(buf, n) != (size_t)n)
+    {
+        setWriteError();
+        return false;
+    }
+    return true;
 }
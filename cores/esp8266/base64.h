@@ -25,6 +25,12 @@
 #ifndef CORE_BASE64_H_
 #define CORE_BASE64_H_
 
+#include <stddef.h>
+#include <stdint.h>
+#include <WString.h>
+#include <Print.h>
+#include <Stream.h>
+
 class base64
 {
 public:
@@ -36,8 +42,90 @@ public:
     {
         return encode( (const uint8_t *) text.c_str(), text.length(), doNewLines );
     }
-private:
+
+    // Without heap: the functions below take the output buffer or Print,
+    // and do not add newlines unless asked to
+
+    // Characters needed to encode length bytes, without the terminating zero
+    static size_t encodedLength(size_t length, bool doNewLines = false);
+    // Upper bound of the bytes decoded from length characters
+    static size_t decodedLength(size_t length)
+    {
+        return (length + 3) / 4 * 3;
+    }
+
+    // Returns the number of characters written to out, followed by a zero,
+    // or 0 when outSize is less than encodedLength() + 1
+    static size_t encode(const uint8_t * data, size_t length, char * out, size_t outSize, bool doNewLines = false);
+    static size_t encode(const uint8_t * data, size_t length, Print& out, bool doNewLines = false);
+    // Encodes up to maxLength bytes read from in
+    static size_t encode(Stream& in, Print& out, size_t maxLength = (size_t) -1, bool doNewLines = false);
+
+    // Whitespace is skipped, padding is optional and the URL safe alphabet
+    // ('-' and '_') is accepted too. Returns the number of bytes written to
+    // out, or -1 when the input is invalid or does not fit.
+    static int decode(const char * in, size_t length, uint8_t * out, size_t outSize);
+    static int inline decode(const String& text, uint8_t * out, size_t outSize)
+    {
+        return decode(text.c_str(), text.length(), out, outSize);
+    }
 };
 
+// Print adapters: the data written to them is encoded or decoded on the fly
+// and written to another Print, in blocks, without allocating.
+//
+//   Base64Encoder encoder(client);
+//   encoder.print(user);
+//   encoder.print(':');
+//   encoder.print(password);
+//   encoder.end();
+
+class Base64Encoder: public Print
+{
+public:
+    Base64Encoder(Print& out, bool doNewLines = false);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t * data, size_t length) override;
+    using Print::write;
+
+    // Writes the last group and its padding, returns the number of
+    // characters written to out since the beginning
+    size_t end();
+
+protected:
+    Print& _out;
+    size_t _written;
+    uint8_t _pending[2];
+    uint8_t _pendingLength;
+    int8_t _groups;
+};
+
+class Base64Decoder: public Print
+{
+public:
+    Base64Decoder(Print& out);
+
+    // An invalid character sets the write error and stops decoding
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t * data, size_t length) override;
+    using Print::write;
+
+    // Writes what is left of unpadded input, returns false when the input
+    // was invalid or truncated
+    bool end();
+
+    struct State
+    {
+        uint32_t bits;
+        uint8_t count;
+        uint8_t padding;
+        bool done;
+    };
+
+protected:
+    Print& _out;
+    State _state;
+};
 
 #endif /* CORE_BASE64_H_ */
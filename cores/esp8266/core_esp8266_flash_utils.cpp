@@ -24,6 +24,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "flash_utils.h"
+#include "coredecls.h"
 
 extern "C" {
 
@@ -33,6 +34,8 @@ int SPIEraseAreaEx(const uint32_t start, const uint32_t size)
         return 1;
     }
 
+    flash_hash_invalidate(start, size);
+
     const uint32_t sectors_per_block = FLASH_BLOCK_SIZE / FLASH_SECTOR_SIZE;
     uint32_t current_sector = start / FLASH_SECTOR_SIZE;
     uint32_t sector_count = (size + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE;
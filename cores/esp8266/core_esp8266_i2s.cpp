@@ -28,8 +28,10 @@
 
 extern "C" {
 
-#define SLC_BUF_CNT (8)  // Number of buffers in the I2S circular buffer
-#define SLC_BUF_LEN (64) // Length of one buffer, in 32-bit words.
+#define SLC_BUF_CNT (8)  // Default number of buffers in the I2S circular buffer
+#define SLC_BUF_LEN (64) // Default length of one buffer, in 32-bit words.
+#define SLC_BUF_CNT_MAX (128)
+#define SLC_BUF_LEN_MAX (1023) // In 32-bit words, DMA descriptor sizes are 12-bit byte counts
 
 // We use a queue to keep track of the DMA buffers that are empty. The ISR
 // will push buffers to the back of the queue, the I2S transmitter will pull
@@ -54,12 +56,17 @@ typedef struct slc_queue_item {
 } slc_queue_item_t;
 
 typedef struct i2s_state {
-  uint32_t *       slc_queue[SLC_BUF_CNT];
+  uint16_t         buf_cnt; // Number of buffers in the ring
+  uint16_t         buf_len; // Length of one buffer, in 32-bit words
+  uint32_t **      slc_queue; // buf_cnt entries
   volatile uint8_t slc_queue_len;
-  uint32_t *       slc_buf_pntr[SLC_BUF_CNT]; // Pointer to the I2S DMA buffer data
-  slc_queue_item_t slc_items[SLC_BUF_CNT]; // I2S DMA buffer descriptors
+  uint32_t **      slc_buf_pntr; // Pointer to the I2S DMA buffer data
+  slc_queue_item_t *slc_items; // I2S DMA buffer descriptors
   uint32_t *       curr_slc_buf; // Current buffer for writing
   uint32_t         curr_slc_buf_pos; // Position in the current buffer
+  volatile bool    held; // curr_slc_buf taken by i2s_(rx_)get_buffer(), not yet submitted or released
+  volatile bool    late; // The DMA went past curr_slc_buf since it was taken
+  volatile uint32_t xruns; // TX: buffers played before their data was complete, RX: buffers lost
   void             (*callback) (void);
   // Callback function should be defined as 'void ICACHE_RAM_ATTR function_name()',
   // and be placed in IRAM for faster execution. Avoid long computational tasks in this
@@ -73,6 +80,11 @@ static i2s_state_t *tx = NULL;
 // Last I2S sample rate requested
 static uint32_t _i2s_sample_rate;
 
+// TX clock pins taken by the next begin and given back by i2s_end(),
+// the bitstream leaves WS, and BCK without clock_out, to the sketch
+static bool _i2s_tx_ws = true;
+static bool _i2s_tx_bck = true;
+
 // IOs used for I2S. Not defined in i2s.h, unfortunately.
 // Note these are internal GPIO numbers and not pins on an
 // Arduino board. Users need to verify their particular wiring.
@@ -87,7 +99,7 @@ static bool _i2s_is_full(const i2s_state_t *ch) {
   if (!ch) {
     return false;
   }
-  return (ch->curr_slc_buf_pos==SLC_BUF_LEN || ch->curr_slc_buf==NULL) && (ch->slc_queue_len == 0);
+  return (ch->curr_slc_buf_pos==ch->buf_len || ch->curr_slc_buf==NULL) && (ch->slc_queue_len == 0);
 }
 
 bool i2s_is_full() {
@@ -102,7 +114,7 @@ static bool _i2s_is_empty(const i2s_state_t *ch) {
   if (!ch) {
     return false;
   }
-  return (ch->slc_queue_len >= SLC_BUF_CNT-1);
+  return (ch->slc_queue_len >= ch->buf_cnt-1);
 }
 
 bool i2s_is_empty() {
@@ -117,7 +129,8 @@ static uint16_t _i2s_available(const i2s_state_t *ch) {
   if (!ch) {
     return 0;
   }
-  return (SLC_BUF_CNT - ch->slc_queue_len) * SLC_BUF_LEN;
+  uint32_t words = (ch->buf_cnt - ch->slc_queue_len) * ch->buf_len;
+  return (words > 0xffff) ? 0xffff : words;
 }
 
 uint16_t i2s_available(){
@@ -139,19 +152,36 @@ static uint32_t * ICACHE_RAM_ATTR i2s_slc_queue_next_item(i2s_state_t *ch) {
   return item;
 }
 
-// Append an item to the end of the queue from receive
-static void ICACHE_RAM_ATTR i2s_slc_queue_append_item(i2s_state_t *ch, uint32_t *item) {
+// Append an item to the end of the queue from receive, returns false when
+// data was lost: the item was still queued, or the queue was full
+static bool ICACHE_RAM_ATTR i2s_slc_queue_append_item(i2s_state_t *ch, uint32_t *item) {
   // Shift everything up, except for the one corresponding to this item
-  for (int i=0, dest=0; i < ch->slc_queue_len; i++) {
+  int dest = 0;
+  for (int i=0; i < ch->slc_queue_len; i++) {
     if (ch->slc_queue[i] != item) {
       ch->slc_queue[dest++] = ch->slc_queue[i];
     }
   }
-  if (ch->slc_queue_len < SLC_BUF_CNT - 1) {
+  bool lost = (dest != ch->slc_queue_len);
+  ch->slc_queue_len = dest;
+  if (ch->slc_queue_len < ch->buf_cnt - 1) {
     ch->slc_queue[ch->slc_queue_len++] = item;
   } else {
     ch->slc_queue[ch->slc_queue_len] = item;
+    lost = true;
+  }
+  return !lost;
+}
+
+// The DMA is done with buf. Returns true when the application still held
+// it: taken and not yet submitted or released, or partly written or read
+static bool ICACHE_RAM_ATTR i2s_slc_overtaken(i2s_state_t *ch, const uint32_t *buf) {
+  if (buf != ch->curr_slc_buf || ch->late) {
+    return false;
   }
+  // It is back in the queue, the application moves on to the next one
+  ch->late = true;
+  return ch->held || (ch->curr_slc_buf_pos > 0 && ch->curr_slc_buf_pos < ch->buf_len);
 }
 
 static void ICACHE_RAM_ATTR i2s_slc_isr(void) {
@@ -161,9 +191,14 @@ static void ICACHE_RAM_ATTR i2s_slc_isr(void) {
   if (slc_intr_status & SLCIRXEOF) {
     slc_queue_item_t *finished_item = (slc_queue_item_t *)SLCRXEDA;
     // Zero the buffer so it is mute in case of underflow
-    ets_memset((void *)finished_item->buf_ptr, 0x00, SLC_BUF_LEN * 4);
-    if (tx->slc_queue_len >= SLC_BUF_CNT-1) {
-      // All buffers are empty. This means we have an underflow
+    ets_memset((void *)finished_item->buf_ptr, 0x00, tx->buf_len * 4);
+    if (i2s_slc_overtaken(tx, finished_item->buf_ptr)) {
+      // Played before the application was done with it
+      tx->xruns++;
+    }
+    if (tx->slc_queue_len >= tx->buf_cnt-1) {
+      // All buffers are empty: nothing is being sent, which is only an
+      // underrun if the application was filling the current one
       i2s_slc_queue_next_item(tx); // Free space for finished_item
     }
     tx->slc_queue[tx->slc_queue_len++] = finished_item->buf_ptr;
@@ -175,7 +210,10 @@ static void ICACHE_RAM_ATTR i2s_slc_isr(void) {
     slc_queue_item_t *finished_item = (slc_queue_item_t *)SLCTXEDA;
     // Set owner back to 1 (SW) or else RX stops.  TX has no such restriction.
     finished_item->owner = 1;
-    i2s_slc_queue_append_item(rx, finished_item->buf_ptr);
+    bool overtaken = i2s_slc_overtaken(rx, finished_item->buf_ptr);
+    if (!i2s_slc_queue_append_item(rx, finished_item->buf_ptr) || overtaken) {
+      rx->xruns++;
+    }
     if (rx->callback) {
       rx->callback();
     }
@@ -193,22 +231,29 @@ void i2s_rx_set_callback(void (*callback) (void)) {
 
 static bool _alloc_channel(i2s_state_t *ch) {
   ch->slc_queue_len = 0;
-  for (int x=0; x<SLC_BUF_CNT; x++) {
-    ch->slc_buf_pntr[x] = (uint32_t *)malloc(SLC_BUF_LEN * sizeof(ch->slc_buf_pntr[0][0]));
+  ch->slc_queue = (uint32_t **)calloc(ch->buf_cnt, sizeof(ch->slc_queue[0]));
+  ch->slc_buf_pntr = (uint32_t **)calloc(ch->buf_cnt, sizeof(ch->slc_buf_pntr[0]));
+  ch->slc_items = (slc_queue_item_t *)calloc(ch->buf_cnt, sizeof(ch->slc_items[0]));
+  if (!ch->slc_queue || !ch->slc_buf_pntr || !ch->slc_items) {
+    // OOM, the upper layer will free up any partially allocated channels.
+    return false;
+  }
+  for (int x=0; x<ch->buf_cnt; x++) {
+    ch->slc_buf_pntr[x] = (uint32_t *)malloc(ch->buf_len * sizeof(ch->slc_buf_pntr[0][0]));
     if (!ch->slc_buf_pntr[x]) {
       // OOM, the upper layer will free up any partially allocated channels.
       return false;
     }
-    memset(ch->slc_buf_pntr[x], 0, SLC_BUF_LEN * sizeof(ch->slc_buf_pntr[x][0]));
+    memset(ch->slc_buf_pntr[x], 0, ch->buf_len * sizeof(ch->slc_buf_pntr[x][0]));
 
     ch->slc_items[x].unused = 0;
     ch->slc_items[x].owner = 1;
     ch->slc_items[x].eof = 1;
     ch->slc_items[x].sub_sof = 0;
-    ch->slc_items[x].datalen = SLC_BUF_LEN * 4;
-    ch->slc_items[x].blocksize = SLC_BUF_LEN * 4;
+    ch->slc_items[x].datalen = ch->buf_len * 4;
+    ch->slc_items[x].blocksize = ch->buf_len * 4;
     ch->slc_items[x].buf_ptr = (uint32_t*)&ch->slc_buf_pntr[x][0];
-    ch->slc_items[x].next_link_ptr = (x<(SLC_BUF_CNT-1))?(&ch->slc_items[x+1]):(&ch->slc_items[0]);
+    ch->slc_items[x].next_link_ptr = (x<(ch->buf_cnt-1))?(&ch->slc_items[x+1]):(&ch->slc_items[0]);
   }
   return true;
 }
@@ -267,6 +312,20 @@ static bool i2s_slc_begin() {
   return true;
 }
 
+static void _free_channel(i2s_state_t *ch) {
+  if (ch->slc_buf_pntr) {
+    for (int x = 0; x<ch->buf_cnt; x++) {
+      free(ch->slc_buf_pntr[x]);
+    }
+  }
+  free(ch->slc_buf_pntr);
+  free(ch->slc_queue);
+  free(ch->slc_items);
+  ch->slc_buf_pntr = NULL;
+  ch->slc_queue = NULL;
+  ch->slc_items = NULL;
+}
+
 static void i2s_slc_end(){
   ETS_SLC_INTR_DISABLE();
   SLCIC = 0xFFFFFFFF;
@@ -274,18 +333,31 @@ static void i2s_slc_end(){
   SLCTXL &= ~(SLCTXLAM << SLCTXLA); // clear TX descriptor address
   SLCRXL &= ~(SLCRXLAM << SLCRXLA); // clear RX descriptor address
 
-  for (int x = 0; x<SLC_BUF_CNT; x++) {
-    if (tx) {
-      free(tx->slc_buf_pntr[x]);
-      tx->slc_buf_pntr[x] = NULL;
-    }
-    if (rx) {
-      free(rx->slc_buf_pntr[x]);
-      rx->slc_buf_pntr[x] = NULL;
-    }
+  if (tx) {
+    _free_channel(tx);
+  }
+  if (rx) {
+    _free_channel(rx);
   }
 }
 
+// The current buffer can't be used further: full, none yet, or the DMA
+// already went past it
+static bool _i2s_buffer_done(const i2s_state_t *ch) {
+  return ch->curr_slc_buf_pos==ch->buf_len || ch->curr_slc_buf==NULL || ch->late;
+}
+
+// Takes the next buffer of the queue, which must not be empty. A held
+// buffer belongs to the application until submitted or released.
+static void _i2s_next_buffer(i2s_state_t *ch, bool held) {
+  ETS_SLC_INTR_DISABLE();
+  ch->curr_slc_buf = (uint32_t *)i2s_slc_queue_next_item(ch);
+  ch->curr_slc_buf_pos = held ? ch->buf_len : 0;
+  ch->held = held;
+  ch->late = false;
+  ETS_SLC_INTR_ENABLE();
+}
+
 // These routines push a single, 32-bit sample to the I2S buffers. Call at (on average)
 // at least the current sample rate.
 static bool _i2s_write_sample(uint32_t sample, bool nb) {
@@ -293,7 +365,7 @@ static bool _i2s_write_sample(uint32_t sample, bool nb) {
     return false;
   }
 
-  if (tx->curr_slc_buf_pos==SLC_BUF_LEN || tx->curr_slc_buf==NULL) {
+  if (_i2s_buffer_done(tx)) {
     if (tx->slc_queue_len == 0) {
       if (nb) {
         // Don't wait if nonblocking, just notify upper levels
@@ -307,10 +379,7 @@ static bool _i2s_write_sample(uint32_t sample, bool nb) {
         }
       }
     }
-    ETS_SLC_INTR_DISABLE();
-    tx->curr_slc_buf = (uint32_t *)i2s_slc_queue_next_item(tx);
-    ETS_SLC_INTR_ENABLE();
-    tx->curr_slc_buf_pos=0;
+    _i2s_next_buffer(tx, false);
   }
   tx->curr_slc_buf[tx->curr_slc_buf_pos++]=sample;
   return true;
@@ -339,7 +408,7 @@ static uint16_t _i2s_write_buffer(int16_t *frames, uint16_t frame_count, bool mo
     while(frame_count>0) {
    
         // make sure we have room in the current buffer
-        if (tx->curr_slc_buf_pos==SLC_BUF_LEN || tx->curr_slc_buf==NULL) {
+        if (_i2s_buffer_done(tx)) {
             // no room in the current buffer? if there are no buffers available then exit
             if (tx->slc_queue_len == 0)
             {
@@ -359,14 +428,11 @@ static uint16_t _i2s_write_buffer(int16_t *frames, uint16_t frame_count, bool mo
             }
             
             // get a new buffer
-            ETS_SLC_INTR_DISABLE();
-            tx->curr_slc_buf = (uint32_t *)i2s_slc_queue_next_item(tx);
-            ETS_SLC_INTR_ENABLE();
-            tx->curr_slc_buf_pos=0;
+            _i2s_next_buffer(tx, false);
         }       
 
         //space available in the current buffer
-        uint16_t	available = SLC_BUF_LEN - tx->curr_slc_buf_pos;
+        uint16_t	available = tx->buf_len - tx->curr_slc_buf_pos;
 
         uint16_t fc = (available < frame_count) ? available : frame_count;
 
@@ -399,11 +465,129 @@ uint16_t i2s_write_buffer_nb(int16_t *frames, uint16_t frame_count) { return _i2
 
 uint16_t i2s_write_buffer(int16_t *frames, uint16_t frame_count) { return _i2s_write_buffer(frames, frame_count, false, false); }
 
+// Takes the next free buffer of the channel, NULL if there is none and !blocking
+static uint32_t *_i2s_take_buffer(i2s_state_t *ch, bool blocking) {
+  if (!ch) {
+    return NULL;
+  }
+  if (ch->slc_queue_len == 0) {
+    if (!blocking) {
+      return NULL;
+    }
+    while (ch->slc_queue_len == 0) {
+      optimistic_yield(10000);
+    }
+  }
+  // Fully used for the per sample calls, which will go to the next buffer
+  _i2s_next_buffer(ch, true);
+  return ch->curr_slc_buf;
+}
+
+uint32_t *i2s_get_buffer(bool blocking) {
+  return _i2s_take_buffer(tx, blocking);
+}
+
+void i2s_submit_buffer() {
+  // The DMA ring plays every buffer in turn, a buffer taken from the queue
+  // is already in line: it only has to be complete when its turn comes
+  if (tx) {
+    tx->held = false;
+  }
+}
+
+const uint32_t *i2s_rx_get_buffer(bool blocking) {
+  return _i2s_take_buffer(rx, blocking);
+}
+
+void i2s_rx_release_buffer() {
+  // The DMA refills the buffer on its next turn around the ring
+  if (rx) {
+    rx->held = false;
+  }
+}
+
+uint16_t i2s_get_buffer_words() {
+  return tx ? tx->buf_len : (rx ? rx->buf_len : 0);
+}
+
+uint32_t i2s_get_underruns() {
+  return tx ? tx->xruns : 0;
+}
+
+uint32_t i2s_rx_get_overruns() {
+  return rx ? rx->xruns : 0;
+}
+
+// DMA bitstream, see i2s.h
+size_t i2s_bitstream_write(const uint32_t *words, size_t count, bool nb) {
+  if (!tx) {
+    return 0;
+  }
+  if (i2s_is_empty()) {
+    // Everything was sent, start over in the next buffer to be played
+    tx->curr_slc_buf = NULL;
+  }
+  size_t written = 0;
+  while (written < count) {
+    if (_i2s_buffer_done(tx)) {
+      if (tx->slc_queue_len == 0) {
+        if (nb) {
+          break;
+        }
+        while (tx->slc_queue_len == 0) {
+          optimistic_yield(10000);
+        }
+      }
+      _i2s_next_buffer(tx, false);
+    }
+    size_t n = std::min(count - written, (size_t)(tx->buf_len - tx->curr_slc_buf_pos));
+    memcpy(&tx->curr_slc_buf[tx->curr_slc_buf_pos], &words[written], n * sizeof(words[0]));
+    tx->curr_slc_buf_pos += n;
+    written += n;
+  }
+  return written;
+}
+
+size_t i2s_bitstream_write_encoded(const uint8_t *data, size_t len, uint8_t bits, uint32_t zero, uint32_t one) {
+  if (!tx || !bits || bits > 32) {
+    return 0;
+  }
+  const uint32_t mask = (bits == 32) ? ~0U : ((1U << bits) - 1);
+  zero &= mask;
+  one &= mask;
+  uint64_t acc = 0; // Pending output bits, MSB first in the low acc_bits
+  uint32_t acc_bits = 0;
+  size_t done = 0; // Data bytes whose words are all queued
+  for (size_t i = 0; i < len; i++) {
+    for (int b = 7; b >= 0; b--) {
+      acc = (acc << bits) | (((data[i] >> b) & 1) ? one : zero);
+      acc_bits += bits;
+      if (acc_bits >= 32) {
+        acc_bits -= 32;
+        uint32_t word = acc >> acc_bits;
+        if (!i2s_bitstream_write(&word, 1, false)) {
+          return done; // Not queued, the transmitter was stopped
+        }
+      }
+    }
+    if (!acc_bits) {
+      done = i + 1;
+    }
+  }
+  if (acc_bits) {
+    uint32_t word = acc << (32 - acc_bits);
+    if (!i2s_bitstream_write(&word, 1, false)) {
+      return done;
+    }
+  }
+  return len;
+}
+
 bool i2s_read_sample(int16_t *left, int16_t *right, bool blocking) {
   if (!rx) {
     return false;
   }
-  if (rx->curr_slc_buf_pos==SLC_BUF_LEN || rx->curr_slc_buf==NULL) {
+  if (_i2s_buffer_done(rx)) {
     if (rx->slc_queue_len == 0) {
       if (!blocking) {
         return false;
@@ -416,10 +600,7 @@ bool i2s_read_sample(int16_t *left, int16_t *right, bool blocking) {
         }
       }
     }
-    ETS_SLC_INTR_DISABLE();
-    rx->curr_slc_buf = (uint32_t *)i2s_slc_queue_next_item(rx);
-    ETS_SLC_INTR_ENABLE();
-    rx->curr_slc_buf_pos=0;
+    _i2s_next_buffer(rx, false);
   }
 
   uint32_t sample = rx->curr_slc_buf[rx->curr_slc_buf_pos++];
@@ -479,9 +660,16 @@ float i2s_get_real_rate(){
 }
 
 bool i2s_rxtx_begin(bool enableRx, bool enableTx) {
+  return i2s_rxtx_begin_buffers(enableRx, enableTx, SLC_BUF_CNT, SLC_BUF_LEN);
+}
+
+bool i2s_rxtx_begin_buffers(bool enableRx, bool enableTx, uint16_t buf_cnt, uint16_t buf_len) {
   if (tx || rx) {
     i2s_end(); // Stop and free any ongoing stuff
   }
+  if ((buf_cnt < 2) || (buf_cnt > SLC_BUF_CNT_MAX) || (buf_len < 1) || (buf_len > SLC_BUF_LEN_MAX)) {
+    return false;
+  }
 
   if (enableTx) {
     tx = (i2s_state_t*)calloc(1, sizeof(*tx));
@@ -489,9 +677,15 @@ bool i2s_rxtx_begin(bool enableRx, bool enableTx) {
       // Nothing to clean up yet
       return false; // OOM Error!
     }
-    pinMode(I2SO_WS, FUNCTION_1);
+    tx->buf_cnt = buf_cnt;
+    tx->buf_len = buf_len;
+    if (_i2s_tx_ws) {
+      pinMode(I2SO_WS, FUNCTION_1);
+    }
     pinMode(I2SO_DATA, FUNCTION_1);
-    pinMode(I2SO_BCK, FUNCTION_1);
+    if (_i2s_tx_bck) {
+      pinMode(I2SO_BCK, FUNCTION_1);
+    }
   }
   if (enableRx) {
     rx = (i2s_state_t*)calloc(1, sizeof(*rx));
@@ -499,6 +693,8 @@ bool i2s_rxtx_begin(bool enableRx, bool enableTx) {
       i2s_end(); // Clean up any TX or pin changes
       return false; // OOM error!
     }
+    rx->buf_cnt = buf_cnt;
+    rx->buf_len = buf_len;
     pinMode(I2SI_WS, OUTPUT);
     pinMode(I2SI_BCK, OUTPUT);
     pinMode(I2SI_DATA, INPUT);
@@ -539,7 +735,7 @@ bool i2s_rxtx_begin(bool enableRx, bool enableTx) {
 
   if (rx) {
     // Need to prime the # of samples to receive in the engine
-    I2SRXEN = SLC_BUF_LEN;
+    I2SRXEN = rx->buf_len;
   }
 
   I2SC |= (rx?I2SRXS:0) | (tx?I2STXS:0); // Start transmission/reception
@@ -551,6 +747,40 @@ void i2s_begin() {
   i2s_rxtx_begin(false, true);
 }
 
+bool i2s_bitstream_begin(uint32_t bitrate, bool clock_out) {
+  if (tx || rx) {
+    i2s_end(); // Before the pins are chosen, it gives back the current ones
+  }
+  // Only the data pin is needed
+  _i2s_tx_ws = false;
+  _i2s_tx_bck = clock_out;
+  if (!i2s_rxtx_begin(false, true)) {
+    return false;
+  }
+  // Bit clock is I2SBASEFREQ / div1 / div2, closest match
+  uint32_t delta_best = ~0U;
+  uint8_t div1_best = 1;
+  uint8_t div2_best = 1;
+  for (uint32_t i = 1; i < 64; i++) {
+    for (uint32_t j = i; j < 64; j++) {
+      uint32_t rate = I2SBASEFREQ / (i * j);
+      uint32_t delta = (rate > bitrate) ? rate - bitrate : bitrate - rate;
+      if (delta < delta_best) {
+        delta_best = delta;
+        div1_best = i;
+        div2_best = j;
+      }
+    }
+  }
+  i2s_set_dividers(div1_best, div2_best);
+  _i2s_sample_rate = 0; // Not an audio rate, let i2s_set_rate() start over
+  return true;
+}
+
+uint32_t i2s_bitstream_get_rate() {
+  return I2SBASEFREQ / ((I2SC >> I2SBD) & I2SBDM) / ((I2SC >> I2SCD) & I2SCDM);
+}
+
 void i2s_end() {
   // Disable any I2S send or receive
   // ? Maybe not needed since we're resetting on the next line...
@@ -565,11 +795,17 @@ void i2s_end() {
 
   if (tx) {
     pinMode(I2SO_DATA, INPUT);
-    pinMode(I2SO_BCK, INPUT);
-    pinMode(I2SO_WS, INPUT);
+    if (_i2s_tx_bck) {
+      pinMode(I2SO_BCK, INPUT);
+    }
+    if (_i2s_tx_ws) {
+      pinMode(I2SO_WS, INPUT);
+    }
     free(tx);
     tx = NULL;
   }
+  _i2s_tx_ws = true;
+  _i2s_tx_bck = true;
   if (rx) {
     pinMode(I2SI_DATA, INPUT);
     pinMode(I2SI_BCK, INPUT);
@@ -34,6 +34,7 @@ extern "C" {
 }
 #include <core_version.h>
 #include "gdb_hooks.h"
+#include "task_profiler.h"
 
 #define LOOP_TASK_PRIORITY 1
 #define LOOP_QUEUE_SIZE    1
@@ -95,7 +96,9 @@ extern "C" bool can_yield() {
 
 static inline void esp_yield_within_cont() __attribute__((always_inline));
 static void esp_yield_within_cont() {
+        TASK_PROFILER__SUSPEND(TASK_PROFILER_YIELD);
         cont_yield(g_pcont);
+        TASK_PROFILER__RESUME(TASK_PROFILER_YIELD);
         s_cycles_at_yield_start = ESP.getCycleCount();
         run_scheduled_recurrent_functions();
 }
@@ -176,14 +179,20 @@ extern "C" void loop_end (void) __attribute__ ((weak, alias("__loop_end")));
 
 static void loop_wrapper() {
     static bool setup_done = false;
+    TASK_PROFILER__RESUME(TASK_PROFILER_SYS);
     preloop_update_frequency();
     if(!setup_done) {
+        TASK_PROFILER__BEGIN(TASK_PROFILER_LOOP, PSTR("setup"), 0, 0);
         setup();
+        TASK_PROFILER__END();
         setup_done = true;
     }
+    TASK_PROFILER__BEGIN(TASK_PROFILER_LOOP, NULL, 0, 0);
     loop();
+    TASK_PROFILER__END();
     loop_end();
     esp_schedule();
+    TASK_PROFILER__SUSPEND(TASK_PROFILER_SYS);
 }
 
 static void loop_task(os_event_t *events) {
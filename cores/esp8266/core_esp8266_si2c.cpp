@@ -23,6 +23,8 @@
 #include "pins_arduino.h"
 #include "wiring_private.h"
 #include "PolledTimeout.h"
+#include "Schedule.h"
+#include "core_esp8266_waveform.h"
 
 
 
@@ -111,6 +113,30 @@ private:
     // Allow not linking in the slave code if there is no call to setAddress
     bool _slaveEnabled = false;
 
+    // Asynchronous master: the queue belongs to CONT, the timer1 callback
+    // only moves async_current along and sets the status of finished ones
+    twi_async_t* async_head = nullptr;
+    twi_async_t* async_tail = nullptr;
+    twi_async_t* volatile async_current = nullptr;
+    bool async_polling = false;
+    enum { ASYNC_START, ASYNC_TX, ASYNC_RX, ASYNC_RESTART, ASYNC_RESTART_HIGH, ASYNC_RESTART_START, ASYNC_STOP, ASYNC_STOP_HIGH, ASYNC_STOP_END } async_state = ASYNC_START;
+    enum { ASYNC_ADDR_W, ASYNC_WRITE, ASYNC_ADDR_R, ASYNC_READ } async_phase = ASYNC_ADDR_W;
+    bool async_high = false;      // next step raises SCL
+    uint32_t async_bit = 0;       // 0..7: data, 8: acknowledge
+    uint8_t async_byte = 0;
+    size_t async_index = 0;
+    uint8_t async_status = 0;     // result once stopped
+    uint32_t async_stretch = 0;   // steps SCL was held low
+    uint32_t async_next = 0;      // cycle count of the next step
+    uint32_t async_half_cycles = 0;
+
+    static uint32_t ICACHE_RAM_ATTR onAsyncTimer(void);
+    void ICACHE_RAM_ATTR asyncStep(twi_async_t* t);
+    void ICACHE_RAM_ATTR asyncNextByte(twi_async_t* t);
+    void ICACHE_RAM_ATTR asyncFinish(twi_async_t* t);
+    bool asyncPoll(void);
+    void asyncWait(void);
+
     // Internal use functions
     void ICACHE_RAM_ATTR busywait(unsigned int v);
     bool write_start(void);
@@ -150,6 +176,8 @@ public:
     void ICACHE_RAM_ATTR reply(uint8_t ack);
     void ICACHE_RAM_ATTR releaseBus(void);
     void enableSlave();
+    bool queue(twi_async_t* t);
+    size_t queued(void);
 };
 
 static Twi twi;
@@ -313,6 +341,7 @@ unsigned char Twi::read_byte(bool nack)
 unsigned char Twi::writeTo(unsigned char address, unsigned char * buf, unsigned int len, unsigned char sendStop)
 {
     unsigned int i;
+    asyncWait();
     if (!write_start())
     {
         return 4;  //line busy
@@ -358,6 +387,7 @@ unsigned char Twi::writeTo(unsigned char address, unsigned char * buf, unsigned
 unsigned char Twi::readFrom(unsigned char address, unsigned char* buf, unsigned int len, unsigned char sendStop)
 {
     unsigned int i;
+    asyncWait();
     if (!write_start())
     {
         return 4;  //line busy
@@ -427,6 +457,306 @@ uint8_t Twi::status()
     return I2C_OK;
 }
 
+bool Twi::queue(twi_async_t* t)
+{
+    for (twi_async_t* q = async_head; q; q = q->next)
+    {
+        if (q == t)
+        {
+            return false;
+        }
+    }
+    if (!async_polling && getTimer1Callback())
+    {
+        // timer1 already clocks something else
+        return false;
+    }
+    t->status = TWI_ASYNC_PENDING;
+    t->next = nullptr;
+    if (async_tail)
+    {
+        async_tail->next = t;
+    }
+    else
+    {
+        async_head = t;
+    }
+    async_tail = t;
+    // t is linked before async_current is checked below, else the interrupt
+    // could end the queue meanwhile without seeing t and leave it pending
+    __asm__ __volatile__("" ::: "memory");
+
+    if (!async_polling)
+    {
+        async_polling = true;
+        schedule_recurrent_function_us([]() { return twi.asyncPoll(); }, 0);
+        setTimer1Callback(onAsyncTimer);
+    }
+    if (!async_current)
+    {
+        // Idle: the timer callback saw the end of the queue before t was
+        // linked, or never ran. It can't move along until this is set.
+        async_half_cycles = std::max(microsecondsToClockCycles(500000 / preferred_si2c_clock), microsecondsToClockCycles(10));
+        async_state = ASYNC_START;
+        async_next = ESP.getCycleCount();
+        // The interrupt reads the above once it sees async_current
+        __asm__ __volatile__("" ::: "memory");
+        async_current = t;
+    }
+    return true;
+}
+
+size_t Twi::queued(void)
+{
+    size_t n = 0;
+    for (twi_async_t* q = async_head; q; q = q->next)
+    {
+        n += (q->status == TWI_ASYNC_PENDING);
+    }
+    return n;
+}
+
+// Runs the callbacks of the finished transactions, from CONT
+bool Twi::asyncPoll(void)
+{
+    while (async_head && async_head->status != TWI_ASYNC_PENDING)
+    {
+        twi_async_t* t = async_head;
+        async_head = t->next;
+        if (!async_head)
+        {
+            async_tail = nullptr;
+        }
+        if (t->callback)
+        {
+            t->callback(t);
+        }
+    }
+    if (!async_head)
+    {
+        if (getTimer1Callback() == onAsyncTimer)
+        {
+            setTimer1Callback(NULL);
+        }
+        async_polling = false;
+    }
+    return async_polling;
+}
+
+void Twi::asyncWait(void)
+{
+    while (async_current)
+    {
+        optimistic_yield(1000);
+    }
+}
+
+uint32_t ICACHE_RAM_ATTR Twi::onAsyncTimer(void)
+{
+    // Called at every timer1 interrupt, not only when asked for
+    twi_async_t* t = twi.async_current;
+    if (!t)
+    {
+        return microsecondsToClockCycles(10000);
+    }
+    int32_t left = twi.async_next - ESP.getCycleCount();
+    if (left > 0)
+    {
+        return left;
+    }
+    twi.asyncStep(t);
+    twi.async_next += twi.async_half_cycles;
+    if ((int32_t)(twi.async_next - ESP.getCycleCount()) < 0)
+    {
+        // Late, don't try to catch up
+        twi.async_next = ESP.getCycleCount() + twi.async_half_cycles;
+    }
+    return twi.async_half_cycles;
+}
+
+// One half SCL period of the current transaction
+void ICACHE_RAM_ATTR Twi::asyncStep(twi_async_t* t)
+{
+    if (async_high)
+    {
+        // Second half of a bit: release SCL, wait while a slave stretches it
+        SCL_HIGH(twi_scl);
+        if (!SCL_READ(twi_scl))
+        {
+            if (++async_stretch * clockCyclesToMicroseconds(async_half_cycles) > twi_clockStretchLimit)
+            {
+                async_status = TWI_ASYNC_TIMEOUT;
+                async_state = ASYNC_STOP_END;
+                async_high = false;
+            }
+            return;
+        }
+        async_stretch = 0;
+        async_high = false;
+        switch (async_state)
+        {
+        case ASYNC_TX:
+            if (async_bit < 8)
+            {
+                async_byte <<= 1;
+                async_bit++;
+            }
+            else if (SDA_READ(twi_sda))
+            {
+                async_status = (async_phase == ASYNC_WRITE) ? 3 : 2; // NACK on data or address
+                async_state = ASYNC_STOP;
+            }
+            else
+            {
+                asyncNextByte(t);
+            }
+            break;
+        case ASYNC_RX:
+            if (async_bit < 8)
+            {
+                async_byte = (async_byte << 1) | SDA_READ(twi_sda);
+                async_bit++;
+            }
+            else
+            {
+                asyncNextByte(t);
+            }
+            break;
+        case ASYNC_RESTART_HIGH:
+            async_state = ASYNC_RESTART_START;
+            break;
+        case ASYNC_STOP_HIGH:
+            async_state = ASYNC_STOP_END;
+            break;
+        default:
+            break;
+        }
+        return;
+    }
+
+    switch (async_state)
+    {
+    case ASYNC_START:
+        if (!SDA_READ(twi_sda) || !SCL_READ(twi_scl))
+        {
+            async_status = 4; // line busy
+            asyncFinish(t);
+            return;
+        }
+        SDA_LOW(twi_sda);
+        async_status = 0;
+        async_index = 0;
+        async_phase = (t->wlen || !t->rlen) ? ASYNC_ADDR_W : ASYNC_ADDR_R;
+        async_byte = (t->address << 1) | (async_phase == ASYNC_ADDR_R);
+        async_bit = 0;
+        async_state = ASYNC_TX;
+        break;
+    case ASYNC_TX:
+        SCL_LOW(twi_scl);
+        if (async_bit < 8 && !(async_byte & 0x80))
+        {
+            SDA_LOW(twi_sda);
+        }
+        else
+        {
+            SDA_HIGH(twi_sda); // one, or released for the slave acknowledge
+        }
+        async_high = true;
+        break;
+    case ASYNC_RX:
+        SCL_LOW(twi_scl);
+        if (async_bit < 8)
+        {
+            SDA_HIGH(twi_sda);
+        }
+        else
+        {
+            t->rbuf[async_index++] = async_byte;
+            // ACK all but the last byte
+            if (async_index < t->rlen)
+            {
+                SDA_LOW(twi_sda);
+            }
+            else
+            {
+                SDA_HIGH(twi_sda);
+            }
+        }
+        async_high = true;
+        break;
+    case ASYNC_RESTART:
+        SCL_LOW(twi_scl);
+        SDA_HIGH(twi_sda);
+        async_state = ASYNC_RESTART_HIGH;
+        async_high = true;
+        break;
+    case ASYNC_RESTART_START:
+        SDA_LOW(twi_sda);
+        async_phase = ASYNC_ADDR_R;
+        async_byte = (t->address << 1) | 1;
+        async_bit = 0;
+        async_state = ASYNC_TX;
+        break;
+    case ASYNC_STOP:
+        SCL_LOW(twi_scl);
+        SDA_LOW(twi_sda);
+        async_state = ASYNC_STOP_HIGH;
+        async_high = true;
+        break;
+    case ASYNC_STOP_END:
+        SDA_HIGH(twi_sda);
+        asyncFinish(t);
+        break;
+    default:
+        break;
+    }
+}
+
+// After the acknowledge slot of a byte
+void ICACHE_RAM_ATTR Twi::asyncNextByte(twi_async_t* t)
+{
+    async_bit = 0;
+    if (async_phase == ASYNC_ADDR_W)
+    {
+        async_phase = ASYNC_WRITE;
+    }
+    else if (async_phase == ASYNC_ADDR_R)
+    {
+        async_phase = ASYNC_READ;
+    }
+
+    if (async_phase == ASYNC_WRITE && async_index < t->wlen)
+    {
+        async_byte = t->wbuf[async_index++];
+        async_state = ASYNC_TX;
+    }
+    else if (async_phase == ASYNC_WRITE && t->rlen)
+    {
+        async_index = 0;
+        async_state = ASYNC_RESTART;
+    }
+    else if (async_phase == ASYNC_READ && async_index < t->rlen)
+    {
+        async_byte = 0;
+        async_state = ASYNC_RX;
+    }
+    else
+    {
+        async_state = ASYNC_STOP;
+    }
+}
+
+void ICACHE_RAM_ATTR Twi::asyncFinish(twi_async_t* t)
+{
+    // Move along first: CONT may recycle t as soon as the status is set
+    twi_async_t* next = t->next;
+    async_current = next;
+    async_state = ASYNC_START;
+    async_high = false;
+    async_stretch = 0;
+    t->status = async_status;
+}
+
 uint8_t Twi::transmit(const uint8_t* data, uint8_t length)
 {
     uint8_t i;
@@ -1015,4 +1345,14 @@ extern "C" {
         twi.enableSlave();
     }
 
+    bool twi_queue(twi_async_t* t)
+    {
+        return twi.queue(t);
+    }
+
+    size_t twi_queued(void)
+    {
+        return twi.queued();
+    }
+
 };
@@ -17,6 +17,16 @@
   contiguous and only take effect on the next waveform transition,
   allowing for smooth transitions.
 
+  PWM on GPIO 0-15 (analogWrite) has its own phase aligned engine: all
+  channels share one period, rise together with a single GPOS write, and
+  fall on a precomputed table of edges sorted by time, each clearing every
+  pin due at that time with a single GPOC write.  The table is rebuilt in a
+  second buffer and swapped at the start of a period.
+
+  Sequences step a PWM duty or the sigma-delta target through a table of
+  values at a fixed rate, from the same interrupt.  PWM steps are applied at
+  the start of a period by moving the pin's edge in a copy of the table.
+
   This replaces older tone(), analogWrite(), and the Servo classes.
 
   Everywhere in the code where "cycles" is used, it means ESP.getCycleTime()
@@ -68,6 +78,54 @@ static volatile uint32_t waveformToDisable = 0; // Message to the NMI handler to
 
 static uint32_t (*timer1CB)() = NULL;
 
+// Phase aligned PWM edges for one period
+typedef struct {
+  uint32_t periodCycles;
+  uint32_t setMask;            // Pins set at the start of the period
+  uint32_t count;              // Falling edges
+  uint32_t edgeCycles[16];     // Sorted, from the start of the period
+  uint32_t clearMask[16];      // Pins cleared at each edge
+} PWMTable;
+
+static PWMTable pwmTables[3];                  // Played, built by updatePWM(), edited by the NMI for sequences
+static PWMTable * volatile pwmActive = NULL;   // Table being played, only changed by the NMI
+static PWMTable * volatile pwmNext = NULL;     // Message to the NMI handler to play this table from the next period
+static PWMTable * volatile pwmBuilding = NULL; // Table updatePWM() writes, the NMI doesn't take it for sequences
+static volatile uint32_t pwmToDisable = 0;     // Message to the NMI handler to remove pins from the tables
+
+// PWM channels, as last requested by startPWM()/stopPWM()
+static volatile uint32_t pwmPins = 0;
+static uint32_t pwmPeriodCycles = 0;
+static uint32_t pwmHighCycles[16];          // Also written by the NMI for sequences
+
+// Values stepped through by the NMI, see startSequence()
+typedef struct {
+  const uint16_t *values;
+  uint32_t count;
+  uint32_t stepCycles;
+  bool repeat;
+} SequenceTable;
+
+typedef struct {
+  SequenceTable tables[2];
+  SequenceTable * volatile active; // Table being played, only changed by the NMI
+  SequenceTable * volatile next;   // Message to the NMI handler to play this table after the active one
+  volatile bool stop;              // Message to the NMI handler to stop now
+  uint32_t index;                  // Value played, NMI only
+  uint32_t nextCycle;              // Time of the next step, NMI only
+  uint8_t pin;                     // Only changed while the sequence is idle
+} Sequence;
+
+static Sequence sequences[WAVEFORM_SEQUENCES];
+
+// definitions in esp8266_peri.h style, see core_esp8266_sigma_delta.cpp
+#define GPSD  ESP8266_REG(0x368) // GPIO_SIGMA_DELTA register @ 0x600000368
+#define GPSDT 0  // target, 8 bits
+
+static volatile WaveformStats waveformStats;
+
+static int stopPWM(uint8_t pin);
+
 
 // Non-speed critical bits
 #pragma GCC optimize ("Os")
@@ -78,9 +136,22 @@ static inline ICACHE_RAM_ATTR uint32_t GetCycleCount() {
   return ccount;
 }
 
+static inline ICACHE_RAM_ATTR bool sequenceBusy(const Sequence *seq) {
+  return seq->active || seq->next || seq->stop;
+}
+
+static inline ICACHE_RAM_ATTR bool sequencesIdle() {
+  for (int i = 0; i < WAVEFORM_SEQUENCES; i++) {
+    if (sequenceBusy(&sequences[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 // Interrupt on/off control
 static ICACHE_RAM_ATTR void timer1Interrupt();
-static bool timerRunning = false;
+static volatile bool timerRunning = false; // Also cleared by the NMI once idle
 
 static void initTimer() {
   timer1_disable();
@@ -103,11 +174,15 @@ void setTimer1Callback(uint32_t (*fn)()) {
   if (!timerRunning && fn) {
     initTimer();
     timer1_write(microsecondsToClockCycles(1)); // Cause an interrupt post-haste
-  } else if (timerRunning && !fn && !waveformEnabled) {
+  } else if (timerRunning && !fn && !waveformEnabled && !pwmActive && !pwmNext && sequencesIdle()) {
     deinitTimer();
   }
 }
 
+uint32_t (*getTimer1Callback())() {
+  return timer1CB;
+}
+
 // Start up a waveform on a pin, or change the current one.  Will change to the new
 // waveform smoothly on next low->high transition.  For immediate change, stopWaveform()
 // first, then it will immediately begin.
@@ -115,6 +190,7 @@ int startWaveform(uint8_t pin, uint32_t timeHighUS, uint32_t timeLowUS, uint32_t
   if ((pin > 16) || isFlashInterfacePin(pin)) {
     return false;
   }
+  stopPWM(pin);
   Waveform *wave = &waveform[pin];
   // Adjust to shave off some of the IRQ time, approximately
   wave->nextTimeHighCycles = microsecondsToClockCycles(timeHighUS);
@@ -146,6 +222,165 @@ int startWaveform(uint8_t pin, uint32_t timeHighUS, uint32_t timeLowUS, uint32_t
   return true;
 }
 
+// Build the edge table in the buffer not being played and hand it over
+static void updatePWM() {
+  // Take back a table not started yet: the NMI can't swap after this
+  pwmNext = NULL;
+  // Claim a table before checking it isn't played, the NMI could have
+  // taken it for a sequence step in between
+  PWMTable *table;
+  for (table = pwmTables; ; table++) {
+    pwmBuilding = table;
+    if (table != pwmActive) {
+      break;
+    }
+  }
+
+  table->periodCycles = pwmPeriodCycles;
+  table->setMask = 0;
+  table->count = 0;
+  // Sequences may turn channels steady off (0) or on (a whole period)
+  uint32_t left = 0;
+  for (uint32_t pins = pwmPins; pins; pins &= pins - 1) {
+    int pin = __builtin_ctz(pins);
+    if (pwmHighCycles[pin]) {
+      table->setMask |= 1 << pin;
+      if (pwmHighCycles[pin] < pwmPeriodCycles) {
+        left |= 1 << pin;
+      }
+    }
+  }
+  while (left) {
+    // Next falling edge, pins with the same duty share it
+    uint32_t edge = ~0U;
+    for (uint32_t pins = left; pins; pins &= pins - 1) {
+      edge = std::min(edge, pwmHighCycles[__builtin_ctz(pins)]);
+    }
+    uint32_t mask = 0;
+    for (uint32_t pins = left; pins; pins &= pins - 1) {
+      int pin = __builtin_ctz(pins);
+      if (pwmHighCycles[pin] == edge) {
+        mask |= 1 << pin;
+      }
+    }
+    table->edgeCycles[table->count] = edge;
+    table->clearMask[table->count] = mask;
+    table->count++;
+    left &= ~mask;
+  }
+
+  // The table is complete before the NMI can see it
+  __asm__ __volatile__("" ::: "memory");
+  pwmNext = table;
+  if (!timerRunning) {
+    initTimer();
+    timer1_write(microsecondsToClockCycles(10));
+  } else if (!pwmActive && T1L > microsecondsToClockCycles(10)) {
+    timer1_write(microsecondsToClockCycles(10));
+  }
+}
+
+// Start or change a phase aligned PWM channel, the change takes effect at the
+// start of the next period.  A new period applies to all channels, keeping
+// their duty cycle.
+int startPWM(uint8_t pin, uint32_t highCycles, uint32_t periodCycles) {
+  if ((pin > 15) || isFlashInterfacePin(pin) || !highCycles || (highCycles >= periodCycles)) {
+    return false;
+  }
+  uint32_t mask = 1 << pin;
+  if (waveformEnabled & mask) {
+    stopWaveform(pin);
+  }
+
+  if (pwmPins && (periodCycles != pwmPeriodCycles)) {
+    for (uint32_t pins = pwmPins; pins; pins &= pins - 1) {
+      int i = __builtin_ctz(pins);
+      uint32_t high = ((uint64_t)pwmHighCycles[i] * periodCycles) / pwmPeriodCycles;
+      if (pwmHighCycles[i] >= pwmPeriodCycles) {
+        high = periodCycles;
+      } else if (pwmHighCycles[i]) {
+        high = std::min(std::max(high, (uint32_t)1), periodCycles - 1);
+      }
+      pwmHighCycles[i] = high;
+    }
+  }
+  pwmPeriodCycles = periodCycles;
+  pwmHighCycles[pin] = highCycles;
+  pwmPins |= mask;
+  updatePWM();
+  return true;
+}
+
+// Start a sequence on a pin, or queue the next table of the one playing
+int startSequence(uint8_t pin, const uint16_t *values, uint32_t count, uint32_t stepCycles, bool repeat) {
+  if (!values || !count || (stepCycles < microsecondsToClockCycles(10))) {
+    return false;
+  }
+  if ((pin != SIGMA_DELTA_SEQUENCE) && ((pin > 15) || !(pwmPins & (1 << pin)))) {
+    return false;
+  }
+  Sequence *seq = NULL;
+  for (int i = 0; i < WAVEFORM_SEQUENCES; i++) {
+    Sequence *s = &sequences[i];
+    bool busy = s->active || s->next;
+    if (busy && (s->pin == pin)) {
+      seq = s;
+      break;
+    }
+    if (!busy && !seq) {
+      seq = s;
+    }
+  }
+  if (!seq) {
+    return false;
+  }
+
+  // Take back a table not started yet: the NMI can't swap after this
+  seq->next = NULL;
+  SequenceTable *table = (seq->active == &seq->tables[0]) ? &seq->tables[1] : &seq->tables[0];
+  table->values = values;
+  table->count = count;
+  table->stepCycles = stepCycles;
+  table->repeat = repeat;
+  seq->pin = pin;
+  // The table is complete before the NMI can see it
+  __asm__ __volatile__("" ::: "memory");
+  seq->next = table;
+
+  if (!timerRunning) {
+    initTimer();
+    timer1_write(microsecondsToClockCycles(10));
+  } else if (T1L > microsecondsToClockCycles(10)) {
+    timer1_write(microsecondsToClockCycles(10));
+  }
+  return true;
+}
+
+int sequencePosition(uint8_t pin) {
+  for (int i = 0; i < WAVEFORM_SEQUENCES; i++) {
+    Sequence *seq = &sequences[i];
+    if ((seq->pin == pin) && (seq->active || seq->next)) {
+      return seq->active ? seq->index : 0;
+    }
+  }
+  return -1;
+}
+
+void getWaveformStats(WaveformStats *stats) {
+  // Not atomic with the NMI, the counts may be off by one interrupt
+  stats->irqs = waveformStats.irqs;
+  stats->irqCycles = waveformStats.irqCycles;
+  stats->maxIrqCycles = waveformStats.maxIrqCycles;
+  stats->maxLateCycles = waveformStats.maxLateCycles;
+}
+
+void resetWaveformStats() {
+  waveformStats.maxIrqCycles = 0;
+  waveformStats.maxLateCycles = 0;
+  waveformStats.irqCycles = 0;
+  waveformStats.irqs = 0;
+}
+
 // Speed critical bits
 #pragma GCC optimize ("O2")
 // Normally would not want two copies like this, but due to different
@@ -165,6 +400,46 @@ static inline ICACHE_RAM_ATTR uint32_t min_u32(uint32_t a, uint32_t b) {
   return b;
 }
 
+// Stops the sequence of a pin, its last value stays
+int ICACHE_RAM_ATTR stopSequence(uint8_t pin) {
+  for (int i = 0; i < WAVEFORM_SEQUENCES; i++) {
+    Sequence *seq = &sequences[i];
+    if ((seq->pin != pin) || !(seq->active || seq->next)) {
+      continue;
+    }
+    seq->next = NULL;
+    seq->stop = true;
+    // Ensure timely service....
+    if (T1L > microsecondsToClockCycles(10)) {
+      timer1_write(microsecondsToClockCycles(10));
+    }
+    while (seq->stop) {
+      /* no-op */ // Can't delay() since stopWaveform may be called from an IRQ
+    }
+    return true;
+  }
+  return false;
+}
+
+// Removes a pin from the PWM tables, immediately
+static ICACHE_RAM_ATTR int stopPWM(uint8_t pin) {
+  uint32_t mask = 1<<pin;
+  if (!(pwmPins & mask)) {
+    return false;
+  }
+  stopSequence(pin);
+  pwmPins &= ~mask;
+  pwmToDisable |= mask;
+  // Ensure timely service....
+  if (T1L > microsecondsToClockCycles(10)) {
+    timer1_write(microsecondsToClockCycles(10));
+  }
+  while (pwmToDisable) {
+    /* no-op */ // Can't delay() since stopWaveform may be called from an IRQ
+  }
+  return true;
+}
+
 // Stops a waveform on a pin
 int ICACHE_RAM_ATTR stopWaveform(uint8_t pin) {
   // Can't possibly need to stop anything if there is no timer active
@@ -174,6 +449,12 @@ int ICACHE_RAM_ATTR stopWaveform(uint8_t pin) {
   // If user sends in a pin >16 but <32, this will always point to a 0 bit
   // If they send >=32, then the shift will result in 0 and it will also return false
   uint32_t mask = 1<<pin;
+  if (stopPWM(pin)) {
+    if (!waveformEnabled && !timer1CB && !pwmActive && !pwmNext && sequencesIdle()) {
+      deinitTimer();
+    }
+    return true;
+  }
   if (!(waveformEnabled & mask)) {
     return false; // It's not running, nothing to do here
   }
@@ -185,7 +466,7 @@ int ICACHE_RAM_ATTR stopWaveform(uint8_t pin) {
   while (waveformToDisable) {
     /* no-op */ // Can't delay() since stopWaveform may be called from an IRQ
   }
-  if (!waveformEnabled && !timer1CB) {
+  if (!waveformEnabled && !timer1CB && !pwmActive && !pwmNext && sequencesIdle()) {
     deinitTimer();
   }
   return true;
@@ -201,7 +482,138 @@ int ICACHE_RAM_ATTR stopWaveform(uint8_t pin) {
 #endif
 
 
+// Removes pins from a PWM table, returns the table or NULL once no channel is left
+static inline ICACHE_RAM_ATTR PWMTable *maskPWM(PWMTable *table, uint32_t keep) {
+  if (table) {
+    table->setMask &= keep;
+    for (uint32_t i = 0; i < table->count; i++) {
+      table->clearMask[i] &= keep;
+    }
+    if (!pwmPins) {
+      return NULL;
+    }
+  }
+  return table;
+}
+
+// Copies a PWM table with the falling edge of the pins in mask moved to
+// high, no edge when they are steady off (0) or on (a whole period)
+static inline ICACHE_RAM_ATTR void editPWM(PWMTable *dst, const PWMTable *src, uint32_t mask, uint32_t high) {
+  dst->periodCycles = src->periodCycles;
+  dst->setMask = high ? (src->setMask | mask) : (src->setMask & ~mask);
+  bool placed = !high || (high >= src->periodCycles);
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < src->count; i++) {
+    uint32_t clear = src->clearMask[i] & ~mask;
+    if (!placed && (high <= src->edgeCycles[i])) {
+      placed = true;
+      if (high < src->edgeCycles[i]) {
+        dst->edgeCycles[n] = high;
+        dst->clearMask[n++] = mask;
+      } else {
+        clear |= mask;
+      }
+    }
+    if (clear) {
+      dst->edgeCycles[n] = src->edgeCycles[i];
+      dst->clearMask[n++] = clear;
+    }
+  }
+  if (!placed) {
+    dst->edgeCycles[n] = high;
+    dst->clearMask[n++] = mask;
+  }
+  dst->count = n;
+}
+
+// Advances a sequence to now, returns the value to play or -1 when no step is due
+static inline ICACHE_RAM_ATTR int32_t stepSequence(Sequence *seq, uint32_t now) {
+  SequenceTable *table = seq->active;
+  if (!table) {
+    table = seq->next;
+    if (!table) {
+      return -1;
+    }
+    seq->active = table;
+    seq->next = NULL;
+    seq->index = 0;
+    seq->nextCycle = now + table->stepCycles;
+    return table->values[0];
+  }
+  int32_t late = now - seq->nextCycle;
+  if (late < 0) {
+    return -1;
+  }
+  // Skip the steps that were missed, to keep the rate
+  uint32_t steps = 1;
+  if ((uint32_t)late >= table->stepCycles) {
+    steps += (uint32_t)late / table->stepCycles;
+  }
+  seq->index += steps;
+  seq->nextCycle += (steps - 1) * table->stepCycles;
+  if (seq->index >= table->count) {
+    if (seq->next) {
+      table = seq->active = seq->next;
+      seq->next = NULL;
+      seq->index = 0;
+    } else if (table->repeat) {
+      seq->index %= table->count;
+    } else {
+      seq->active = NULL; // The last value stays
+      return -1;
+    }
+  }
+  seq->nextCycle += table->stepCycles;
+  return table->values[seq->index];
+}
+
+// Plays the PWM sequence steps due at the start of a period, returns the
+// table to play
+static inline ICACHE_RAM_ATTR PWMTable *stepPWMSequences(PWMTable *table, uint32_t now) {
+  PWMTable *edited = NULL;
+  for (int i = 0; i < WAVEFORM_SEQUENCES; i++) {
+    Sequence *seq = &sequences[i];
+    if ((seq->pin == SIGMA_DELTA_SEQUENCE) || seq->stop || !(seq->active || seq->next)) {
+      continue;
+    }
+    uint32_t mask = 1 << seq->pin;
+    if (!(pwmPins & mask)) {
+      continue;
+    }
+    int32_t value = stepSequence(seq, now);
+    if (value < 0) {
+      continue;
+    }
+    uint32_t high = (value == 0xffff) ? table->periodCycles : ((uint32_t)value * (table->periodCycles >> 8)) >> 8;
+    pwmHighCycles[seq->pin] = high;
+    PWMTable copy;
+    const PWMTable *src = table;
+    if (!edited) {
+      // A table neither played, queued nor being built by updatePWM()
+      edited = pwmTables;
+      while ((edited == table) || (edited == pwmNext) || (edited == pwmBuilding)) {
+        edited++;
+      }
+    } else {
+      copy = *table;
+      src = &copy;
+    }
+    editPWM(edited, src, mask, high);
+    table = edited;
+  }
+  if (edited) {
+    pwmActive = edited;
+  }
+  return table;
+}
+
 static ICACHE_RAM_ATTR void timer1Interrupt() {
+  // PWM state, only used here
+  static uint32_t pwmPeriodStart;
+  static uint32_t pwmNextCycle;
+  static uint32_t pwmEdge; // 0: start of period, n: edge n - 1
+
+  const uint32_t irqStart = GetCycleCountIRQ();
   // Optimize the NMI inner loop by keeping track of the min and max GPIO that we
   // are generating.  In the common case (1 PWM) these may be the same pin and
   // we can avoid looking at the other pins.
@@ -223,11 +635,24 @@ static ICACHE_RAM_ATTR void timer1Interrupt() {
     endPin = 32 - __builtin_clz(waveformEnabled);
   }
 
+  if (pwmToDisable) {
+    uint32_t keep = ~pwmToDisable;
+    pwmActive = maskPWM(pwmActive, keep);
+    pwmNext = maskPWM(pwmNext, keep);
+    pwmToDisable = 0;
+  }
+  if (!pwmActive && pwmNext) {
+    // First table, start a period now
+    pwmEdge = 0;
+    pwmNextCycle = irqStart;
+  }
+
   bool done = false;
-  if (waveformEnabled) {
+  bool sequenceEnded = false;
+  if (waveformEnabled || pwmActive || pwmNext || !sequencesIdle()) {
     do {
       nextEventCycles = microsecondsToClockCycles(MAXIRQUS);
-      for (int i = startPin; i <= endPin; i++) {
+      for (int i = startPin; waveformEnabled && i <= endPin; i++) {
         uint32_t mask = 1<<i;
 
         // If it's not on, ignore!
@@ -280,13 +705,84 @@ static ICACHE_RAM_ATTR void timer1Interrupt() {
         }
       }
 
+      // Sequence stop requests and sigma-delta steps, PWM steps wait for a period start
+      for (int i = 0; i < WAVEFORM_SEQUENCES; i++) {
+        Sequence *seq = &sequences[i];
+        if (seq->stop) {
+          seq->active = NULL;
+          seq->next = NULL;
+          seq->stop = false;
+          sequenceEnded = true;
+          continue;
+        }
+        if ((seq->pin != SIGMA_DELTA_SEQUENCE) || !(seq->active || seq->next)) {
+          continue;
+        }
+        uint32_t now = GetCycleCountIRQ();
+        int32_t value = stepSequence(seq, now);
+        if (value >= 0) {
+          GPSD = (GPSD & ~(0xFF << GPSDT)) | ((value >> 8) << GPSDT);
+        }
+        if (seq->active) {
+          int32_t cyclesToGo = seq->nextCycle - now;
+          nextEventCycles = min_u32(nextEventCycles, (cyclesToGo > 0) ? cyclesToGo : 0);
+        } else if (!seq->next) {
+          sequenceEnded = true; // A table not repeated played its last value
+        }
+      }
+
+      // Play the PWM edges that are due
+      for (;;) {
+        PWMTable *table = pwmActive;
+        if (!table && !pwmNext) {
+          break;
+        }
+        uint32_t now = GetCycleCountIRQ();
+        int32_t late = now - pwmNextCycle;
+        if (late < 0) {
+          nextEventCycles = min_u32(nextEventCycles, -late);
+          break;
+        }
+        if (pwmEdge == 0) {
+          if (pwmNext) {
+            // Swap tables between two periods
+            table = pwmActive = pwmNext;
+            pwmNext = NULL;
+          }
+          table = stepPWMSequences(table, now);
+          SetGPIO(table->setMask);
+          // Start over if an entire period was missed
+          pwmPeriodStart = ((uint32_t)late < table->periodCycles) ? pwmNextCycle : now;
+        } else {
+          ClearGPIO(table->clearMask[pwmEdge - 1]);
+        }
+        if ((uint32_t)late > waveformStats.maxLateCycles) {
+          waveformStats.maxLateCycles = late;
+        }
+        if (pwmEdge < table->count) {
+          pwmNextCycle = pwmPeriodStart + table->edgeCycles[pwmEdge];
+          pwmEdge++;
+        } else {
+          pwmNextCycle = pwmPeriodStart + table->periodCycles;
+          pwmEdge = 0;
+        }
+      }
+
       // Exit the loop if we've hit the fixed runtime limit or the next event is known to be after that timeout would occur
       uint32_t now = GetCycleCountIRQ();
       int32_t cycleDeltaNextEvent = timeoutCycle - (now + nextEventCycles);
       int32_t cyclesLeftTimeout = timeoutCycle - now;
       done = (cycleDeltaNextEvent < 0) || (cyclesLeftTimeout < 0);
     } while (!done);
-  } // if (waveformEnabled)
+  } // if (waveformEnabled || pwm)
+
+  // A sigma-delta sequence was the last user, don't keep waking up every
+  // MAXIRQUS. Callers publish their request before checking timerRunning.
+  if (sequenceEnded && !waveformEnabled && !waveformToEnable && !timer1CB &&
+      !pwmActive && !pwmNext && sequencesIdle()) {
+    deinitTimer();
+    return;
+  }
 
   if (timer1CB) {
     nextEventCycles = min_u32(nextEventCycles, timer1CB());
@@ -304,6 +800,13 @@ static ICACHE_RAM_ATTR void timer1Interrupt() {
   T1L = nextEventCycles; // Already know we're in range by MAXIRQUS
 #endif
   TEIE |= TEIE1; // Edge int enable
+
+  const uint32_t irqCycles = GetCycleCountIRQ() - irqStart;
+  waveformStats.irqs++;
+  waveformStats.irqCycles += irqCycles;
+  if (irqCycles > waveformStats.maxIrqCycles) {
+    waveformStats.maxIrqCycles = irqCycles;
+  }
 }
 
 };
@@ -42,6 +42,12 @@
 #ifndef __ESP8266_WAVEFORM_H
 #define __ESP8266_WAVEFORM_H
 
+#ifndef WAVEFORM_SEQUENCES
+#define WAVEFORM_SEQUENCES 4
+#endif
+
+#define SIGMA_DELTA_SEQUENCE 0xff
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -54,6 +60,42 @@ int startWaveform(uint8_t pin, uint32_t timeHighUS, uint32_t timeLowUS, uint32_t
 // Returns true or false on success or failure.
 int stopWaveform(uint8_t pin);
 
+// Start or change phase aligned PWM on GPIO 0-15, times in CPU cycles.  All
+// channels share one period and rise together, a new period applies to all
+// of them keeping their duty cycle.  Changes take effect at the start of the
+// next period.  0 < timeHighCycles < periodCycles, use digitalWrite() for
+// steady levels.  stopWaveform() stops a PWM channel.
+// Returns true or false on success or failure.
+int startPWM(uint8_t pin, uint32_t timeHighCycles, uint32_t periodCycles);
+
+// Step a PWM channel started with startPWM(), or the sigma-delta target with
+// pin SIGMA_DELTA_SEQUENCE, through count values every stepCycles (at least
+// 10us), from the timer1 interrupt.  Values are 0 (off) to 65535 (steady on)
+// and must stay in RAM until played.  The sigma-delta target only has 8 bits,
+// it gets value >> 8: 65535 is 255, not steady on.  PWM steps are applied at the start of
+// the next period, steps missed are skipped to keep the rate.  On a pin
+// already playing, the new table starts after the current one ends (at the
+// end of a pass for repeated tables).  A table not repeated leaves its last
+// value, timer1 stops once nothing else uses it.  Up to WAVEFORM_SEQUENCES
+// pins at once.
+// Returns true or false on success or failure.
+int startSequence(uint8_t pin, const uint16_t *values, uint32_t count, uint32_t stepCycles, bool repeat);
+// Stop the sequence on a pin, its last value stays.  stopWaveform() on a
+// PWM pin stops its sequence too.
+int stopSequence(uint8_t pin);
+// Index of the value being played, or -1
+int sequencePosition(uint8_t pin);
+
+// Timer1 interrupt load, in CPU cycles
+typedef struct {
+  uint32_t irqs;          // Interrupts since reset
+  uint32_t maxIrqCycles;  // Longest interrupt
+  uint64_t irqCycles;     // Total time spent in the interrupt
+  uint32_t maxLateCycles; // Longest delay of a PWM edge past its time
+} WaveformStats;
+void getWaveformStats(WaveformStats *stats);
+void resetWaveformStats();
+
 // Add a callback function to be called on *EVERY* timer1 trigger.  The
 // callback returns the number of microseconds until the next desired call.
 // However, since it is called every timer1 interrupt, it may be called
@@ -63,6 +105,9 @@ int stopWaveform(uint8_t pin);
 // generated, stop the timer as well.
 // Make sure the CB function has the ICACHE_RAM_ATTR decorator.
 void setTimer1Callback(uint32_t (*fn)());
+// The callback currently set, NULL if none. There is a single one: check
+// that it is free, or yours, before setting it.
+uint32_t (*getTimer1Callback())();
 
 #ifdef __cplusplus
 }
@@ -27,6 +27,7 @@
 #include "user_interface.h"
 #include "core_esp8266_waveform.h"
 #include "interrupts.h"
+#include "edge_capture.h"
 
 extern "C" {
 
@@ -129,12 +130,15 @@ typedef struct {
 
 static interrupt_handler_t interrupt_handlers[16] = { {0, 0, 0, 0}, };
 static uint32_t interrupt_reg = 0;
+static uint32_t edge_capture_reg = 0; // pins timestamped by edge_capture_isr()
 
 void ICACHE_RAM_ATTR interrupt_handler(void*)
 {
+  uint32_t cycles = ESP.getCycleCount();
   uint32_t status = GPIE;
   GPIEC = status;//clear them interrupts
   uint32_t levels = GPI;
+  if(status & edge_capture_reg) edge_capture_isr(status & edge_capture_reg, levels, cycles);
   if(status == 0 || interrupt_reg == 0) return;
   ETS_GPIO_INTR_DISABLE();
   int i = 0;
@@ -202,6 +206,7 @@ extern void __attachInterruptFunctionalArg(uint8_t pin, voidFuncPtrArg userFunc,
     ETS_GPIO_INTR_DISABLE();
     set_interrupt_handlers(pin, (voidFuncPtr)userFunc, arg, mode, functional);
     interrupt_reg |= (1 << pin);
+    edge_capture_reg &= ~(1 << pin);
     GPC(pin) &= ~(0xF << GPCI);//INT mode disabled
     GPIEC = (1 << pin); //Clear Interrupt for this pin
     GPC(pin) |= ((mode & 0xF) << GPCI);//INT mode "mode"
@@ -223,7 +228,7 @@ extern void ICACHE_RAM_ATTR __detachInterrupt(uint8_t pin) {
         GPIEC = (1 << pin); //Clear Interrupt for this pin
         interrupt_reg &= ~(1 << pin);
 		set_interrupt_handlers(pin, nullptr, nullptr, 0, false);
-        if (interrupt_reg)
+        if (interrupt_reg || edge_capture_reg)
         {
             ETS_GPIO_INTR_ENABLE();
         }
@@ -235,6 +240,35 @@ extern void __attachInterrupt(uint8_t pin, voidFuncPtr userFunc, int mode)
     __attachInterruptFunctionalArg(pin, (voidFuncPtrArg)userFunc, 0, mode, false);
 }
 
+extern void edge_capture_attach(uint8_t pin, int mode)
+{
+  if(pin < 16) {
+    ETS_GPIO_INTR_DISABLE();
+    set_interrupt_handlers(pin, nullptr, nullptr, 0, false);
+    interrupt_reg &= ~(1 << pin);
+    edge_capture_reg |= (1 << pin);
+    GPC(pin) &= ~(0xF << GPCI);//INT mode disabled
+    GPIEC = (1 << pin); //Clear Interrupt for this pin
+    GPC(pin) |= ((mode & 0xF) << GPCI);//INT mode "mode"
+    ETS_GPIO_INTR_ATTACH(interrupt_handler, &interrupt_reg);
+    ETS_GPIO_INTR_ENABLE();
+  }
+}
+
+extern void edge_capture_detach(uint8_t pin)
+{
+  if(pin < 16 && (edge_capture_reg & (1 << pin))) {
+    ETS_GPIO_INTR_DISABLE();
+    GPC(pin) &= ~(0xF << GPCI);//INT mode disabled
+    GPIEC = (1 << pin); //Clear Interrupt for this pin
+    edge_capture_reg &= ~(1 << pin);
+    if (interrupt_reg || edge_capture_reg)
+    {
+      ETS_GPIO_INTR_ENABLE();
+    }
+  }
+}
+
 extern void initPins() {
   //Disable UART interrupts
   system_set_os_print(0);
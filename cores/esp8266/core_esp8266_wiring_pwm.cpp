@@ -67,6 +67,13 @@ extern void __analogWrite(uint8_t pin, int val) {
   } else if (high == 0) {
     stopWaveform(pin);
     digitalWrite(pin, LOW);
+  } else if (pin < 16) {
+    // Phase aligned with the other channels, at CPU cycle resolution
+    uint32_t periodCycles = microsecondsToClockCycles(analogPeriod);
+    uint32_t highCycles = ((uint64_t)periodCycles * val) / analogScale;
+    if (startPWM(pin, highCycles, periodCycles)) {
+      analogMap |= (1 << pin);
+    }
   } else {
     if (startWaveform(pin, high, low, 0)) {
       analogMap |= (1 << pin);
@@ -24,6 +24,8 @@ bool sntp_set_timezone_in_seconds(int32_t timezone);
 
 uint32_t sqrt32 (uint32_t n);
 uint32_t crc32 (const void* data, size_t length, uint32_t crc = 0xffffffff);
+// Drops cached FlashHash results overlapping a flash range about to change
+void flash_hash_invalidate (uint32_t address, uint32_t size);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,331 @@
+/*
+ edge_capture.cpp - timestamped GPIO edge capture and decoders
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <Arduino.h>
+#include "edge_capture.h"
+
+#ifndef EDGE_CAPTURE_CYCLES
+#define EDGE_CAPTURE_CYCLES() ESP.getCycleCount()
+#endif
+
+// Written by the interrupt and read from CONT, each side only moves its
+// own index
+static edge_capture_event_t *_ring;
+static size_t _size;
+static volatile size_t _head; // next write
+static volatile size_t _tail; // next read
+static volatile uint32_t _overflows;
+
+bool edge_capture_begin(size_t size)
+{
+    edge_capture_end();
+    if (size < 2) {
+        return false;
+    }
+    edge_capture_event_t *ring = (edge_capture_event_t*)malloc(size * sizeof(ring[0]));
+    if (!ring) {
+        return false;
+    }
+    _head = _tail = 0;
+    _overflows = 0;
+    _size = size;
+    _ring = ring;
+    return true;
+}
+
+void edge_capture_end(void)
+{
+    for (uint8_t pin = 0; pin < 16; pin++) {
+        edge_capture_detach(pin);
+    }
+    free(_ring);
+    _ring = nullptr;
+    _size = 0;
+}
+
+void ICACHE_RAM_ATTR edge_capture_isr(uint32_t pins, uint32_t levels, uint32_t cycles)
+{
+    if (!_ring) {
+        return;
+    }
+    while (pins) {
+        uint8_t pin = __builtin_ctz(pins);
+        pins &= pins - 1;
+        size_t next = _head + 1;
+        if (next == _size) {
+            next = 0;
+        }
+        if (next == _tail) {
+            _overflows++;
+            continue;
+        }
+        edge_capture_event_t& e = _ring[_head];
+        e.cycles = cycles;
+        e.pin = pin;
+        e.level = (levels >> pin) & 1;
+        // The event is complete before CONT can see it
+        __asm__ __volatile__("" ::: "memory");
+        _head = next;
+    }
+}
+
+size_t edge_capture_available(void)
+{
+    size_t head = _head;
+    return (head >= _tail) ? head - _tail : _size - _tail + head;
+}
+
+size_t edge_capture_read(edge_capture_event_t *events, size_t max)
+{
+    size_t n = 0;
+    size_t tail = _tail;
+    size_t head = _head;
+    // The events up to head are read after it
+    __asm__ __volatile__("" ::: "memory");
+    while (n < max && tail != head) {
+        events[n++] = _ring[tail];
+        if (++tail == _size) {
+            tail = 0;
+        }
+    }
+    // And copied before their slots are given back
+    __asm__ __volatile__("" ::: "memory");
+    _tail = tail;
+    return n;
+}
+
+uint32_t edge_capture_overflows(void)
+{
+    return _overflows;
+}
+
+size_t edge_capture_dispatch(EdgeDecoder* const* decoders, size_t count)
+{
+    edge_capture_event_t events[16];
+    size_t total = 0;
+    size_t n;
+    // At most a ring's worth, not to be kept here by a fast input
+    while (total < _size && (n = edge_capture_read(events, 16))) {
+        for (size_t i = 0; i < n; i++) {
+            for (size_t d = 0; d < count; d++) {
+                decoders[d]->feed(events[i]);
+            }
+        }
+        total += n;
+    }
+    uint32_t now = EDGE_CAPTURE_CYCLES();
+    for (size_t d = 0; d < count; d++) {
+        decoders[d]->poll(now);
+    }
+    return total;
+}
+
+EdgeFrequency::EdgeFrequency(uint8_t pin, uint32_t timeout_ms):
+    _timeout(microsecondsToClockCycles(timeout_ms * 1000)), _rise(0), _period(0),
+    _high(0), _pulses(0), _missed(0), _pin(pin), _level(0), _fell(false), _valid(false)
+{
+}
+
+void EdgeFrequency::feed(const edge_capture_event_t& event)
+{
+    if (event.pin != _pin) {
+        return;
+    }
+    // Same level twice: a pulse shorter than the interrupt latency. Only
+    // meaningful once both levels were seen (not with RISING captures)
+    if (_fell && event.level == _level) {
+        _missed++;
+    }
+    if (event.level) {
+        if (_valid) {
+            _period = event.cycles - _rise;
+        }
+        _rise = event.cycles;
+        _valid = true;
+        _pulses++;
+    } else {
+        if (_valid) {
+            _high = event.cycles - _rise;
+        }
+        _fell = true;
+    }
+    _level = event.level;
+}
+
+void EdgeFrequency::poll(uint32_t cycles)
+{
+    if (_valid && cycles - _rise > _timeout) {
+        // Stopped, the next rising edge starts over
+        _period = _high = 0;
+        _valid = false;
+    }
+}
+
+uint32_t EdgeFrequency::periodMicros() const
+{
+    return clockCyclesToMicroseconds(_period);
+}
+
+uint32_t EdgeFrequency::highMicros() const
+{
+    return clockCyclesToMicroseconds(_high);
+}
+
+float EdgeFrequency::frequency() const
+{
+    return _period ? 1000000.0f * clockCyclesPerMicrosecond() / _period : 0;
+}
+
+float EdgeFrequency::duty() const
+{
+    return _period ? (float)_high / _period : 0;
+}
+
+EdgePulseTrain::EdgePulseTrain(uint8_t pin, uint32_t gap_us, size_t max_pulses):
+    _pulses(max_pulses ? new (std::nothrow) uint32_t[max_pulses] : nullptr),
+    _capacity(_pulses ? max_pulses : 0), _size(0),
+    _gap(microsecondsToClockCycles(gap_us)), _last(0), _dropped(0), _pin(pin),
+    _first(0), _started(false), _ready(false)
+{
+}
+
+EdgePulseTrain::~EdgePulseTrain()
+{
+    delete[] _pulses;
+}
+
+void EdgePulseTrain::feed(const edge_capture_event_t& event)
+{
+    if (event.pin != _pin || !_capacity) {
+        // Out of memory or no room asked for, the decoder stays inert
+        return;
+    }
+    if (_started && event.cycles - _last > _gap) {
+        finish();
+    }
+    if (_ready) {
+        _dropped++;
+        return;
+    }
+    if (_started) {
+        _pulses[_size++] = clockCyclesToMicroseconds(event.cycles - _last);
+        if (_size == _capacity) {
+            finish();
+        }
+    } else {
+        _started = true;
+        _size = 0;
+        _first = event.level;
+    }
+    _last = event.cycles;
+}
+
+void EdgePulseTrain::poll(uint32_t cycles)
+{
+    if (_started && cycles - _last > _gap) {
+        finish();
+    }
+}
+
+void EdgePulseTrain::finish()
+{
+    _started = false;
+    _ready = _size > 0;
+}
+
+void EdgePulseTrain::clear()
+{
+    _ready = false;
+    _size = 0;
+}
+
+static bool near(uint32_t us, uint32_t expected)
+{
+    // 25%, receivers stretch marks and shorten spaces by ~100us
+    return us > expected - expected / 4 && us < expected + expected / 4;
+}
+
+bool EdgePulseTrain::decodeNEC(uint32_t* code) const
+{
+    // 9ms mark, 4.5ms space, 32 bits of a 560us mark and a 560us (0) or
+    // 1690us (1) space, final mark
+    if (!_ready || _first != 0 || _size < 67 ||
+            !near(_pulses[0], 9000) || !near(_pulses[1], 4500)) {
+        return false;
+    }
+    uint32_t value = 0;
+    for (int bit = 0; bit < 32; bit++) {
+        uint32_t mark = _pulses[2 + 2 * bit];
+        uint32_t space = _pulses[3 + 2 * bit];
+        if (!near(mark, 560)) {
+            return false;
+        }
+        if (near(space, 1690)) {
+            value |= 1UL << bit;
+        } else if (!near(space, 560)) {
+            return false;
+        }
+    }
+    *code = value;
+    return true;
+}
+
+EdgeQuadrature::EdgeQuadrature(uint8_t pinA, uint8_t pinB, uint8_t levelA, uint8_t levelB):
+    _position(0), _errors(0), _lastCycles(0), _lastStep(0), _lastBit(0),
+    _pinA(pinA), _pinB(pinB), _state((levelA ? 2 : 0) | (levelB ? 1 : 0))
+{
+}
+
+void EdgeQuadrature::feed(const edge_capture_event_t& event)
+{
+    uint8_t bit;
+    if (event.pin == _pinA) {
+        bit = 2;
+    } else if (event.pin == _pinB) {
+        bit = 1;
+    } else {
+        return;
+    }
+    if (_lastBit && _lastBit != bit && event.cycles == _lastCycles) {
+        // A and B changed in the same interrupt, queued in pin order: the
+        // real order is unknown. Undo the first step, take both levels.
+        _position -= _lastStep;
+        if (_lastStep) {
+            _errors++; // else already counted as merged
+        }
+        _state = (_state & ~bit) | (event.level ? bit : 0);
+        _lastBit = 0;
+        return;
+    }
+    _lastCycles = event.cycles;
+    _lastBit = bit;
+    _lastStep = 0;
+    if (!(_state & bit) == !event.level) {
+        // Both edges of a pulse were merged, the direction is unknown
+        _errors++;
+        return;
+    }
+    // Position of AB in the 00 10 11 01 cycle
+    static const uint8_t phase[4] = { 0, 3, 1, 2 };
+    uint8_t state = _state ^ bit;
+    _lastStep = ((phase[state] - phase[_state]) & 3) == 1 ? 1 : -1;
+    _position += _lastStep;
+    _state = state;
+}
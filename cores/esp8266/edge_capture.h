@@ -0,0 +1,192 @@
+/*
+ edge_capture.h - timestamped GPIO edge capture and decoders
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef EDGE_CAPTURE_H
+#define EDGE_CAPTURE_H
+
+/*
+ * Pins attached with edge_capture_attach() are serviced first by the GPIO
+ * interrupt: the cycle count taken on entry, the pin and its level are
+ * stored in a ring, nothing else runs. The loop drains the ring, usually
+ * through edge_capture_dispatch() which feeds decoders:
+ *
+ * - EdgeFrequency: pulse count, period, high time and duty cycle of a pin
+ *   (flow meters, tachometers, RC receiver channels)
+ * - EdgePulseTrain: mark and space durations of bursts separated by a gap
+ *   (IR remotes, with a NEC decoder)
+ * - EdgeQuadrature: position of an A/B encoder
+ *
+ * The timestamp is the interrupt entry, so edges are a few us late but
+ * equally so. Two edges closer than the interrupt latency are seen as one:
+ * the level doesn't change, decoders count these as missed. Edges that
+ * don't fit in the ring are counted as overflows.
+ *
+ * A pin is either captured or used with attachInterrupt(), not both.
+ * GPIO16 has no interrupt.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t cycles;    // ESP.getCycleCount() at interrupt entry
+    uint8_t pin;
+    uint8_t level;      // after the edge
+} edge_capture_event_t;
+
+// Allocates a ring of size events
+bool edge_capture_begin(size_t size);
+void edge_capture_end(void);
+// mode: RISING, FALLING or CHANGE. Decoders need CHANGE, except for
+// EdgeFrequency counting pulses only
+void edge_capture_attach(uint8_t pin, int mode);
+void edge_capture_detach(uint8_t pin);
+
+// Events waiting in the ring
+size_t edge_capture_available(void);
+// Copies up to max events, oldest first, returns the count
+size_t edge_capture_read(edge_capture_event_t *events, size_t max);
+// Events lost because the ring was full, since begin
+uint32_t edge_capture_overflows(void);
+
+// Called by the GPIO interrupt with the captured pins that changed
+void edge_capture_isr(uint32_t pins, uint32_t levels, uint32_t cycles);
+
+#ifdef __cplusplus
+}
+
+class EdgeDecoder
+{
+public:
+    virtual ~EdgeDecoder () {}
+    // An event of any pin
+    virtual void feed (const edge_capture_event_t& event) = 0;
+    // After the ring is drained, to notice pins that went quiet
+    virtual void poll (uint32_t cycles) { (void)cycles; }
+};
+
+// Drains the ring into the decoders, returns the number of events
+size_t edge_capture_dispatch(EdgeDecoder* const* decoders, size_t count);
+
+class EdgeFrequency: public EdgeDecoder
+{
+public:
+    // Period and high time fall back to 0 after timeout_ms without a rising edge
+    EdgeFrequency (uint8_t pin, uint32_t timeout_ms = 1000);
+
+    void feed (const edge_capture_event_t& event) override;
+    void poll (uint32_t cycles) override;
+
+    uint32_t pulses () const { return _pulses; }
+    uint32_t missed () const { return _missed; }
+    uint32_t periodMicros () const;
+    uint32_t highMicros () const;
+    float frequency () const;
+    // 0..1
+    float duty () const;
+
+protected:
+    uint32_t _timeout;
+    uint32_t _rise;
+    uint32_t _period;
+    uint32_t _high;
+    uint32_t _pulses;
+    uint32_t _missed;
+    uint8_t _pin;
+    uint8_t _level;
+    bool _fell;     // both levels were seen
+    bool _valid;    // _rise is the last rising edge, not timed out
+};
+
+class EdgePulseTrain: public EdgeDecoder
+{
+public:
+    // A train ends after gap_us without an edge, or when max_pulses is reached.
+    // Without memory for max_pulses (or with 0), no train is ever available.
+    EdgePulseTrain (uint8_t pin, uint32_t gap_us = 10000, size_t max_pulses = 100);
+    ~EdgePulseTrain () override;
+    EdgePulseTrain (const EdgePulseTrain&) = delete;
+    EdgePulseTrain& operator= (const EdgePulseTrain&) = delete;
+
+    void feed (const edge_capture_event_t& event) override;
+    void poll (uint32_t cycles) override;
+
+    // A complete train is kept until clear(), later ones are dropped
+    bool available () const { return _ready; }
+    // Durations in us, the first one starts at the first edge
+    const uint32_t* pulses () const { return _pulses; }
+    size_t size () const { return _size; }
+    // Level of the first duration
+    uint8_t firstLevel () const { return _first; }
+    // Edges ignored while a complete train waited
+    uint32_t dropped () const { return _dropped; }
+    void clear ();
+
+    // NEC remote frame of an active low receiver: address and command
+    // bytes with their complements, LSB first. Repeat frames return false.
+    bool decodeNEC (uint32_t* code) const;
+
+protected:
+    void finish ();
+
+    uint32_t* _pulses;
+    size_t _capacity;
+    size_t _size;
+    uint32_t _gap;
+    uint32_t _last;
+    uint32_t _dropped;
+    uint8_t _pin;
+    uint8_t _first;
+    bool _started;
+    bool _ready;
+};
+
+class EdgeQuadrature: public EdgeDecoder
+{
+public:
+    // Levels of A and B now, from digitalRead()
+    EdgeQuadrature (uint8_t pinA, uint8_t pinB, uint8_t levelA, uint8_t levelB);
+
+    void feed (const edge_capture_event_t& event) override;
+
+    // One count per edge, 4 per encoder cycle, increasing when A leads B
+    int32_t position () const { return _position; }
+    void setPosition (int32_t position) { _position = position; }
+    // Merged pulses, and A and B changing in the same interrupt
+    uint32_t errors () const { return _errors; }
+
+protected:
+    int32_t _position;
+    uint32_t _errors;
+    uint32_t _lastCycles; // time of the last A or B edge
+    int8_t _lastStep;     // what it did to _position
+    uint8_t _lastBit;     // its bit in _state, 0 once paired
+    uint8_t _pinA;
+    uint8_t _pinB;
+    uint8_t _state; // A << 1 | B
+};
+
+#endif
+
+#endif // EDGE_CAPTURE_H
@@ -8,6 +8,9 @@
 #include <c_types.h>
 #include <sys/reent.h>
 #include <user_interface.h>
+#ifdef UMM_HEAP_PROFILER
+#include "heap_profiler.h"
+#endif
 
 extern "C" {
 
@@ -20,7 +23,7 @@ extern "C" {
 #undef realloc
 #undef free
 
-#elif defined(DEBUG_ESP_OOM)
+#elif defined(DEBUG_ESP_OOM) || defined(UMM_HEAP_PROFILER)
 #define UMM_MALLOC(s)           umm_malloc(s)
 #define UMM_CALLOC(n,s)         umm_calloc(n,s)
 #define UMM_REALLOC_FL(p,s,f,l) umm_realloc(p,s)
@@ -29,7 +32,7 @@ extern "C" {
 #undef realloc
 #undef free
 
-#else  // ! UMM_POISON_CHECK && ! DEBUG_ESP_OOM
+#else  // ! UMM_POISON_CHECK && ! DEBUG_ESP_OOM && ! UMM_HEAP_PROFILER
 #define UMM_MALLOC(s)           malloc(s)
 #define UMM_CALLOC(n,s)         calloc(n,s)
 #define UMM_REALLOC_FL(p,s,f,l) realloc(p,s)
@@ -116,11 +119,38 @@ int umm_last_fail_alloc_line = 0;
     }
 #endif
 
+#ifdef UMM_HEAP_PROFILER
+#define HEAP_PROFILER__ALLOC(p, s)          heap_profiler_record(p, s, NULL, (uint32_t)__builtin_return_address(0))
+#define HEAP_PROFILER__ALLOC_FL(p, s, f, l) heap_profiler_record(p, s, f, l)
+#define HEAP_PROFILER__FREE(p)              heap_profiler_forget(p)
+// Charge an allocation made by the wrapper to the wrapper's caller
+#define HEAP_PROFILER__CALLER(p)            heap_profiler_retag(p, NULL, (uint32_t)__builtin_return_address(0))
+// A successful realloc() (or one to size 0) releases the old block
+#define HEAP_PROFILER__REALLOC(o, p, s) \
+    do { \
+        if (p || 0 == s) heap_profiler_forget(o); \
+        HEAP_PROFILER__ALLOC(p, s); \
+    } while(0)
+#define HEAP_PROFILER__REALLOC_FL(o, p, s, f, l) \
+    do { \
+        if (p || 0 == s) heap_profiler_forget(o); \
+        heap_profiler_record(p, s, f, l); \
+    } while(0)
+#else
+#define HEAP_PROFILER__ALLOC(p, s)               do {} while(0)
+#define HEAP_PROFILER__ALLOC_FL(p, s, f, l)      do {} while(0)
+#define HEAP_PROFILER__FREE(p)                   do {} while(0)
+#define HEAP_PROFILER__CALLER(p)                 do {} while(0)
+#define HEAP_PROFILER__REALLOC(o, p, s)          do {} while(0)
+#define HEAP_PROFILER__REALLOC_FL(o, p, s, f, l) do {} while(0)
+#endif
+
 void* _malloc_r(struct _reent* unused, size_t size)
 {
     (void) unused;
     void *ret = malloc(size);
     PTR_CHECK__LOG_LAST_FAIL(ret, size);
+    HEAP_PROFILER__CALLER(ret);
     return ret;
 }
 
@@ -135,6 +165,7 @@ void* _realloc_r(struct _reent* unused, void* ptr, size_t size)
     (void) unused;
     void *ret = realloc(ptr, size);
     PTR_CHECK__LOG_LAST_FAIL(ret, size);
+    HEAP_PROFILER__CALLER(ret);
     return ret;
 }
 
@@ -143,6 +174,7 @@ void* _calloc_r(struct _reent* unused, size_t count, size_t size)
     (void) unused;
     void *ret = calloc(count, size);
     PTR_CHECK__LOG_LAST_FAIL(ret, count * size);
+    HEAP_PROFILER__CALLER(ret);
     return ret;
 }
 
@@ -202,7 +234,7 @@ void ICACHE_RAM_ATTR print_oom_size(size_t size)
 #define OOM_CHECK__PRINT_LOC(p, s, f, l)
 #endif
 
-#if defined(DEBUG_ESP_OOM) || defined(UMM_POISON_CHECK) || defined(UMM_POISON_CHECK_LITE) || defined(UMM_INTEGRITY_CHECK)
+#if defined(DEBUG_ESP_OOM) || defined(UMM_POISON_CHECK) || defined(UMM_POISON_CHECK_LITE) || defined(UMM_INTEGRITY_CHECK) || defined(UMM_HEAP_PROFILER)
 /*
   The thinking behind the ordering of Integrity Check, Full Poison Check, and
   the specific *alloc function.
@@ -228,6 +260,7 @@ void* ICACHE_RAM_ATTR malloc(size_t size)
     void* ret = UMM_MALLOC(size);
     PTR_CHECK__LOG_LAST_FAIL(ret, size);
     OOM_CHECK__PRINT_OOM(ret, size);
+    HEAP_PROFILER__ALLOC(ret, size);
     return ret;
 }
 
@@ -238,6 +271,7 @@ void* ICACHE_RAM_ATTR calloc(size_t count, size_t size)
     void* ret = UMM_CALLOC(count, size);
     PTR_CHECK__LOG_LAST_FAIL(ret, count * size);
     OOM_CHECK__PRINT_OOM(ret, size);
+    HEAP_PROFILER__ALLOC(ret, count * size);
     return ret;
 }
 
@@ -248,12 +282,14 @@ void* ICACHE_RAM_ATTR realloc(void* ptr, size_t size)
     POISON_CHECK__ABORT();
     PTR_CHECK__LOG_LAST_FAIL(ret, size);
     OOM_CHECK__PRINT_OOM(ret, size);
+    HEAP_PROFILER__REALLOC(ptr, ret, size);
     return ret;
 }
 
 void ICACHE_RAM_ATTR free(void* p)
 {
     INTEGRITY_CHECK__ABORT();
+    HEAP_PROFILER__FREE(p);
     UMM_FREE_FL(p, NULL, 0);
     POISON_CHECK__ABORT();
 }
@@ -267,6 +303,7 @@ void* ICACHE_RAM_ATTR pvPortMalloc(size_t size, const char* file, int line)
     void* ret = UMM_MALLOC(size);
     PTR_CHECK__LOG_LAST_FAIL_FL(ret, size, file, line);
     OOM_CHECK__PRINT_LOC(ret, size, file, line);
+    HEAP_PROFILER__ALLOC_FL(ret, size, file, line);
     return ret;
 }
 
@@ -277,6 +314,7 @@ void* ICACHE_RAM_ATTR pvPortCalloc(size_t count, size_t size, const char* file,
     void* ret = UMM_CALLOC(count, size);
     PTR_CHECK__LOG_LAST_FAIL_FL(ret, count * size, file, line);
     OOM_CHECK__PRINT_LOC(ret, size, file, line);
+    HEAP_PROFILER__ALLOC_FL(ret, count * size, file, line);
     return ret;
 }
 
@@ -287,6 +325,7 @@ void* ICACHE_RAM_ATTR pvPortRealloc(void *ptr, size_t size, const char* file, in
     POISON_CHECK__PANIC_FL(file, line);
     PTR_CHECK__LOG_LAST_FAIL_FL(ret, size, file, line);
     OOM_CHECK__PRINT_LOC(ret, size, file, line);
+    HEAP_PROFILER__REALLOC_FL(ptr, ret, size, file, line);
     return ret;
 }
 
@@ -297,12 +336,14 @@ void* ICACHE_RAM_ATTR pvPortZalloc(size_t size, const char* file, int line)
     void* ret = UMM_CALLOC(1, size);
     PTR_CHECK__LOG_LAST_FAIL_FL(ret, size, file, line);
     OOM_CHECK__PRINT_LOC(ret, size, file, line);
+    HEAP_PROFILER__ALLOC_FL(ret, size, file, line);
     return ret;
 }
 
 void ICACHE_RAM_ATTR vPortFree(void *ptr, const char* file, int line)
 {
     INTEGRITY_CHECK__PANIC_FL(file, line);
+    HEAP_PROFILER__FREE(ptr);
     UMM_FREE_FL(ptr, file, line);
     POISON_CHECK__PANIC_FL(file, line);
 }
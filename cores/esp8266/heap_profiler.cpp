@@ -0,0 +1,274 @@
+/*
+ heap_profiler.cpp - allocation site heap profiler
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef UMM_HEAP_PROFILER
+
+#include <Arduino.h>
+#include "heap_profiler.h"
+
+static_assert((UMM_HEAP_PROFILER_ALLOCS & (UMM_HEAP_PROFILER_ALLOCS - 1)) == 0, "UMM_HEAP_PROFILER_ALLOCS must be a power of 2");
+static_assert(UMM_HEAP_PROFILER_SITES >= 2 && UMM_HEAP_PROFILER_SITES <= 64, "UMM_HEAP_PROFILER_SITES must be within 2..64");
+
+#define ALLOC_MASK (UMM_HEAP_PROFILER_ALLOCS - 1)
+#define OTHER_SITE (UMM_HEAP_PROFILER_SITES - 1) // sites that didn't fit
+
+// Live allocations, open addressing with linear probing on the pointer
+struct heap_profiler_alloc_t {
+    void *ptr;          // nullptr: empty slot
+    uint16_t size;      // the heap is smaller than 64KB
+    uint16_t site;
+};
+
+static heap_profiler_alloc_t _allocs[UMM_HEAP_PROFILER_ALLOCS];
+static uint32_t _allocCount;
+static heap_profiler_site_t _sites[UMM_HEAP_PROFILER_SITES];
+static uint32_t _siteCount;
+static uint32_t _untracked;
+
+// Called from the heap wrappers, possibly in an ISR
+#define PROFILER_LOCK()   uint32_t _savedPS = xt_rsil(15)
+#define PROFILER_UNLOCK() xt_wsr_ps(_savedPS)
+
+static inline uint32_t ICACHE_RAM_ATTR slotOf(const void *ptr)
+{
+    return ((uint32_t)((uintptr_t)ptr >> 2) * 2654435761u >> 16) & ALLOC_MASK;
+}
+
+static int ICACHE_RAM_ATTR findAlloc(const void *ptr)
+{
+    for (uint32_t i = slotOf(ptr); _allocs[i].ptr; i = (i + 1) & ALLOC_MASK) {
+        if (_allocs[i].ptr == ptr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Backward shift deletion keeps the probe sequences intact
+static void ICACHE_RAM_ATTR removeAlloc(uint32_t i)
+{
+    for (uint32_t j = (i + 1) & ALLOC_MASK; _allocs[j].ptr; j = (j + 1) & ALLOC_MASK) {
+        uint32_t k = slotOf(_allocs[j].ptr);
+        // Move j into the hole unless its home slot lies cyclically in (i, j]
+        bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (!stays) {
+            _allocs[i] = _allocs[j];
+            i = j;
+        }
+    }
+    _allocs[i].ptr = nullptr;
+    _allocCount--;
+}
+
+static inline bool ICACHE_RAM_ATTR siteUnused(const heap_profiler_site_t& s)
+{
+    return s.allocs == 0 && s.live_count == 0;
+}
+
+static uint16_t ICACHE_RAM_ATTR findSite(const char *file, uint32_t where)
+{
+    int unused = -1;
+    for (uint32_t i = 0; i < _siteCount; i++) {
+        if (siteUnused(_sites[i])) {
+            if (unused < 0) {
+                unused = i;
+            }
+        } else if (_sites[i].file == file && _sites[i].where == where) {
+            return i;
+        }
+    }
+    if (unused < 0) {
+        if (_siteCount >= OTHER_SITE) {
+            _sites[OTHER_SITE].file = nullptr;
+            _sites[OTHER_SITE].where = 0;
+            return OTHER_SITE;
+        }
+        unused = _siteCount++;
+    }
+    heap_profiler_site_t& s = _sites[unused];
+    memset(&s, 0, sizeof(s));
+    s.file = file;
+    s.where = where;
+    return unused;
+}
+
+static void ICACHE_RAM_ATTR charge(uint16_t site, uint32_t size)
+{
+    heap_profiler_site_t& s = _sites[site];
+    s.live_bytes += size;
+    s.live_count++;
+    s.allocs++;
+    if (s.live_bytes > s.peak_bytes) {
+        s.peak_bytes = s.live_bytes;
+    }
+}
+
+static void ICACHE_RAM_ATTR discharge(uint16_t site, uint32_t size)
+{
+    heap_profiler_site_t& s = _sites[site];
+    s.live_bytes -= size;
+    s.live_count--;
+}
+
+void ICACHE_RAM_ATTR heap_profiler_record(void *ptr, size_t size, const char *file, uint32_t where)
+{
+    if (!ptr) {
+        return;
+    }
+    PROFILER_LOCK();
+    // Keep the load factor at 3/4 so that probing stays short
+    if (_allocCount >= UMM_HEAP_PROFILER_ALLOCS * 3 / 4) {
+        _untracked++;
+    } else {
+        uint16_t site = findSite(file, where);
+        uint32_t i = slotOf(ptr);
+        while (_allocs[i].ptr) {
+            i = (i + 1) & ALLOC_MASK;
+        }
+        _allocs[i].ptr = ptr;
+        _allocs[i].size = size;
+        _allocs[i].site = site;
+        _allocCount++;
+        charge(site, size);
+    }
+    PROFILER_UNLOCK();
+}
+
+void ICACHE_RAM_ATTR heap_profiler_forget(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    PROFILER_LOCK();
+    int i = findAlloc(ptr);
+    if (i >= 0) {
+        discharge(_allocs[i].site, _allocs[i].size);
+        removeAlloc(i);
+    }
+    PROFILER_UNLOCK();
+}
+
+void ICACHE_RAM_ATTR heap_profiler_retag(void *ptr, const char *file, uint32_t where)
+{
+    if (!ptr) {
+        return;
+    }
+    PROFILER_LOCK();
+    int i = findAlloc(ptr);
+    if (i >= 0) {
+        uint16_t old = _allocs[i].site;
+        discharge(old, _allocs[i].size);
+        _sites[old].allocs--;
+        uint16_t site = findSite(file, where);
+        _allocs[i].site = site;
+        charge(site, _allocs[i].size);
+    }
+    PROFILER_UNLOCK();
+}
+
+// Next site by decreasing live bytes, not yet in *done
+static bool nextSite(heap_profiler_site_t *out, uint64_t *done)
+{
+    PROFILER_LOCK();
+    int best = -1;
+    for (uint32_t i = 0; i < UMM_HEAP_PROFILER_SITES; i++) {
+        const heap_profiler_site_t& s = _sites[i];
+        if ((*done & (1ULL << i)) || siteUnused(s)) {
+            continue;
+        }
+        if (best < 0 || s.live_bytes > _sites[best].live_bytes ||
+                (s.live_bytes == _sites[best].live_bytes && s.peak_bytes > _sites[best].peak_bytes)) {
+            best = i;
+        }
+    }
+    if (best >= 0) {
+        *out = _sites[best];
+        *done |= 1ULL << best;
+    }
+    PROFILER_UNLOCK();
+    return best >= 0;
+}
+
+size_t heap_profiler_snapshot(heap_profiler_site_t *sites, size_t max)
+{
+    uint64_t done = 0;
+    size_t n = 0;
+    while (n < max && nextSite(&sites[n], &done)) {
+        n++;
+    }
+    return n;
+}
+
+uint32_t heap_profiler_untracked(void)
+{
+    return _untracked;
+}
+
+void heap_profiler_reset(void)
+{
+    PROFILER_LOCK();
+    for (uint32_t i = 0; i < UMM_HEAP_PROFILER_SITES; i++) {
+        _sites[i].allocs = 0;
+        _sites[i].peak_bytes = _sites[i].live_bytes;
+    }
+    _untracked = 0;
+    PROFILER_UNLOCK();
+}
+
+static size_t printSite(Print& out, const heap_profiler_site_t& s)
+{
+    if (s.file) {
+        // File names are in flash, print only the base name
+        const char *base = s.file;
+        for (const char *p = s.file; ; p++) {
+            char c = pgm_read_byte(p);
+            if (!c) {
+                break;
+            }
+            if (c == '/' || c == '\\') {
+                base = p + 1;
+            }
+        }
+        return out.print(FPSTR(base)) + out.printf_P(PSTR(":%u"), s.where);
+    }
+    if (s.where) {
+        return out.printf_P(PSTR("0x%08x"), s.where);
+    }
+    return out.print(F("other"));
+}
+
+size_t heap_profiler_report(Print& out)
+{
+    heap_profiler_site_t s;
+    uint64_t done = 0;
+    uint32_t live = 0, count = 0;
+    size_t n = out.println(F("   live    peak count  allocs site"));
+    while (nextSite(&s, &done)) {
+        n += out.printf_P(PSTR("%7u %7u %5u %7u "), s.live_bytes, s.peak_bytes, s.live_count, s.allocs);
+        n += printSite(out, s);
+        n += out.println();
+        live += s.live_bytes;
+        count += s.live_count;
+    }
+    n += out.printf_P(PSTR("%u bytes in %u allocations, %u untracked"), live, count, _untracked);
+    return n + out.println();
+}
+
+#endif // UMM_HEAP_PROFILER
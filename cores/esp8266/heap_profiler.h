@@ -0,0 +1,85 @@
+/*
+ heap_profiler.h - allocation site heap profiler
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef HEAP_PROFILER_H
+#define HEAP_PROFILER_H
+
+/*
+ * Built with -DUMM_HEAP_PROFILER, the heap wrappers (heap.cpp) charge every
+ * live allocation to the site that made it: the file:line given to the
+ * pvPort*() / DEBUG_ESP_OOM variants, or else the caller's PC, to be
+ * symbolised offline with
+ *   xtensa-lx106-elf-addr2line -pfiaC -e sketch.elf 0x4020xxxx
+ *
+ * UMM_HEAP_PROFILER_ALLOCS (power of 2) live allocations and
+ * UMM_HEAP_PROFILER_SITES sites are tracked in static RAM. Allocations that
+ * don't fit are counted as untracked, sites that don't fit are merged into
+ * the last one.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef UMM_HEAP_PROFILER_ALLOCS
+#define UMM_HEAP_PROFILER_ALLOCS 256
+#endif
+
+#ifndef UMM_HEAP_PROFILER_SITES
+#define UMM_HEAP_PROFILER_SITES 48
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char *file;     // PROGMEM file name, or NULL when where is a PC
+    uint32_t where;       // line in file, or caller PC
+    uint32_t live_bytes;
+    uint32_t peak_bytes;  // highest live_bytes since reset
+    uint32_t allocs;      // allocations since reset
+    uint16_t live_count;  // allocations still held
+} heap_profiler_site_t;
+
+// Called by the heap wrappers
+void heap_profiler_record(void *ptr, size_t size, const char *file, uint32_t where);
+void heap_profiler_forget(void *ptr);
+// Charges an allocation made through a wrapper (operator new, _malloc_r...)
+// to the wrapper's caller
+void heap_profiler_retag(void *ptr, const char *file, uint32_t where);
+
+// Copies up to max sites, largest live_bytes first, returns the count
+size_t heap_profiler_snapshot(heap_profiler_site_t *sites, size_t max);
+// Allocations not tracked because the table was full
+uint32_t heap_profiler_untracked(void);
+// Restarts peak and allocation counts from the current live state
+void heap_profiler_reset(void);
+
+#ifdef __cplusplus
+}
+
+class Print;
+
+// Compact text report, one line per site by decreasing live bytes, to
+// Serial or a WiFiClient for offline symbolisation
+size_t heap_profiler_report(Print& out);
+#endif
+
+#endif // HEAP_PROFILER_H
@@ -42,6 +42,9 @@ extern "C" {
 
 void i2s_begin(); // Enable TX only, for compatibility
 bool i2s_rxtx_begin(bool enableRx, bool enableTx); // Allow TX and/or RX, returns false on OOM error
+// Same with a DMA ring of buf_cnt (2..128) buffers of buf_len (1..1023) 32-bit words
+// each, instead of 8 x 64. A deeper ring rides out longer stalls of the sketch.
+bool i2s_rxtx_begin_buffers(bool enableRx, bool enableTx, uint16_t buf_cnt, uint16_t buf_len);
 void i2s_end();
 void i2s_set_rate(uint32_t rate);//Sample Rate in Hz (ex 44100, 48000)
 void i2s_set_dividers(uint8_t div1, uint8_t div2);//Direct control over output rate
@@ -66,6 +69,52 @@ uint16_t i2s_write_buffer_mono_nb(int16_t *frames, uint16_t frame_count);
 uint16_t i2s_write_buffer(int16_t *frames, uint16_t frame_count);
 uint16_t i2s_write_buffer_nb(int16_t *frames, uint16_t frame_count); 
 
+// Zero-copy access to the DMA buffers, i2s_get_buffer_words() long.
+// i2s_get_buffer() returns the next free TX buffer to fill in place, NULL when
+// none is free and !blocking, i2s_submit_buffer() is called once it is filled.
+// i2s_rx_get_buffer() returns the next received buffer, i2s_rx_release_buffer()
+// once it is consumed. The DMA goes around the ring on its own: a TX buffer
+// must be submitted, and a RX buffer released, before its turn comes again,
+// else it counts as an underrun or overrun and the next call moves on.
+uint32_t *i2s_get_buffer(bool blocking);
+void i2s_submit_buffer();
+const uint32_t *i2s_rx_get_buffer(bool blocking);
+void i2s_rx_release_buffer();
+uint16_t i2s_get_buffer_words();
+// Buffers the DMA played before they were complete: still held, or partly
+// written by the sample calls. Idle time with nothing written is not counted.
+uint32_t i2s_get_underruns();
+// Received buffers overwritten before being read, or while still held
+uint32_t i2s_rx_get_overruns();
+
+/*
+DMA bitstream: the I2S transmitter used as a plain shift register. The data
+pin (GPIO3, RX0) clocks out a bit pattern at the chosen bit rate with no CPU
+time per bit, BCK (GPIO15) optionally carries the bit clock for synchronous
+protocols and WS (GPIO2) is left alone: neither begin nor i2s_end() touches
+it, nor BCK without clock_out. Words are sent MSB first, back to
+back. When no data is queued the output stays low, so a stream ends low.
+The bit rate is 160MHz / (div1 * div2) with dividers up to 63: from about
+40kHz to 80MHz, closest match.
+
+Examples of patterns:
+- WS2812 LEDs at 2.4Mbit/s, 3 bits per data bit: 0 => 100, 1 => 110, then
+  at least 50us low before the next frame.
+- IR carrier at 38kHz, bit rate 76kHz: 10 repeated for marks, 00 for spaces.
+
+i2s_is_empty() tells when everything queued has been sent. Streaming from an
+interrupt is possible with i2s_set_callback(), called whenever a DMA buffer
+is free again. i2s_end() gives the pins back.
+*/
+bool i2s_bitstream_begin(uint32_t bitrate, bool clock_out); // Returns false on OOM error
+uint32_t i2s_bitstream_get_rate(); // The actual bit rate
+// Queues words, returns the amount queued (blocking when DMA is full, except with nb)
+size_t i2s_bitstream_write(const uint32_t *words, size_t count, bool nb);
+// Encodes data MSB first, each data bit becomes the low "bits" (1..32) of zero or one,
+// sent MSB first, the last word is padded with low bits. Blocking, returns the
+// data bytes queued: len, or less if the transmitter was stopped meanwhile.
+size_t i2s_bitstream_write_encoded(const uint8_t *data, size_t len, uint8_t bits, uint32_t zero, uint32_t one);
+
 #ifdef __cplusplus
 }
 #endif
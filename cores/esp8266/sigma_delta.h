@@ -40,6 +40,8 @@ Usage :
 2. sigmaDeltaAttachPin(pin), any pin 0..15, TBC if gpio16 supports sigma-delta source
      This will set the pin to NORMAL output mode (pinMode(pin,OUTPUT))
 3. sigmaDeltaWrite(0,dc) : set the output signal duty cycle, duty cycle = dc/256
+4. startSequence(SIGMA_DELTA_SEQUENCE, ...) (core_esp8266_waveform.h) : step the duty
+     cycle through a table at a fixed rate, from the timer1 interrupt
 
 *******************************************************************************/
 
@@ -0,0 +1,252 @@
+/*
+ task_profiler.cpp - CPU time and latency accounting of the cooperative tasks
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef CORE_TASK_PROFILER
+
+#include <Arduino.h>
+#include "task_profiler.h"
+
+static_assert(TASK_PROFILER_TASKS >= 2 && TASK_PROFILER_TASKS <= 64, "TASK_PROFILER_TASKS must be within 2..64");
+
+#ifndef TASK_PROFILER_CYCLES
+#define TASK_PROFILER_CYCLES() ESP.getCycleCount()
+#endif
+
+#define OTHER_TASK (TASK_PROFILER_TASKS - 1) // tasks that didn't fit
+#define NO_TASK    -1                        // context total only
+
+// A task being run, time of nested tasks and waits is collected in child
+struct task_profiler_frame_t {
+    uint32_t start;
+    uint32_t child;
+    int8_t task;
+    uint8_t context;
+};
+
+static const char _loopName[] PROGMEM = "loop";
+static const char _scheduledName[] PROGMEM = "scheduled";
+static const char _recurrentName[] PROGMEM = "recurrent";
+static const char _yieldName[] PROGMEM = "yield";
+static const char _sysName[] PROGMEM = "sys";
+static const char* const _contextNames[TASK_PROFILER_CONTEXTS] PROGMEM = {
+    _loopName, _scheduledName, _recurrentName, _yieldName, _sysName,
+};
+
+static task_profiler_task_t _tasks[TASK_PROFILER_TASKS];
+static uint32_t _taskCount;
+static task_profiler_task_t _contexts[TASK_PROFILER_CONTEXTS];
+static task_profiler_frame_t _frames[TASK_PROFILER_DEPTH];
+static uint32_t _depth;     // may exceed TASK_PROFILER_DEPTH, deeper tasks are not counted
+static uint32_t _suspended; // cycle count when CONT gave the CPU
+static uint32_t _resumed;   // cycle count when CONT got it back
+static bool _running;       // false until the first resume
+
+static int findTask(uint8_t context, const char *name, uint32_t where)
+{
+    for (uint32_t i = 0; i < _taskCount; i++) {
+        const task_profiler_task_t& t = _tasks[i];
+        if (t.where == where && t.name == name && t.context == context) {
+            return i;
+        }
+    }
+    if (_taskCount < OTHER_TASK) {
+        task_profiler_task_t& t = _tasks[_taskCount];
+        t.name = name;
+        t.where = where;
+        t.context = context;
+        return _taskCount++;
+    }
+    if (_taskCount == OTHER_TASK) {
+        task_profiler_task_t& t = _tasks[OTHER_TASK];
+        t.name = nullptr;
+        t.where = 0;
+        t.context = context;
+        _taskCount++;
+    }
+    return OTHER_TASK;
+}
+
+static inline void charge(task_profiler_task_t& t, uint32_t own, uint32_t total)
+{
+    t.cycles += own;
+    t.calls++;
+    if (total > t.max_cycles) {
+        t.max_cycles = total;
+    }
+}
+
+static inline void lateness(task_profiler_task_t& t, uint32_t latency_us)
+{
+    if (latency_us > t.max_latency) {
+        t.max_latency = latency_us;
+    }
+}
+
+void task_profiler_begin(uint8_t context, const char *name, uint32_t where, uint32_t latency_us)
+{
+    uint32_t depth = _depth++;
+    if (depth >= TASK_PROFILER_DEPTH) {
+        return;
+    }
+    task_profiler_frame_t& f = _frames[depth];
+    f.context = context;
+    f.task = (name || where)? findTask(context, name, where): NO_TASK;
+    f.child = 0;
+    lateness(_contexts[context], latency_us);
+    if (f.task != NO_TASK) {
+        lateness(_tasks[f.task], latency_us);
+    }
+    f.start = TASK_PROFILER_CYCLES();
+}
+
+void task_profiler_end(void)
+{
+    uint32_t now = TASK_PROFILER_CYCLES();
+    if (!_depth || --_depth >= TASK_PROFILER_DEPTH) {
+        return;
+    }
+    const task_profiler_frame_t& f = _frames[_depth];
+    uint32_t total = now - f.start;
+    uint32_t own = total - f.child;
+    charge(_contexts[f.context], own, total);
+    if (f.task != NO_TASK) {
+        charge(_tasks[f.task], own, total);
+    }
+    if (_depth) {
+        _frames[_depth - 1].child += total;
+    }
+}
+
+void task_profiler_suspend(uint8_t context)
+{
+    _suspended = TASK_PROFILER_CYCLES();
+    if (_running) {
+        lateness(_contexts[context], clockCyclesToMicroseconds(_suspended - _resumed));
+    }
+}
+
+void task_profiler_resume(uint8_t context)
+{
+    _resumed = TASK_PROFILER_CYCLES();
+    if (!_running) {
+        // nothing to charge before the first loop()
+        _running = true;
+        return;
+    }
+    uint32_t total = _resumed - _suspended;
+    charge(_contexts[context], total, total);
+    uint32_t depth = _depth < TASK_PROFILER_DEPTH? _depth: TASK_PROFILER_DEPTH;
+    if (depth) {
+        _frames[depth - 1].child += total;
+    }
+}
+
+size_t task_profiler_snapshot(task_profiler_task_t *tasks, size_t max)
+{
+    size_t n = _taskCount < max? _taskCount: max;
+    memcpy(tasks, _tasks, n * sizeof(task_profiler_task_t));
+    return n;
+}
+
+void task_profiler_contexts(task_profiler_task_t *contexts)
+{
+    for (int i = 0; i < TASK_PROFILER_CONTEXTS; i++) {
+        contexts[i] = _contexts[i];
+        contexts[i].name = (const char*)pgm_read_ptr(&_contextNames[i]);
+        contexts[i].context = i;
+    }
+}
+
+void task_profiler_reset(void)
+{
+    for (uint32_t i = 0; i < _taskCount; i++) {
+        task_profiler_task_t& t = _tasks[i];
+        t.calls = t.max_cycles = t.max_latency = 0;
+        t.cycles = 0;
+    }
+    memset(_contexts, 0, sizeof(_contexts));
+}
+
+TaskProfilerScope::TaskProfilerScope(const char* name)
+{
+    uint8_t context = TASK_PROFILER_LOOP;
+    if (_depth && _depth <= TASK_PROFILER_DEPTH) {
+        context = _frames[_depth - 1].context;
+    }
+    task_profiler_begin(context, name, 0, 0);
+}
+
+static size_t printName(Print& out, const char *name, size_t width)
+{
+    size_t n = out.print(FPSTR(name));
+    while (n < width) {
+        n += out.print(' ');
+    }
+    return n;
+}
+
+static size_t printTask(Print& out, const task_profiler_task_t& t)
+{
+    return out.printf_P(PSTR("%8u %9u %8u %8u "), t.calls,
+                        (uint32_t)(t.cycles / microsecondsToClockCycles(1000)),
+                        (uint32_t)clockCyclesToMicroseconds(t.max_cycles), t.max_latency);
+}
+
+size_t task_profiler_report(Print& out)
+{
+    task_profiler_task_t contexts[TASK_PROFILER_CONTEXTS];
+    task_profiler_contexts(contexts);
+    size_t n = out.println(F("   calls    own ms   max us   lat us context   task"));
+    for (const task_profiler_task_t& t : contexts) {
+        n += printTask(out, t);
+        n += printName(out, t.name, 0);
+        n += out.println();
+    }
+
+    // Tasks by decreasing own time
+    uint64_t done = 0;
+    for (;;) {
+        int best = -1;
+        for (uint32_t i = 0; i < _taskCount; i++) {
+            if (!(done & (1ULL << i)) && _tasks[i].calls &&
+                    (best < 0 || _tasks[i].cycles > _tasks[best].cycles)) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        done |= 1ULL << best;
+        const task_profiler_task_t& t = _tasks[best];
+        n += printTask(out, t);
+        n += printName(out, (const char*)pgm_read_ptr(&_contextNames[t.context]), 10);
+        if (t.name) {
+            n += out.print(FPSTR(t.name));
+        } else if (t.where) {
+            n += out.printf_P(PSTR("0x%08x"), t.where);
+        } else {
+            n += out.print(F("other"));
+        }
+        n += out.println();
+    }
+    return n;
+}
+
+#endif // CORE_TASK_PROFILER
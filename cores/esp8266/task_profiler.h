@@ -0,0 +1,138 @@
+/*
+ task_profiler.h - CPU time and latency accounting of the cooperative tasks
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef TASK_PROFILER_H
+#define TASK_PROFILER_H
+
+/*
+ * Built with -DCORE_TASK_PROFILER, the core counts the CPU cycles spent in
+ * setup() and loop(), in every scheduled and recurrent function, and the
+ * time the sketch leaves to the SDK, either while waiting in yield() or
+ * delay(), or between two loop() calls.
+ *
+ * Each context keeps a total, and tasks are tracked individually in a
+ * table of TASK_PROFILER_TASKS entries: scheduled and recurrent functions
+ * by the caller's PC of schedule_*function() (the function itself for
+ * schedule_isr_function()), to be symbolised offline with
+ *   xtensa-lx106-elf-addr2line -pfiaC -e sketch.elf 0x4020xxxx
+ * and sketch code by name, with TaskProfilerScope. Tasks that don't fit are
+ * merged into the last entry.
+ *
+ * Time is exclusive: a task is not charged for the tasks it runs nor for
+ * the time it spends waiting in yield(), so that the totals of all
+ * contexts add up to the elapsed time. Everything runs on the CONT stack,
+ * the profiler takes no lock.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef TASK_PROFILER_TASKS
+#define TASK_PROFILER_TASKS 32
+#endif
+
+#ifndef TASK_PROFILER_DEPTH
+#define TASK_PROFILER_DEPTH 8
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    TASK_PROFILER_LOOP,       // setup() and loop()
+    TASK_PROFILER_SCHEDULED,  // schedule_function(), schedule_isr_function()
+    TASK_PROFILER_RECURRENT,  // schedule_recurrent_function_us()
+    TASK_PROFILER_YIELD,      // CONT waiting in yield() / delay()
+    TASK_PROFILER_SYS,        // between two loop() calls
+    TASK_PROFILER_CONTEXTS
+} task_profiler_context_t;
+
+typedef struct {
+    const char *name;     // PROGMEM name, or NULL when where is a PC
+    uint32_t where;       // function or caller PC
+    uint32_t calls;       // since reset
+    uint32_t max_cycles;  // longest call, nested tasks and waits included
+    uint32_t max_latency; // us, see below
+    uint64_t cycles;      // own time since reset
+    uint8_t context;      // task_profiler_context_t
+} task_profiler_task_t;
+
+/*
+ * max_latency is, for scheduled functions, the longest time between
+ * scheduling and running, and for recurrent functions the longest delay
+ * past their deadline. In the YIELD and SYS totals, it is the longest time
+ * the sketch kept the CPU before giving it back that way: what the software
+ * watchdog watches.
+ */
+
+// Called by the core, on the CONT stack only
+void task_profiler_begin(uint8_t context, const char *name, uint32_t where, uint32_t latency_us);
+void task_profiler_end(void);
+// CONT gives the CPU to the SDK (context: YIELD or SYS) and gets it back
+void task_profiler_suspend(uint8_t context);
+void task_profiler_resume(uint8_t context);
+
+// Copies up to max tasks in table order, returns the count
+size_t task_profiler_snapshot(task_profiler_task_t *tasks, size_t max);
+// Copies the TASK_PROFILER_CONTEXTS totals, name is the context name
+void task_profiler_contexts(task_profiler_task_t *contexts);
+// Restarts all counts
+void task_profiler_reset(void);
+
+#ifdef __cplusplus
+}
+
+class Print;
+
+// Text report, contexts then tasks by decreasing own time
+size_t task_profiler_report(Print& out);
+
+// Charges the enclosing scope to a named task, in the current context:
+//   void loop() {
+//       TaskProfilerScope p(PSTR("mqtt"));
+//       ...
+class TaskProfilerScope
+{
+public:
+#ifdef CORE_TASK_PROFILER
+    TaskProfilerScope (const char* name);
+    ~TaskProfilerScope () { task_profiler_end(); }
+#else
+    TaskProfilerScope (const char* name) { (void)name; }
+#endif
+    TaskProfilerScope (const TaskProfilerScope&) = delete;
+    TaskProfilerScope& operator= (const TaskProfilerScope&) = delete;
+};
+#endif
+
+#ifdef CORE_TASK_PROFILER
+#define TASK_PROFILER__BEGIN(c, n, w, l) task_profiler_begin(c, n, w, l)
+#define TASK_PROFILER__END()             task_profiler_end()
+#define TASK_PROFILER__SUSPEND(c)        task_profiler_suspend(c)
+#define TASK_PROFILER__RESUME(c)         task_profiler_resume(c)
+#else
+#define TASK_PROFILER__BEGIN(c, n, w, l) do {} while(0)
+#define TASK_PROFILER__END()             do {} while(0)
+#define TASK_PROFILER__SUSPEND(c)        do {} while(0)
+#define TASK_PROFILER__RESUME(c)         do {} while(0)
+#endif
+
+#endif // TASK_PROFILER_H
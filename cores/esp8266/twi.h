@@ -56,6 +56,37 @@ void twi_releaseBus(void);
 
 void twi_enableSlaveMode(void);
 
+// Asynchronous master transactions, clocked from the timer1 interrupt (see
+// setTimer1Callback() in core_esp8266_waveform.h) instead of busy loops:
+// START, address + W, wlen bytes from wbuf, then if rlen a repeated START,
+// address + R, rlen bytes into rbuf, and STOP. Only wbuf (or only rbuf) may
+// be used, both empty probes the address.
+// The clock is the one of twi_setClock(), up to 50kHz: the timer can't fire
+// more often than every 10us, one interrupt per SCL edge.
+// Transactions run in queue order, synchronous calls wait for the queue to
+// be empty. The transaction and its buffers belong to the queue until the
+// callback, which is run from loop context with status set to the
+// twi_writeTo() result codes, or TWI_ASYNC_TIMEOUT on clock stretch timeout.
+#define TWI_ASYNC_TIMEOUT 5
+#define TWI_ASYNC_PENDING 0xff
+
+typedef struct twi_async_s {
+    uint8_t address;
+    const uint8_t* wbuf;
+    size_t wlen;
+    uint8_t* rbuf;
+    size_t rlen;
+    void (*callback)(struct twi_async_s* t); // may be NULL
+    void* arg;                               // for the callback
+    volatile uint8_t status;                 // TWI_ASYNC_PENDING until done
+    struct twi_async_s* next;                // queue, internal
+} twi_async_t;
+
+// false if t is already queued, or if the timer1 callback is set by
+// something else while the queue is empty
+bool twi_queue(twi_async_t* t);
+size_t twi_queued(void);        // transactions not completed
+
 #ifdef __cplusplus
 }
 #endif
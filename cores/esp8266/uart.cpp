@@ -79,6 +79,7 @@ extern "C" {
 
 static int s_uart_debug_nr = UART0;
 
+// size is a power of 2, positions are masked with size - 1
 struct uart_rx_buffer_
 {
     size_t size;
@@ -87,6 +88,15 @@ struct uart_rx_buffer_
     uint8_t * buffer;
 };
 
+// Optional, see uart_resize_tx_buffer()
+struct uart_tx_buffer_
+{
+    size_t size;
+    size_t rpos;
+    size_t wpos;
+    uint8_t * buffer;
+};
+
 struct uart_
 {
     int uart_nr;
@@ -97,9 +107,17 @@ struct uart_
     bool rx_error;
     uint8_t rx_pin;
     uint8_t tx_pin;
+    uint8_t rx_fifo_full;   // UCFFT
+    uint8_t rx_timeout;     // UCTOT, 0: disabled
     struct uart_rx_buffer_ * rx_buffer;
+    struct uart_tx_buffer_ * tx_buffer;
+    uart_rx_stats_t rx_stats;
 };
 
+// Both UARTs share one interrupt, uart_isr() serves the ones registered here:
+// UART0 when receiving, and any UART with a TX buffer
+static uart_t* s_uarts[2] = { NULL, NULL };
+
 
 /*
    In the context of the naming conventions in this file, "_unsafe" means two things:
@@ -121,17 +139,33 @@ uart_rx_fifo_available(const int uart_nr)
     return (USS(uart_nr) >> USRXC) & 0xFF;
 }
 
+/*
+  Reference for uart_tx_fifo_available() and uart_tx_fifo_full():
+  -Espressif Techinical Reference doc, chapter 11.3.7
+  -tools/sdk/uart_register.h
+  -cores/esp8266/esp8266_peri.h
+  */
+// called by ISR
+inline size_t ICACHE_RAM_ATTR
+uart_tx_fifo_available(const int uart_nr)
+{
+    return (USS(uart_nr) >> USTXC) & 0xff;
+}
+
+inline bool ICACHE_RAM_ATTR
+uart_tx_fifo_full(const int uart_nr)
+{
+    return uart_tx_fifo_available(uart_nr) >= 0x7f;
+}
+
 
 /**********************************************************/
 /************ UNSAFE FUNCTIONS ****************************/
 /**********************************************************/
-inline size_t
+inline size_t ICACHE_RAM_ATTR
 uart_rx_buffer_available_unsafe(const struct uart_rx_buffer_ * rx_buffer)
 {
-    if(rx_buffer->wpos < rx_buffer->rpos)
-      return (rx_buffer->wpos + rx_buffer->size) - rx_buffer->rpos;
-
-    return rx_buffer->wpos - rx_buffer->rpos;
+    return (rx_buffer->wpos - rx_buffer->rpos) & (rx_buffer->size - 1);
 }
 
 inline size_t
@@ -142,41 +176,61 @@ uart_rx_available_unsafe(uart_t* uart)
 
 //#define UART_DISCARD_NEWEST
 
-// Copy all the rx fifo bytes that fit into the rx buffer
+// Copy all the rx fifo bytes into the rx buffer, in bursts: the fifo count
+// is read once per burst, and bytes arriving meanwhile make another one
 // called by ISR
 inline void ICACHE_RAM_ATTR
 uart_rx_copy_fifo_to_buffer_unsafe(uart_t* uart)
 {
     struct uart_rx_buffer_ *rx_buffer = uart->rx_buffer;
+    uint8_t * const buffer = rx_buffer->buffer;
+    const int uart_nr = uart->uart_nr;
+    const size_t mask = rx_buffer->size - 1;
+    size_t wpos = rx_buffer->wpos;
+    size_t rpos = rx_buffer->rpos;
+    size_t received = 0;
+    size_t count;
 
-    while(uart_rx_fifo_available(uart->uart_nr))
+    while((count = uart_rx_fifo_available(uart_nr)) != 0)
     {
-        size_t nextPos = (rx_buffer->wpos + 1) % rx_buffer->size;
-        if(nextPos == rx_buffer->rpos)
+        received += count;
+
+        // what fits, one byte is kept free
+        size_t room = (rpos - wpos - 1) & mask;
+        size_t chunk = count < room? count: room;
+        for (count -= chunk; chunk; chunk--)
         {
-            if (!uart->rx_overrun)
-            {
-                uart->rx_overrun = true;
-                //os_printf_plus(overrun_str);
-            }
+            buffer[wpos] = USF(uart_nr);
+            wpos = (wpos + 1) & mask;
+        }
+        if(!count)
+            continue;
 
-            // a choice has to be made here,
-            // do we discard newest or oldest data?
+        uart->rx_overrun = true;
+        uart->rx_stats.dropped += count;
+        // a choice has to be made here,
+        // do we discard newest or oldest data?
 #ifdef UART_DISCARD_NEWEST
-            // discard newest data
-            // Stop copying if rx buffer is full
-            USF(uart->uart_nr);
-            break;
+        // discard newest data
+        while(count--)
+            USF(uart_nr);
 #else
-            // discard oldest data
-            if (++rx_buffer->rpos == rx_buffer->size)
-                rx_buffer->rpos = 0;
-#endif
+        // discard oldest data
+        for (; count; count--)
+        {
+            rpos = (rpos + 1) & mask;
+            buffer[wpos] = USF(uart_nr);
+            wpos = (wpos + 1) & mask;
         }
-        uint8_t data = USF(uart->uart_nr);
-        rx_buffer->buffer[rx_buffer->wpos] = data;
-        rx_buffer->wpos = nextPos;
+#endif
     }
+
+    rx_buffer->wpos = wpos;
+    rx_buffer->rpos = rpos;
+    uart->rx_stats.received += received;
+    size_t used = (wpos - rpos) & mask;
+    if(used > uart->rx_stats.peak)
+        uart->rx_stats.peak = used;
 }
 
 inline int
@@ -201,13 +255,80 @@ uart_read_char_unsafe(uart_t* uart)
     {
         // take oldest sw data
         int ret = uart->rx_buffer->buffer[uart->rx_buffer->rpos];
-        uart->rx_buffer->rpos = (uart->rx_buffer->rpos + 1) % uart->rx_buffer->size;
+        uart->rx_buffer->rpos = (uart->rx_buffer->rpos + 1) & (uart->rx_buffer->size - 1);
         return ret;
     }
     // unavailable
     return -1;
 }
 
+inline size_t
+uart_tx_buffer_used_unsafe(const struct uart_tx_buffer_ * tx_buffer)
+{
+    if(tx_buffer->wpos < tx_buffer->rpos)
+      return (tx_buffer->wpos + tx_buffer->size) - tx_buffer->rpos;
+
+    return tx_buffer->wpos - tx_buffer->rpos;
+}
+
+// Move the buffered bytes that fit into the tx fifo, and stop the tx fifo
+// empty interrupt once the buffer is empty
+// called by ISR
+static void ICACHE_RAM_ATTR
+uart_tx_copy_buffer_to_fifo_unsafe(uart_t* uart)
+{
+    struct uart_tx_buffer_ *tx_buffer = uart->tx_buffer;
+    const int uart_nr = uart->uart_nr;
+    const size_t wpos = tx_buffer->wpos;
+    size_t rpos = tx_buffer->rpos;
+
+    for (size_t room = 0x7f - uart_tx_fifo_available(uart_nr); room && rpos != wpos; room--)
+    {
+        USF(uart_nr) = tx_buffer->buffer[rpos];
+        if (++rpos == tx_buffer->size)
+            rpos = 0;
+    }
+    tx_buffer->rpos = rpos;
+
+    if (rpos == wpos)
+        USIE(uart_nr) &= ~(1 << UIFE);
+}
+
+// Queue what fits, straight into the tx fifo while nothing is buffered
+// (buf may be in flash). Returns the number of bytes taken.
+static size_t
+uart_tx_queue_unsafe(uart_t* uart, const char* buf, size_t size)
+{
+    struct uart_tx_buffer_ *tx_buffer = uart->tx_buffer;
+    const int uart_nr = uart->uart_nr;
+    size_t ret = 0;
+
+    if (tx_buffer->rpos == tx_buffer->wpos)
+        while (ret < size && !uart_tx_fifo_full(uart_nr))
+            USF(uart_nr) = pgm_read_byte(buf + ret++);
+
+    while (ret < size)
+    {
+        // get largest linear room in sw buffer, one byte is kept free
+        size_t rpos = tx_buffer->rpos;
+        size_t wpos = tx_buffer->wpos;
+        size_t chunk = wpos < rpos?
+                           rpos - wpos - 1:
+                           tx_buffer->size - wpos - (rpos == 0);
+        if (chunk == 0)
+            break;
+        if (chunk > size - ret)
+            chunk = size - ret;
+        memcpy_P(tx_buffer->buffer + wpos, buf + ret, chunk);
+        tx_buffer->wpos = (wpos + chunk) % tx_buffer->size;
+        ret += chunk;
+    }
+
+    if (tx_buffer->rpos != tx_buffer->wpos)
+        USIE(uart_nr) |= (1 << UIFE);
+    return ret;
+}
+
 uint8_t
 uart_get_bit_length(const int uart_nr)
 {
@@ -262,8 +383,10 @@ uart_read(uart_t* uart, char* userbuffer, size_t usersize)
         if (!uart_rx_buffer_available_unsafe(uart->rx_buffer))
         {
             // no more data in sw buffer, take them from hw fifo
+            size_t direct = ret;
             while (ret < usersize && uart_rx_fifo_available(uart->uart_nr))
                 userbuffer[ret++] = USF(uart->uart_nr);
+            uart->rx_stats.received += ret - direct;
 
 	    // no more sw/hw data available
             break;
@@ -277,7 +400,7 @@ uart_read(uart_t* uart, char* userbuffer, size_t usersize)
         if (ret + chunk > usersize)
             chunk = usersize - ret;
         memcpy(userbuffer + ret, uart->rx_buffer->buffer + uart->rx_buffer->rpos, chunk);
-        uart->rx_buffer->rpos = (uart->rx_buffer->rpos + chunk) % uart->rx_buffer->size;
+        uart->rx_buffer->rpos = (uart->rx_buffer->rpos + chunk) & (uart->rx_buffer->size - 1);
         ret += chunk;
     }
 
@@ -299,11 +422,14 @@ static void ICACHE_RAM_ATTR uart_isr_handle_data(void* arg, uint8_t data)
 // Copy all the rx fifo bytes that fit into the rx buffer
 // called by ISR
     struct uart_rx_buffer_ *rx_buffer = uart->rx_buffer;
+    const size_t mask = rx_buffer->size - 1;
 
-    size_t nextPos = (rx_buffer->wpos + 1) % rx_buffer->size;
+    uart->rx_stats.received++;
+    size_t nextPos = (rx_buffer->wpos + 1) & mask;
     if(nextPos == rx_buffer->rpos)
     {
         uart->rx_overrun = true;
+        uart->rx_stats.dropped++;
         //os_printf_plus(overrun_str);
 
         // a choice has to be made here,
@@ -314,31 +440,50 @@ static void ICACHE_RAM_ATTR uart_isr_handle_data(void* arg, uint8_t data)
         return;
 #else
         // discard oldest data
-        if (++rx_buffer->rpos == rx_buffer->size)
-            rx_buffer->rpos = 0;
+        rx_buffer->rpos = (rx_buffer->rpos + 1) & mask;
 #endif
     }
     rx_buffer->buffer[rx_buffer->wpos] = data;
     rx_buffer->wpos = nextPos;
+    size_t used = (nextPos - rx_buffer->rpos) & mask;
+    if(used > uart->rx_stats.peak)
+        uart->rx_stats.peak = used;
 
     // Check the UART flags and note hardware overflow/etc.
     uint32_t usis = USIS(uart->uart_nr);
 
     if(usis & (1 << UIOF))
+    {
         uart->rx_overrun = true;
+        uart->rx_stats.fifo_overflows++;
+    }
 
-    if (usis & ((1 << UIFR) | (1 << UIPE) | (1 << UITO)))
+    if (usis & ((1 << UIFR) | (1 << UIPE)))
+    {
         uart->rx_error = true;
+        uart->rx_stats.errors++;
+    }
 
     USIC(uart->uart_nr) = usis;
 }
 
+// The rx ring is indexed with a mask
+static size_t
+uart_rx_buffer_size(size_t size)
+{
+    size_t pow2 = 2;
+    while(pow2 < size)
+        pow2 <<= 1;
+    return pow2;
+}
+
 size_t
 uart_resize_rx_buffer(uart_t* uart, size_t new_size)
 {
     if(uart == NULL || !uart->rx_enabled)
         return 0;
 
+    new_size = uart_rx_buffer_size(new_size);
     if(uart->rx_buffer->size == new_size)
         return uart->rx_buffer->size;
 
@@ -348,10 +493,9 @@ uart_resize_rx_buffer(uart_t* uart, size_t new_size)
 
     size_t new_wpos = 0;
     ETS_UART_INTR_DISABLE();
-    while(uart_rx_available_unsafe(uart) && new_wpos < new_size)
-        new_buf[new_wpos++] = uart_read_char_unsafe(uart); //if uart_rx_available_unsafe() returns non-0, uart_read_char_unsafe() can't return -1
-    if (new_wpos == new_size)
-        new_wpos = 0;
+    uart_rx_copy_fifo_to_buffer_unsafe(uart);
+    while(uart_rx_buffer_available_unsafe(uart->rx_buffer) && new_wpos < new_size - 1)
+        new_buf[new_wpos++] = uart_read_char_unsafe(uart); //if uart_rx_buffer_available_unsafe() returns non-0, uart_read_char_unsafe() can't return -1
 
     uint8_t * old_buf = uart->rx_buffer->buffer;
     uart->rx_buffer->rpos = 0;
@@ -369,33 +513,122 @@ uart_get_rx_buffer_size(uart_t* uart)
     return uart && uart->rx_enabled? uart->rx_buffer->size: 0;
 }
 
+bool
+uart_get_rx_stats(uart_t* uart, uart_rx_stats_t* stats)
+{
+    if(uart == NULL || !uart->rx_enabled)
+        return false;
+
+    ETS_UART_INTR_DISABLE();
+    *stats = uart->rx_stats;
+    ETS_UART_INTR_ENABLE();
+    return true;
+}
+
+void
+uart_reset_rx_stats(uart_t* uart)
+{
+    if(uart == NULL || !uart->rx_enabled)
+        return;
+
+    ETS_UART_INTR_DISABLE();
+    memset(&uart->rx_stats, 0, sizeof(uart->rx_stats));
+    ETS_UART_INTR_ENABLE();
+}
+
 // The default ISR handler called when GDB is not enabled
 void ICACHE_RAM_ATTR
 uart_isr(void * arg)
 {
-    uart_t* uart = (uart_t*)arg;
-    uint32_t usis = USIS(uart->uart_nr);
+    (void) arg;
 
-    if(uart == NULL || !uart->rx_enabled)
+    for (int uart_nr = UART0; uart_nr <= UART1; uart_nr++)
     {
-        USIC(uart->uart_nr) = usis;
-        ETS_UART_INTR_DISABLE();
-        return;
-    }
+        uint32_t usis = USIS(uart_nr);
+        if(!usis)
+            continue;
 
-    if(usis & (1 << UIFF))
-        uart_rx_copy_fifo_to_buffer_unsafe(uart);
+        uart_t* uart = s_uarts[uart_nr];
+        if(uart == NULL)
+        {
+            USIE(uart_nr) = 0;
+            USIC(uart_nr) = usis;
+            continue;
+        }
 
-    if(usis & (1 << UIOF))
-    {
-        uart->rx_overrun = true;
-        //os_printf_plus(overrun_str);
+        if(uart->rx_enabled)
+        {
+            const uint32_t start = esp_get_cycle_count();
+
+            if(usis & ((1 << UIFF) | (1 << UITO)))
+                uart_rx_copy_fifo_to_buffer_unsafe(uart);
+
+            if(usis & (1 << UIOF))
+            {
+                uart->rx_overrun = true;
+                uart->rx_stats.fifo_overflows++;
+                //os_printf_plus(overrun_str);
+            }
+
+            if (usis & ((1 << UIFR) | (1 << UIPE)))
+            {
+                uart->rx_error = true;
+                uart->rx_stats.errors++;
+            }
+
+            const uint32_t cycles = esp_get_cycle_count() - start;
+            uart->rx_stats.isr_calls++;
+            uart->rx_stats.isr_cycles += cycles;
+            if(cycles > uart->rx_stats.isr_max_cycles)
+                uart->rx_stats.isr_max_cycles = cycles;
+        }
+
+        if((usis & (1 << UIFE)) && uart->tx_buffer)
+            uart_tx_copy_buffer_to_fifo_unsafe(uart);
+
+        USIC(uart_nr) = usis;
     }
+}
 
-    if (usis & ((1 << UIFR) | (1 << UIPE) | (1 << UITO)))
-        uart->rx_error = true;
+static void
+uart_isr_register(uart_t* uart)
+{
+    ETS_UART_INTR_DISABLE();
+    s_uarts[uart->uart_nr] = uart;
+    ETS_UART_INTR_ATTACH(uart_isr, NULL);
+    ETS_UART_INTR_ENABLE();
+}
 
-    USIC(uart->uart_nr) = usis;
+static void
+uart_isr_unregister(uart_t* uart)
+{
+    if(s_uarts[uart->uart_nr] != uart)
+        return;
+
+    ETS_UART_INTR_DISABLE();
+    USC1(uart->uart_nr) = 0;
+    USIC(uart->uart_nr) = 0xffff;
+    USIE(uart->uart_nr) = 0;
+    s_uarts[uart->uart_nr] = NULL;
+    if(s_uarts[UART0] || s_uarts[UART1])
+        ETS_UART_INTR_ENABLE();
+    else
+        ETS_UART_INTR_ATTACH(NULL, NULL);
+}
+
+// TX fifo empty interrupt threshold: the buffer is drained into the fifo
+// when fewer bytes are left to send, 32 bytes are 2.8ms at 115200 bauds
+#define TXTRIGG 32
+
+#define INTRIGG 16
+
+static uint32_t
+uart_rx_usc1(const uart_t* uart)
+{
+    uint32_t usc1 = (uart->rx_fifo_full << UCFFT) | (TXTRIGG << UCFET);
+    if(uart->rx_timeout)
+        usc1 |= (uart->rx_timeout << UCTOT) | (1 << UCTOE);
+    return usc1;
 }
 
 static void
@@ -417,10 +650,10 @@ uart_start_isr(uart_t* uart)
     // - 4..120 give > 2300Kibits/s
     // - 1, 2, 3 are below
     // was 100, use 16 to stay away from overrun
-    #define INTRIGG 16
+    // (default of uart->rx_fifo_full, see uart_set_rx_thresholds())
 
     //was:USC1(uart->uart_nr) = (INTRIGG << UCFFT) | (0x02 << UCTOT) | (1 <<UCTOE);
-    USC1(uart->uart_nr) = (INTRIGG << UCFFT);
+    USC1(uart->uart_nr) = uart_rx_usc1(uart);
     USIC(uart->uart_nr) = 0xffff;
     //was: USIE(uart->uart_nr) = (1 << UIFF) | (1 << UIFR) | (1 << UITO);
     // UIFF: rx fifo full
@@ -429,47 +662,106 @@ uart_start_isr(uart_t* uart)
     // UIPE: parity error
     // UITO: rx fifo timeout
     USIE(uart->uart_nr) = (1 << UIFF) | (1 << UIOF) | (1 << UIFR) | (1 << UIPE) | (1 << UITO);
-    ETS_UART_INTR_ATTACH(uart_isr,  (void *)uart);
-    ETS_UART_INTR_ENABLE();
+    uart_isr_register(uart);
+}
+
+void
+uart_set_rx_thresholds(uart_t* uart, uint8_t fifo_full, uint8_t timeout)
+{
+    if(uart == NULL || !uart->rx_enabled)
+        return;
+
+    uart->rx_fifo_full = fifo_full < 1? 1: fifo_full > 127? 127: fifo_full;
+    uart->rx_timeout = timeout > 127? 127: timeout;
+    // GDB sets up the fifo itself
+    if(s_uarts[uart->uart_nr] == uart)
+        USC1(uart->uart_nr) = uart_rx_usc1(uart);
 }
 
 static void
 uart_stop_isr(uart_t* uart)
 {
-    if(uart == NULL || !uart->rx_enabled)
+    if(uart == NULL)
         return;
 
     if(gdbstub_has_uart_isr_control()) {
-        gdbstub_set_uart_isr_callback(NULL, NULL);
+        if(uart->rx_enabled)
+            gdbstub_set_uart_isr_callback(NULL, NULL);
         return;
     }
 
-    ETS_UART_INTR_DISABLE();
-    USC1(uart->uart_nr) = 0;
-    USIC(uart->uart_nr) = 0xffff;
-    USIE(uart->uart_nr) = 0;
-    ETS_UART_INTR_ATTACH(NULL, NULL);
+    uart_isr_unregister(uart);
 }
 
-/*
-  Reference for uart_tx_fifo_available() and uart_tx_fifo_full():
-  -Espressif Techinical Reference doc, chapter 11.3.7
-  -tools/sdk/uart_register.h
-  -cores/esp8266/esp8266_peri.h
-  */
-inline size_t
-uart_tx_fifo_available(const int uart_nr)
+size_t
+uart_resize_tx_buffer(uart_t* uart, size_t new_size)
 {
-    return (USS(uart_nr) >> USTXC) & 0xff;
+    // the interrupt belongs to GDB when it is enabled
+    if(uart == NULL || !uart->tx_enabled || gdbstub_has_uart_isr_control())
+        return 0;
+
+    if(new_size == 1)
+        new_size = 0;
+    size_t old_size = uart->tx_buffer? uart->tx_buffer->size: 0;
+    if(old_size == new_size)
+        return old_size;
+
+    struct uart_tx_buffer_ * new_buffer = NULL;
+    if(new_size)
+    {
+        new_buffer = (struct uart_tx_buffer_ *)malloc(sizeof(struct uart_tx_buffer_));
+        if(new_buffer == NULL)
+            return old_size;
+        new_buffer->size = new_size;
+        new_buffer->rpos = 0;
+        new_buffer->wpos = 0;
+        new_buffer->buffer = (uint8_t *)malloc(new_size);
+        if(new_buffer->buffer == NULL)
+        {
+            free(new_buffer);
+            return old_size;
+        }
+    }
+
+    // what is buffered goes out first
+    struct uart_tx_buffer_ * old_buffer = uart->tx_buffer;
+    if(old_buffer)
+    {
+        for (;;)
+        {
+            ETS_UART_INTR_DISABLE();
+            uart_tx_copy_buffer_to_fifo_unsafe(uart);
+            if(old_buffer->rpos == old_buffer->wpos)
+                break;
+            ETS_UART_INTR_ENABLE();
+        }
+        uart->tx_buffer = new_buffer;
+        ETS_UART_INTR_ENABLE();
+        free(old_buffer->buffer);
+        free(old_buffer);
+    }
+    else
+        uart->tx_buffer = new_buffer;
+
+    if(new_buffer && !s_uarts[uart->uart_nr])
+    {
+        USC1(uart->uart_nr) = (TXTRIGG << UCFET);
+        USIC(uart->uart_nr) = 0xffff;
+        USIE(uart->uart_nr) = 0;
+        uart_isr_register(uart);
+    }
+    else if(!new_buffer && !uart->rx_enabled)
+        uart_isr_unregister(uart);
+
+    return new_size;
 }
 
-inline bool
-uart_tx_fifo_full(const int uart_nr)
+size_t
+uart_get_tx_buffer_size(uart_t* uart)
 {
-    return uart_tx_fifo_available(uart_nr) >= 0x7f;
+    return uart && uart->tx_buffer? uart->tx_buffer->size: 0;
 }
 
-
 static void
 uart_do_write_char(const int uart_nr, char c)
 {
@@ -478,6 +770,33 @@ uart_do_write_char(const int uart_nr, char c)
     USF(uart_nr) = c;
 }
 
+// Yielding is only possible from CONT with interrupts enabled. PS.INTLEVEL
+// is also raised by noInterrupts() and in ISRs
+#ifndef UART_TX_CAN_YIELD
+#define UART_TX_CAN_YIELD() (!ETS_INTR_WITHINISR())
+#endif
+
+// Waits for room in the tx buffer by feeding the fifo itself, in case
+// interrupts are disabled. From CONT, the sketch can still yield after 10ms,
+// otherwise this only spins on the fifo.
+static size_t
+uart_buffered_write(uart_t* uart, const char* buf, size_t size)
+{
+    size_t ret = 0;
+    for (;;)
+    {
+        ETS_UART_INTR_DISABLE();
+        ret += uart_tx_queue_unsafe(uart, buf + ret, size - ret);
+        if(ret < size)
+            uart_tx_copy_buffer_to_fifo_unsafe(uart);
+        ETS_UART_INTR_ENABLE();
+        if(ret == size)
+            return ret;
+        if(UART_TX_CAN_YIELD())
+            optimistic_yield(10000);
+    }
+}
+
 size_t
 uart_write_char(uart_t* uart, char c)
 {
@@ -488,6 +807,8 @@ uart_write_char(uart_t* uart, char c)
         gdbstub_write_char(c);
         return 1;
     }
+    if(uart->tx_buffer)
+        return uart_buffered_write(uart, &c, 1);
     uart_do_write_char(uart->uart_nr, c);
     return 1;
 }
@@ -503,6 +824,9 @@ uart_write(uart_t* uart, const char* buf, size_t size)
         return 0;
     }
 
+    if(uart->tx_buffer)
+        return uart_buffered_write(uart, buf, size);
+
     size_t ret = size;
     const int uart_nr = uart->uart_nr;
     while (size--)
@@ -518,6 +842,17 @@ uart_tx_free(uart_t* uart)
     if(uart == NULL || !uart->tx_enabled)
         return 0;
 
+    if(uart->tx_buffer)
+    {
+        // what uart_write() takes without waiting: the fifo is only
+        // written directly once the buffer is empty
+        ETS_UART_INTR_DISABLE();
+        size_t used = uart_tx_buffer_used_unsafe(uart->tx_buffer);
+        size_t fifo = used? 0: 0x7f - uart_tx_fifo_available(uart->uart_nr);
+        ETS_UART_INTR_ENABLE();
+        return fifo + uart->tx_buffer->size - 1 - used;
+    }
+
     return UART_TX_FIFO_SIZE - uart_tx_fifo_available(uart->uart_nr);
 }
 
@@ -527,6 +862,20 @@ uart_wait_tx_empty(uart_t* uart)
     if(uart == NULL || !uart->tx_enabled)
         return;
 
+    if(uart->tx_buffer)
+    {
+        for (;;)
+        {
+            ETS_UART_INTR_DISABLE();
+            uart_tx_copy_buffer_to_fifo_unsafe(uart);
+            bool empty = uart->tx_buffer->rpos == uart->tx_buffer->wpos;
+            ETS_UART_INTR_ENABLE();
+            if(empty)
+                break;
+            delay(0);
+        }
+    }
+
     while(uart_tx_fifo_available(uart->uart_nr) > 0)
         delay(0);
 
@@ -549,7 +898,17 @@ uart_flush(uart_t* uart)
     }
 
     if(uart->tx_enabled)
+    {
         tmp |= (1 << UCTXRST);
+        if(uart->tx_buffer)
+        {
+            ETS_UART_INTR_DISABLE();
+            uart->tx_buffer->rpos = 0;
+            uart->tx_buffer->wpos = 0;
+            USIE(uart->uart_nr) &= ~(1 << UIFE);
+            ETS_UART_INTR_ENABLE();
+        }
+    }
 
     if(!gdbstub_has_uart_isr_control() || uart->uart_nr != UART0) {
         USC0(uart->uart_nr) |= (tmp);
@@ -586,13 +945,20 @@ uart_init(int uart_nr, int baudrate, int config, int mode, int tx_pin, size_t rx
     uart->uart_nr = uart_nr;
     uart->rx_overrun = false;
     uart->rx_error = false;
+    uart->rx_fifo_full = INTRIGG;
+    uart->rx_timeout = 0;
+    uart->tx_buffer = NULL;
+    memset(&uart->rx_stats, 0, sizeof(uart->rx_stats));
 
     switch(uart->uart_nr)
     {
     case UART0:
         ETS_UART_INTR_DISABLE();
         if(!gdbstub_has_uart_isr_control()) {
-            ETS_UART_INTR_ATTACH(NULL, NULL);
+            s_uarts[UART0] = NULL;
+            // keep serving UART1's tx buffer
+            if(!s_uarts[UART1])
+                ETS_UART_INTR_ATTACH(NULL, NULL);
         }
         uart->rx_enabled = (mode != UART_TX_ONLY);
         uart->tx_enabled = (mode != UART_RX_ONLY);
@@ -605,7 +971,7 @@ uart_init(int uart_nr, int baudrate, int config, int mode, int tx_pin, size_t rx
               free(uart);
               return NULL;
             }
-            rx_buffer->size = rx_size;//var this
+            rx_buffer->size = uart_rx_buffer_size(rx_size);
             rx_buffer->rpos = 0;
             rx_buffer->wpos = 0;
             rx_buffer->buffer = (uint8_t *)malloc(rx_buffer->size);
@@ -673,7 +1039,7 @@ uart_init(int uart_nr, int baudrate, int config, int mode, int tx_pin, size_t rx
         if(uart->rx_enabled) {
             uart_start_isr(uart);
         }
-        if(gdbstub_has_uart_isr_control()) {
+        if(gdbstub_has_uart_isr_control() || s_uarts[UART1]) {
             ETS_UART_INTR_ENABLE(); // Undo the disable in the switch() above
         }
     }
@@ -704,6 +1070,11 @@ uart_uninit(uart_t* uart)
         }
     }
 
+    if(uart->tx_buffer) {
+        free(uart->tx_buffer->buffer);
+        free(uart->tx_buffer);
+    }
+
     if(uart->rx_enabled) {
         free(uart->rx_buffer->buffer);
         free(uart->rx_buffer);
@@ -898,16 +1269,23 @@ uart_write_char_delay(const int uart_nr, char c)
 
 }
 
+// The debug output stays in order with what is already buffered
 static void
 uart0_write_char(char c)
 {
-    uart_write_char_delay(0, c);
+    if(s_uarts[UART0] && s_uarts[UART0]->tx_buffer)
+        uart_write_char(s_uarts[UART0], c);
+    else
+        uart_write_char_delay(0, c);
 }
 
 static void
 uart1_write_char(char c)
 {
-    uart_write_char_delay(1, c);
+    if(s_uarts[UART1] && s_uarts[UART1]->tx_buffer)
+        uart_write_char(s_uarts[UART1], c);
+    else
+        uart_write_char_delay(1, c);
 }
 
 void
@@ -20,6 +20,7 @@
 
 */
 #ifndef ESP_UART_H
+#define ESP_UART_H
 
 #include <stdint.h>
 #include <stdbool.h>
@@ -113,6 +114,17 @@ extern "C" {
 struct uart_;
 typedef struct uart_ uart_t;
 
+typedef struct {
+    uint32_t received;       // bytes taken from the rx fifo
+    uint32_t dropped;        // bytes lost because the rx buffer was full
+    uint32_t fifo_overflows; // rx fifo overflows: the ISR came too late
+    uint32_t errors;         // frame and parity errors
+    uint32_t peak;           // highest rx buffer occupancy
+    uint32_t isr_calls;
+    uint32_t isr_max_cycles;
+    uint64_t isr_cycles;
+} uart_rx_stats_t;
+
 uart_t* uart_init(int uart_nr, int baudrate, int config, int mode, int tx_pin, size_t rx_size, bool invert);
 void uart_uninit(uart_t* uart);
 
@@ -127,6 +139,16 @@ int uart_get_baudrate(uart_t* uart);
 
 size_t uart_resize_rx_buffer(uart_t* uart, size_t new_size);
 size_t uart_get_rx_buffer_size(uart_t* uart);
+// The rx ISR runs when fifo_full bytes (1..127, default 16) are received, or,
+// with timeout (1..127, in character times, default 0: disabled), when the
+// line stays idle with bytes in the fifo
+void uart_set_rx_thresholds(uart_t* uart, uint8_t fifo_full, uint8_t timeout);
+bool uart_get_rx_stats(uart_t* uart, uart_rx_stats_t* stats);
+void uart_reset_rx_stats(uart_t* uart);
+// Optional tx buffer drained by interrupt, uart_write() then only waits when
+// it is full. 0 (default) writes straight to the fifo. Not with GDB.
+size_t uart_resize_tx_buffer(uart_t* uart, size_t new_size);
+size_t uart_get_tx_buffer_size(uart_t* uart);
 
 size_t uart_write_char(uart_t* uart, char c);
 size_t uart_write(uart_t* uart, const char* buf, size_t size);
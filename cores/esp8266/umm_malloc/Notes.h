@@ -236,6 +236,21 @@ TODO: provide some interesting numbers on the time to perform:
 
 ===============================================================================
 
+UMM_SIZE_CLASSES - segregated free lists for small allocations.
+With UMM_BEST_FIT every malloc() walks the whole free list with interrupts
+disabled, and the walk gets longer as the heap fragments. Most requests are
+small (String SSO overflow, pbuf headers, std::function captures), so freed
+blocks of up to UMM_SIZE_CLASS_BLOCKS blocks are kept on per-size lists and
+handed out again in constant time. The lists are flushed back into the heap
+when an allocation would fail and before umm_info(). Build with
+UMM_CRITICAL_METRICS to get the hit/miss counts in time_stats.
+
+tests/host `make bench` replays an allocation trace through this allocator
+(bench_umm) and through plain best fit (bench_umm_baseline). Pass recorded
+traces as arguments, see tests/host/core/bench_umm.cpp for the format.
+
+===============================================================================
+
 Enhancement ideas:
   1. Add tagging to heap allocations. Redefine UMM_POISONED_BLOCK_LEN_TYPE,
   expand it to include an element for the calling address of allocating
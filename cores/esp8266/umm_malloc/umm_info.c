@@ -31,6 +31,11 @@ void *umm_info( void *ptr, int force ) {
   /* Protect the critical section... */
   UMM_CRITICAL_ENTRY(id_info);
 
+#ifdef UMM_SIZE_CLASSES
+  /* Report the blocks cached on the size class lists as free */
+  umm_size_class_flush_core();
+#endif
+
   /*
    * Clear out all of the entries in the ummHeapInfo structure before doing
    * any calculations..
@@ -109,6 +109,14 @@ unsigned short int umm_numblocks = 0;
  * -------------------------------------------------------------------------
  */
 
+#ifdef UMM_SIZE_CLASSES
+/* Segregated free lists, emptied by umm_init() */
+static unsigned short int umm_size_class_head[UMM_SIZE_CLASS_BLOCKS + 1];
+static unsigned char umm_size_class_count[UMM_SIZE_CLASS_BLOCKS + 1];
+
+static bool umm_size_class_flush_core( void );
+#endif
+
 #include "umm_integrity.c"
 #include "umm_poison.c"
 #include "umm_info.c"
@@ -219,6 +227,11 @@ void umm_init( void ) {
   umm_heap = (umm_block *)UMM_MALLOC_CFG_HEAP_ADDR;
   umm_numblocks = (UMM_MALLOC_CFG_HEAP_SIZE / sizeof(umm_block));
   memset(umm_heap, 0x00, UMM_MALLOC_CFG_HEAP_SIZE);
+#ifdef UMM_SIZE_CLASSES
+  /* The cached blocks were in the previous heap image */
+  memset(umm_size_class_head, 0x00, sizeof(umm_size_class_head));
+  memset(umm_size_class_count, 0x00, sizeof(umm_size_class_count));
+#endif
 
   /* setup initial blank heap structure */
   {
@@ -335,6 +348,107 @@ static void umm_free_core( void *ptr ) {
   }
 }
 
+/* ------------------------------------------------------------------------
+ * Segregated free lists, see UMM_SIZE_CLASSES in umm_malloc_cfg.h
+ *
+ * A cached block stays marked as used in the heap; the index of the next
+ * block of the same size is kept in its data area (UMM_NFREE). The lists
+ * are indexed by the exact number of blocks.
+ *
+ * Must be called only from within critical sections guarded by
+ * UMM_CRITICAL_ENTRY() and UMM_CRITICAL_EXIT().
+ */
+
+#ifdef UMM_SIZE_CLASSES
+
+#if defined(UMM_CRITICAL_METRICS)
+#define STATS__SIZE_CLASS(what) time_stats.size_class_##what += 1
+#else
+#define STATS__SIZE_CLASS(what) (void)0
+#endif
+
+static bool umm_size_class_put( void *ptr ) {
+  unsigned short int c;
+  unsigned short int blocks;
+
+  c = (((char *)ptr)-(char *)(&(umm_heap[0])))/sizeof(umm_block);
+  blocks = (UMM_NBLOCK(c) & UMM_BLOCKNO_MASK) - c;
+
+  if( blocks > UMM_SIZE_CLASS_BLOCKS || umm_size_class_count[blocks] >= UMM_SIZE_CLASS_DEPTH )
+    return false;
+
+  STATS__FREE_REQUEST(id_free);
+  STATS__FREE_BLOCKS_UPDATE( blocks );
+
+  UMM_NFREE(c) = umm_size_class_head[blocks];
+  umm_size_class_head[blocks] = c;
+  umm_size_class_count[blocks]++;
+
+  return true;
+}
+
+static void *umm_size_class_get( unsigned short int blocks ) {
+  unsigned short int c;
+
+  if( blocks > UMM_SIZE_CLASS_BLOCKS )
+    return NULL;
+
+  c = umm_size_class_head[blocks];
+  if( 0 == c ) {
+    STATS__SIZE_CLASS(misses);
+    return NULL;
+  }
+
+  STATS__SIZE_CLASS(hits);
+  STATS__FREE_BLOCKS_UPDATE( -blocks );
+  STATS__FREE_BLOCKS_MIN();
+
+  umm_size_class_head[blocks] = UMM_NFREE(c);
+  umm_size_class_count[blocks]--;
+
+  return( (void *)&UMM_DATA(c) );
+}
+
+/* Returns the cached blocks to the heap, true if there were any */
+static bool umm_size_class_flush_core( void ) {
+  bool flushed = false;
+
+  for( unsigned short int blocks = 1; blocks <= UMM_SIZE_CLASS_BLOCKS; blocks++ ) {
+    while( umm_size_class_head[blocks] ) {
+      unsigned short int c = umm_size_class_head[blocks];
+
+      umm_size_class_head[blocks] = UMM_NFREE(c);
+
+      /* umm_free_core() adds them back */
+      STATS__FREE_BLOCKS_UPDATE( -blocks );
+      umm_free_core( (void *)&UMM_DATA(c) );
+      flushed = true;
+    }
+    umm_size_class_count[blocks] = 0;
+  }
+
+  if( flushed )
+    STATS__SIZE_CLASS(flushes);
+
+  return flushed;
+}
+
+void umm_size_class_flush( void ) {
+  UMM_CRITICAL_DECL(id_free);
+
+  if (umm_heap == NULL) {
+    umm_init();
+  }
+
+  UMM_CRITICAL_ENTRY(id_free);
+
+  umm_size_class_flush_core();
+
+  UMM_CRITICAL_EXIT(id_free);
+}
+
+#endif
+
 /* ------------------------------------------------------------------------ */
 
 void umm_free( void *ptr ) {
@@ -357,6 +471,9 @@ void umm_free( void *ptr ) {
 
   UMM_CRITICAL_ENTRY(id_free);
 
+#ifdef UMM_SIZE_CLASSES
+  if( !umm_size_class_put( ptr ) )
+#endif
   umm_free_core( ptr );
 
   UMM_CRITICAL_EXIT(id_free);
@@ -466,6 +583,12 @@ static void *umm_malloc_core( size_t size ) {
     STATS__FREE_BLOCKS_UPDATE( -blocks );
     STATS__FREE_BLOCKS_MIN();
   } else {
+#ifdef UMM_SIZE_CLASSES
+    /* Give the cached small blocks back to the heap and try again */
+    if( umm_size_class_flush_core() )
+      return umm_malloc_core( size );
+#endif
+
     /* Out of memory */
     STATS__OOM_UPDATE();
 
@@ -506,7 +629,16 @@ void *umm_malloc( size_t size ) {
 
   UMM_CRITICAL_ENTRY(id_malloc);
 
+#ifdef UMM_SIZE_CLASSES
+  /* Small sizes are first looked up on their segregated list */
+  if( (ptr = umm_size_class_get( umm_blocks( size ) )) ) {
+    STATS__ALLOC_REQUEST(id_malloc, size);
+  } else {
+    ptr = umm_malloc_core( size );
+  }
+#else
   ptr = umm_malloc_core( size );
+#endif
 
   UMM_CRITICAL_EXIT(id_malloc);
 
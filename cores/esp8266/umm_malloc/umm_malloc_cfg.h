@@ -363,13 +363,26 @@ static inline void _critical_exit(UMM_TIME_STAT *p, uint32_t *saved_ps) {
 #ifdef TEST_BUILD
     extern int umm_critical_depth;
     extern int umm_max_critical_depth;
-    #define UMM_CRITICAL_ENTRY() {\
+    #define UMM_CRITICAL_DECL(tag) uint32_t _saved_ps_##tag __attribute__((unused))
+    #if defined(UMM_CRITICAL_METRICS)
+        // The test build provides xt_rsil(), xt_wsr_ps() and esp_get_cycle_count()
+        #define UMM_TEST_CRITICAL_ENTRY(tag) _critical_entry(&time_stats.tag, &_saved_ps_##tag)
+        #define UMM_TEST_CRITICAL_EXIT(tag) _critical_exit(&time_stats.tag, &_saved_ps_##tag)
+    #else
+        #define UMM_TEST_CRITICAL_ENTRY(tag) (void)0
+        #define UMM_TEST_CRITICAL_EXIT(tag) (void)0
+    #endif
+    #define UMM_CRITICAL_ENTRY(tag) {\
           ++umm_critical_depth; \
           if (umm_critical_depth > umm_max_critical_depth) { \
               umm_max_critical_depth = umm_critical_depth; \
           } \
+          UMM_TEST_CRITICAL_ENTRY(tag); \
+    }
+    #define UMM_CRITICAL_EXIT(tag) {\
+          UMM_TEST_CRITICAL_EXIT(tag); \
+          umm_critical_depth--; \
     }
-    #define UMM_CRITICAL_EXIT()  (umm_critical_depth--)
 #else
     #if defined(UMM_CRITICAL_METRICS)
         #define UMM_CRITICAL_DECL(tag) uint32_t _saved_ps_##tag
@@ -436,6 +449,50 @@ static inline void _critical_exit(UMM_TIME_STAT *p, uint32_t *saved_ps) {
 */
 #define UMM_REALLOC_DEFRAG
 
+/*
+ * -D UMM_SIZE_CLASSES
+ *
+ * Segregated free lists in front of the best fit search. A freed block of
+ * UMM_SIZE_CLASS_BLOCKS blocks or less (64 bytes of user data with the
+ * default of 9) is kept on the list of its exact size, up to
+ * UMM_SIZE_CLASS_DEPTH blocks per size, and the next malloc() of that size
+ * pops it in constant time instead of walking the whole free list with
+ * interrupts disabled. The small allocations behind String, pbuf headers and
+ * std::function captures are the most frequent ones.
+ *
+ * -D UMM_SIZE_CLASS_DEPTH=0 disables the cache.
+ *
+ * Cached blocks are counted as free by the UMM_STATS free heap figures and
+ * are returned to the heap (umm_size_class_flush()) when an allocation would
+ * otherwise fail and before umm_info() walks the heap. With
+ * UMM_CRITICAL_METRICS, time_stats counts the hits, misses and flushes.
+ *
+ * Not available with the poison checks, which validate every used block.
+ *
+ * Status: Local enhancement.
+ */
+#define UMM_SIZE_CLASSES
+
+#ifndef UMM_SIZE_CLASS_BLOCKS
+#define UMM_SIZE_CLASS_BLOCKS 9
+#endif
+#ifndef UMM_SIZE_CLASS_DEPTH
+#define UMM_SIZE_CLASS_DEPTH 4
+#endif
+
+/*
+ * -D UMM_HEAP_PROFILER
+ *
+ * Charges every live allocation to the site that made it, see
+ * heap_profiler.h. Costs about 2.5KB of static RAM with the default table
+ * sizes and a short critical section per heap call.
+ *
+ * Only as a build flag: heap.cpp, abi.cpp and heap_profiler.cpp test it
+ * before this file is included, defining it here has no effect.
+ *
+ * Status: Local enhancement.
+ */
+
 /*
  * -D UMM_INTEGRITY_CHECK :
  *
@@ -562,6 +619,15 @@ static inline void _critical_exit(UMM_TIME_STAT *p, uint32_t *saved_ps) {
 #  define POISON_CHECK_NEIGHBORS(c) do{}while(false)
 #endif
 
+/* The poison checks validate every used block, including the cached ones */
+#if defined(UMM_POISON_CHECK) || defined(UMM_POISON_CHECK_LITE)
+#undef UMM_SIZE_CLASSES
+#endif
+
+#ifdef UMM_SIZE_CLASSES
+   void umm_size_class_flush( void );
+#endif
+
 /////////////////////////////////////////////////
 #undef DBGLOG_FUNCTION
 #undef DBGLOG_FUNCTION_P
@@ -599,6 +665,11 @@ struct UMM_TIME_STATS_t {
   UMM_TIME_STAT id_integrity;
 #endif
   UMM_TIME_STAT id_no_tag;
+#ifdef UMM_SIZE_CLASSES
+  uint32_t size_class_hits;
+  uint32_t size_class_misses;
+  uint32_t size_class_flushes;
+#endif
 };
 #endif
 /////////////////////////////////////////////////
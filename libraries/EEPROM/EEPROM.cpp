@@ -22,6 +22,7 @@
 #include "Arduino.h"
 #include "EEPROM.h"
 #include "debug.h"
+#include "coredecls.h"
 
 extern "C" {
 #include "c_types.h"
@@ -33,19 +34,70 @@ extern "C" {
 
 extern "C" uint32_t _EEPROM_start;
 
+// Journal layout used when more than one sector is given: every sector
+// starts with a header, followed by a snapshot record of the whole EEPROM
+// image and then by delta records appended on each commit.  Erased flash
+// reads as 0xff, which marks the free space after the last record.
+#define EEPROM_JOURNAL_MAGIC 0x4a504545 // "EEPJ"
+
+struct EEPROMSectorHeader {
+  uint32_t magic;
+  uint32_t generation;
+  uint32_t size;
+  uint32_t crc;
+};
+
+struct EEPROMRecordHeader {
+  uint16_t offset;
+  uint16_t length;
+  uint32_t crc;
+};
+
+static const size_t EEPROM_JOURNAL_START = sizeof(EEPROMSectorHeader);
+static const size_t EEPROM_JOURNAL_MAX_SIZE = SPI_FLASH_SEC_SIZE - sizeof(EEPROMSectorHeader) - sizeof(EEPROMRecordHeader);
+
 EEPROMClass::EEPROMClass(uint32_t sector)
 : _sector(sector)
 , _data(0)
 , _size(0)
 , _dirty(false)
+, _sectorCount(1)
+, _activeSector(0)
+, _generation(0)
+, _journalSize(0)
+, _writeOffset(0)
+, _dirtyStart(0)
+, _dirtyEnd(0)
+{
+}
+
+EEPROMClass::EEPROMClass(uint32_t sector, uint32_t sectorCount)
+: _sector(sector)
+, _data(0)
+, _size(0)
+, _dirty(false)
+, _sectorCount(sectorCount ? sectorCount : 1)
+, _activeSector(0)
+, _generation(0)
+, _journalSize(0)
+, _writeOffset(0)
+, _dirtyStart(0)
+, _dirtyEnd(0)
 {
 }
 
 EEPROMClass::EEPROMClass(void)
-: _sector((((uint32_t)&_EEPROM_start - 0x40200000) / SPI_FLASH_SEC_SIZE))
+: _sector((((uintptr_t)&_EEPROM_start - 0x40200000) / SPI_FLASH_SEC_SIZE))
 , _data(0)
 , _size(0)
 , _dirty(false)
+, _sectorCount(1)
+, _activeSector(0)
+, _generation(0)
+, _journalSize(0)
+, _writeOffset(0)
+, _dirtyStart(0)
+, _dirtyEnd(0)
 {
 }
 
@@ -58,6 +110,10 @@ void EEPROMClass::begin(size_t size) {
     DEBUGV("EEPROMClass::begin error, %d > %d\n", size, SPI_FLASH_SEC_SIZE);
     size = SPI_FLASH_SEC_SIZE;
   }
+  if (_sectorCount > 1 && size > EEPROM_JOURNAL_MAX_SIZE) {
+    DEBUGV("EEPROMClass::begin error, %d > %d\n", size, EEPROM_JOURNAL_MAX_SIZE);
+    size = EEPROM_JOURNAL_MAX_SIZE;
+  }
 
   size = (size + 3) & (~3);
 
@@ -71,11 +127,15 @@ void EEPROMClass::begin(size_t size) {
 
   _size = size;
 
-  if (!ESP.flashRead(_sector * SPI_FLASH_SEC_SIZE, reinterpret_cast<uint32_t*>(_data), _size)) {
+  if (_sectorCount > 1) {
+    _loadJournal();
+  } else if (!ESP.flashRead(_sector * SPI_FLASH_SEC_SIZE, reinterpret_cast<uint32_t*>(_data), _size)) {
     DEBUGV("EEPROMClass::begin flash read failed\n");
   }
 
   _dirty = false; //make sure dirty is cleared in case begin() is called 2nd+ time
+  _dirtyStart = _size;
+  _dirtyEnd = 0;
 }
 
 void EEPROMClass::end() {
@@ -120,7 +180,7 @@ void EEPROMClass::write(int const address, uint8_t const value) {
   if (*pData != value)
   {
     *pData = value;
-    _dirty = true;
+    _markDirty(address, 1);
   }
 }
 
@@ -132,6 +192,31 @@ bool EEPROMClass::commit() {
   if(!_data)
     return false;
 
+  if (_sectorCount > 1) {
+    // Records are word aligned, flash can only be written by 32-bit words
+    size_t start = _dirtyStart & ~3;
+    size_t end = (_dirtyEnd + 3) & ~3;
+    if (end > _size)
+      end = _size;
+    if (start < end
+        && _journalSize == _size
+        && _writeOffset + sizeof(EEPROMRecordHeader) + (end - start) <= SPI_FLASH_SEC_SIZE
+        && _appendRecord(start, end - start)) {
+      _dirty = false;
+      _dirtyStart = _size;
+      _dirtyEnd = 0;
+      return true;
+    }
+    if (_compact()) {
+      _dirty = false;
+      _dirtyStart = _size;
+      _dirtyEnd = 0;
+      return true;
+    }
+    DEBUGV("EEPROMClass::commit failed\n");
+    return false;
+  }
+
   if (ESP.flashEraseSector(_sector)) {
     if (ESP.flashWrite(_sector * SPI_FLASH_SEC_SIZE, reinterpret_cast<uint32_t*>(_data), _size)) {
       _dirty = false;
@@ -144,7 +229,7 @@ bool EEPROMClass::commit() {
 }
 
 uint8_t * EEPROMClass::getDataPtr() {
-  _dirty = true;
+  _markDirty(0, _size);
   return &_data[0];
 }
 
@@ -152,6 +237,173 @@ uint8_t const * EEPROMClass::getConstDataPtr() const {
   return &_data[0];
 }
 
+void EEPROMClass::_markDirty(size_t address, size_t length) {
+  _dirty = true;
+  if (address < _dirtyStart)
+    _dirtyStart = address;
+  if (address + length > _dirtyEnd)
+    _dirtyEnd = address + length;
+}
+
+bool EEPROMClass::_loadJournal() {
+  // Pick the newest sector whose header and snapshot are intact, older
+  // generations are only tried when a compaction was interrupted
+  bool tried = false;
+  uint32_t below = 0;
+  while (true) {
+    bool found = false;
+    uint32_t bestSector = 0;
+    uint32_t bestGeneration = 0;
+    for (uint32_t i = 0; i < _sectorCount; ++i) {
+      EEPROMSectorHeader header;
+      if (!ESP.flashRead((_sector + i) * SPI_FLASH_SEC_SIZE, reinterpret_cast<uint32_t*>(&header), sizeof(header)))
+        continue;
+      if (header.magic != EEPROM_JOURNAL_MAGIC || header.crc != crc32(&header, offsetof(EEPROMSectorHeader, crc)))
+        continue;
+      if (tried && (int32_t)(header.generation - below) >= 0)
+        continue;
+      if (!found || (int32_t)(header.generation - bestGeneration) > 0) {
+        found = true;
+        bestSector = i;
+        bestGeneration = header.generation;
+      }
+    }
+    if (!found)
+      break;
+    if (_replaySector(bestSector)) {
+      _activeSector = bestSector;
+      _generation = bestGeneration;
+      return true;
+    }
+    DEBUGV("EEPROMClass::begin journal sector %d damaged\n", bestSector);
+    tried = true;
+    below = bestGeneration;
+  }
+
+  // No journal yet: take over the first sector as a legacy image so that an
+  // existing EEPROM area keeps its content. The first commit compacts it into
+  // the next sector, the legacy copy is only erased once the journal wrapped
+  if (!ESP.flashRead(_sector * SPI_FLASH_SEC_SIZE, reinterpret_cast<uint32_t*>(_data), _size)) {
+    DEBUGV("EEPROMClass::begin flash read failed\n");
+  }
+  _activeSector = 0;
+  _generation = 0;
+  _journalSize = 0;
+  _writeOffset = SPI_FLASH_SEC_SIZE;
+  return false;
+}
+
+bool EEPROMClass::_replaySector(uint32_t sector) {
+  uint32_t base = (_sector + sector) * SPI_FLASH_SEC_SIZE;
+  EEPROMSectorHeader sectorHeader;
+  if (!ESP.flashRead(base, reinterpret_cast<uint32_t*>(&sectorHeader), sizeof(sectorHeader)))
+    return false;
+
+  memset(_data, 0xff, _size);
+  uint32_t chunk[16];
+  size_t pos = EEPROM_JOURNAL_START;
+  bool first = true;
+  while (pos + sizeof(EEPROMRecordHeader) <= SPI_FLASH_SEC_SIZE) {
+    EEPROMRecordHeader header;
+    if (!ESP.flashRead(base + pos, reinterpret_cast<uint32_t*>(&header), sizeof(header)))
+      return false;
+    if (header.offset == 0xffff && header.length == 0xffff)
+      break;
+    size_t length = header.length;
+    if (length == 0 || (length & 3) || pos + sizeof(header) + length > SPI_FLASH_SEC_SIZE)
+      break;
+    if (first && (header.offset != 0 || length != sectorHeader.size))
+      return false;
+
+    // Check the record before touching _data, a torn write ends the journal
+    uint32_t crc = crc32(&header, offsetof(EEPROMRecordHeader, crc));
+    for (size_t done = 0; done < length; done += sizeof(chunk)) {
+      size_t n = std::min(length - done, sizeof(chunk));
+      if (!ESP.flashRead(base + pos + sizeof(header) + done, chunk, n))
+        return false;
+      crc = crc32(chunk, n, crc);
+    }
+    if (crc != header.crc)
+      break;
+
+    for (size_t done = 0; done < length; done += sizeof(chunk)) {
+      size_t n = std::min(length - done, sizeof(chunk));
+      size_t address = header.offset + done;
+      if (address >= _size)
+        break;
+      if (!ESP.flashRead(base + pos + sizeof(header) + done, chunk, n))
+        return false;
+      memcpy(_data + address, chunk, std::min(n, _size - address));
+    }
+    pos += sizeof(header) + length;
+    first = false;
+  }
+
+  if (first) {
+    // The snapshot record is missing or damaged
+    return false;
+  }
+
+  _journalSize = sectorHeader.size;
+  _writeOffset = pos;
+  if (pos + sizeof(EEPROMRecordHeader) <= SPI_FLASH_SEC_SIZE) {
+    // Anything left after the last good record must still be erased,
+    // otherwise stop appending to this sector
+    EEPROMRecordHeader next;
+    if (!ESP.flashRead(base + pos, reinterpret_cast<uint32_t*>(&next), sizeof(next))
+        || next.offset != 0xffff || next.length != 0xffff || next.crc != 0xffffffff)
+      _writeOffset = SPI_FLASH_SEC_SIZE;
+  }
+  return true;
+}
+
+bool EEPROMClass::_appendRecord(size_t offset, size_t length) {
+  size_t pos = _writeOffset;
+  uint32_t address = (_sector + _activeSector) * SPI_FLASH_SEC_SIZE + pos;
+  EEPROMRecordHeader header;
+  header.offset = offset;
+  header.length = length;
+  header.crc = crc32(_data + offset, length, crc32(&header, offsetof(EEPROMRecordHeader, crc)));
+
+  // Even if the header is written, a later failure leaves a record with a
+  // bad CRC which ends the journal on next begin()
+  _writeOffset = SPI_FLASH_SEC_SIZE;
+  if (!ESP.flashWrite(address, reinterpret_cast<uint32_t*>(&header), sizeof(header)))
+    return false;
+  if (!ESP.flashWrite(address + sizeof(header), reinterpret_cast<uint32_t*>(_data + offset), length))
+    return false;
+  _writeOffset = pos + sizeof(header) + length;
+  return true;
+}
+
+bool EEPROMClass::_compact() {
+  // The previous sector is left untouched until the new one is complete
+  uint32_t previousSector = _activeSector;
+  size_t previousOffset = _writeOffset;
+  _activeSector = (_activeSector + 1) % _sectorCount;
+
+  if (ESP.flashEraseSector(_sector + _activeSector)) {
+    EEPROMSectorHeader header;
+    header.magic = EEPROM_JOURNAL_MAGIC;
+    header.generation = _generation + 1;
+    header.size = _size;
+    header.crc = crc32(&header, offsetof(EEPROMSectorHeader, crc));
+    if (ESP.flashWrite((_sector + _activeSector) * SPI_FLASH_SEC_SIZE, reinterpret_cast<uint32_t*>(&header), sizeof(header))) {
+      _writeOffset = EEPROM_JOURNAL_START;
+      if (_appendRecord(0, _size)) {
+        _generation = header.generation;
+        _journalSize = _size;
+        return true;
+      }
+    }
+  }
+
+  DEBUGV("EEPROMClass::compact failed\n");
+  _activeSector = previousSector;
+  _writeOffset = previousOffset;
+  return false;
+}
+
 #if !defined(NO_GLOBAL_INSTANCES) && !defined(NO_GLOBAL_EEPROM)
 EEPROMClass EEPROM;
 #endif
@@ -29,6 +29,10 @@
 class EEPROMClass {
 public:
   EEPROMClass(uint32_t sector);
+  // Wear-levelled mode: sectorCount consecutive flash sectors starting at
+  // sector hold a journal of CRC-checked records.  commit() appends only the
+  // changed range and erases a sector only when the current one is full.
+  EEPROMClass(uint32_t sector, uint32_t sectorCount);
   EEPROMClass(void);
 
   void begin(size_t size);
@@ -54,7 +58,7 @@ public:
     if (address < 0 || address + sizeof(T) > _size)
       return t;
     if (memcmp(_data + address, (const uint8_t*)&t, sizeof(T)) != 0) {
-      _dirty = true;
+      _markDirty(address, sizeof(T));
       memcpy(_data + address, (const uint8_t*)&t, sizeof(T));
     }
 
@@ -67,10 +71,24 @@ public:
   uint8_t const & operator[](int const address) const {return getConstDataPtr()[address];}
 
 protected:
+  void _markDirty(size_t address, size_t length);
+  bool _loadJournal();
+  bool _replaySector(uint32_t sector);
+  bool _appendRecord(size_t offset, size_t length);
+  bool _compact();
+
   uint32_t _sector;
   uint8_t* _data;
   size_t _size;
   bool _dirty;
+
+  uint32_t _sectorCount;
+  uint32_t _activeSector;
+  uint32_t _generation;
+  size_t _journalSize;
+  size_t _writeOffset;
+  size_t _dirtyStart;
+  size_t _dirtyEnd;
 };
 
 #if !defined(NO_GLOBAL_INSTANCES) && !defined(NO_GLOBAL_EEPROM)
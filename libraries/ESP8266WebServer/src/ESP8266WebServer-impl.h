@@ -22,7 +22,7 @@
 
 
 #include <Arduino.h>
-#include <libb64/cencode.h>
+#include <base64.h>
 #include "WiFiServer.h"
 #include "WiFiClient.h"
 #include "ESP8266WebServer.h"
@@ -125,27 +125,28 @@ bool ESP8266WebServerTemplate<ServerType>::authenticate(const char * username, c
     if(authReq.startsWith(F("Basic"))){
       authReq = authReq.substring(6);
       authReq.trim();
-      char toencodeLen = strlen(username)+strlen(password)+1;
-      char *toencode = new char[toencodeLen + 1];
-      if(toencode == NULL){
-        authReq = "";
-        return false;
-      }
-      char *encoded = new char[base64_encode_expected_len(toencodeLen)+1];
-      if(encoded == NULL){
-        authReq = "";
-        delete[] toencode;
-        return false;
-      }
-      sprintf(toencode, "%s:%s", username, password);
-      if(base64_encode_chars(toencode, toencodeLen, encoded) > 0 && authReq.equalsConstantTime(encoded)) {
-        authReq = "";
-        delete[] toencode;
-        delete[] encoded;
-        return true;
-      }
-      delete[] toencode;
-      delete[] encoded;
+      // base64 of "username:password" is compared with the header as it
+      // is produced, in constant time and without building it
+      struct Compare: public Print {
+        Compare(const String& expected): expected(expected), pos(0), diff(0) { }
+        size_t write(uint8_t c) override { return write(&c, 1); }
+        size_t write(const uint8_t* data, size_t len) override {
+          for (size_t i = 0; i < len; i++, pos++)
+            diff |= pos < expected.length() ? data[i] ^ (uint8_t)expected[pos] : 1;
+          return len;
+        }
+        const String& expected;
+        size_t pos;
+        uint8_t diff;
+      } compare(authReq);
+      Base64Encoder encoder(compare);
+      encoder.print(username);
+      encoder.print(':');
+      encoder.print(password);
+      encoder.end();
+      bool match = !compare.diff && compare.pos == authReq.length();
+      authReq = "";
+      return match;
     } else if(authReq.startsWith(F("Digest"))) {
       String _realm    = _extractParam(authReq, F("realm=\""));
       String _H1 = credentialHash((String)username,_realm,(String)password);
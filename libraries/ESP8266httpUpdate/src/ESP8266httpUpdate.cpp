@@ -371,8 +371,8 @@ HTTPUpdateResult ESP8266HTTPUpdate::handleUpdate(HTTPClient& http, const String&
                         return HTTP_UPDATE_FAILED;
                     }
 
-                    // check for valid first magic byte
-                    if(buf[0] != 0xE9 && buf[0] != 0x1f) {
+                    // check for valid first magic byte (0xE9, 0x1f for gzip, or a delta patch)
+                    if(buf[0] != 0xE9 && buf[0] != 0x1f && buf[0] != DELTA_MAGIC_BYTE) {
                         DEBUG_HTTP_UPDATE("[httpUpdate] Magic header does not start with 0xE9\n");
                         _setLastError(HTTP_UE_BIN_VERIFY_HEADER_FAILED);
                         http.end();
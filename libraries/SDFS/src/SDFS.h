@@ -47,7 +47,7 @@ class SDFSConfig : public FSConfig
 public:
     static constexpr uint32_t FSId = 0x53444653;
 
-    SDFSConfig(uint8_t csPin = 4, SPISettings spi = SD_SCK_MHZ(10)) : FSConfig(FSId, false), _csPin(csPin), _part(0), _spiSettings(spi)  { }
+    SDFSConfig(uint8_t csPin = 4, SPISettings spi = SD_SCK_MHZ(10)) : FSConfig(FSId, false), _csPin(csPin), _part(0), _spiSettings(spi), _bufferSize(0)  { }
 
     SDFSConfig setAutoFormat(bool val = true) {
         _autoFormat = val;
@@ -65,11 +65,37 @@ public:
         _part = part;
         return *this;
     }
+    // Per-file buffer (a multiple of 512 bytes, 0 to disable) gathering small
+    // sequential reads and writes, so that SdFat moves whole runs of blocks
+    // with multi-block commands (CMD18/CMD25) instead of one block at a time
+    SDFSConfig setBuffer(size_t size) {
+        _bufferSize = size & ~511;
+        return *this;
+    }
 
     // Inherit _type and _autoFormat
     uint8_t     _csPin;
     uint8_t     _part;
     SPISettings _spiSettings;
+    size_t      _bufferSize;
+};
+
+// Data moved between the files and the card, and time spent doing it
+struct SDFSStats
+{
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+    uint32_t readCalls;
+    uint32_t writeCalls;
+    uint64_t readMicros;
+    uint64_t writeMicros;
+
+    float readMBps() const {
+        return readMicros ? (float)bytesRead / readMicros : 0;
+    }
+    float writeMBps() const {
+        return writeMicros ? (float)bytesWritten / writeMicros : 0;
+    }
 };
 
 class SDFSImpl : public FSImpl
@@ -77,6 +103,7 @@ class SDFSImpl : public FSImpl
 public:
     SDFSImpl() : _mounted(false)
     {
+        resetStats();
     }
 
     FileImplPtr open(const char* path, OpenMode openMode, AccessMode accessMode) override;
@@ -167,6 +194,14 @@ public:
 
     bool format() override;
 
+    // Throughput of file data, to compare SPI speeds and buffer sizes
+    const SDFSStats& getStats() const {
+        return _stats;
+    }
+    void resetStats() {
+        memset(&_stats, 0, sizeof(_stats));
+    }
+
     // The following are not common FS interfaces, but are needed only to
     // support the older SD.h exports
     uint8_t type() {
@@ -218,6 +253,7 @@ public:
 
 protected:
     friend class SDFileImpl;
+    friend class SDFSFileImpl;
     friend class SDFSDirImpl;
 
     sdfat::SdFat* getFs()
@@ -249,6 +285,7 @@ protected:
     sdfat::SdFat _fs;
     SDFSConfig   _cfg;
     bool         _mounted;
+    SDFSStats    _stats;
 };
 
 
@@ -256,10 +293,16 @@ class SDFSFileImpl : public FileImpl
 {
 public:
     SDFSFileImpl(SDFSImpl *fs, std::shared_ptr<sdfat::File> fd, const char *name)
-        : _fs(fs), _fd(fd), _opened(true)
+        : _fs(fs), _fd(fd), _opened(true), _bufSize(fs->_cfg._bufferSize), _bufLen(0), _bufPos(0), _bufWrite(false)
     {
         _name = std::shared_ptr<char>(new char[strlen(name) + 1], std::default_delete<char[]>());
         strcpy(_name.get(), name);
+        if (_bufSize) {
+            _buf.reset(new (std::nothrow) uint8_t[_bufSize]);
+            if (!_buf) {
+                _bufSize = 0;
+            }
+        }
     }
 
     ~SDFSFileImpl() override
@@ -270,17 +313,89 @@ public:
 
     size_t write(const uint8_t *buf, size_t size) override
     {
-        return _opened ? _fd->write(buf, size) : -1;
+        if (!_opened) {
+            return -1;
+        }
+        if (!_bufSize) {
+            return _write(buf, size);
+        }
+        if (!_bufWrite) {
+            _dropReadAhead();
+            _bufWrite = true;
+        }
+        size_t done = 0;
+        while (done < size) {
+            // Stop gathering at a block boundary, so that the next flush is
+            // block aligned and goes out as a single multi-block write
+            size_t limit = _bufSize - (_fd->curPosition() & 511);
+            if (!_bufLen && size - done >= limit) {
+                size_t n = limit + ((size - done - limit) & ~511);
+                size_t w = _write(buf + done, n);
+                done += w;
+                if (w < n) {
+                    break;
+                }
+                continue;
+            }
+            size_t n = std::min(size - done, limit - _bufLen);
+            size_t before = _bufLen;
+            memcpy(_buf.get() + _bufLen, buf + done, n);
+            _bufLen += n;
+            size_t written;
+            if (_bufLen == limit && !_flushWrite(&written)) {
+                // Only the bytes of this call that reached the card count
+                done += (written > before) ? written - before : 0;
+                break;
+            }
+            done += n;
+        }
+        return done;
     }
 
     size_t read(uint8_t* buf, size_t size) override
     {
-        return _opened ? _fd->read(buf, size) : -1;
+        if (!_opened) {
+            return -1;
+        }
+        if (!_bufSize) {
+            return _read(buf, size);
+        }
+        if (_bufWrite) {
+            if (!_flushWrite()) {
+                return 0;
+            }
+            _bufWrite = false;
+        }
+        size_t done = 0;
+        while (done < size) {
+            if (_bufPos < _bufLen) {
+                size_t n = std::min(size - done, _bufLen - _bufPos);
+                memcpy(buf + done, _buf.get() + _bufPos, n);
+                _bufPos += n;
+                done += n;
+                continue;
+            }
+            // Large requests go straight to the card, small ones refill the
+            // read-ahead buffer up to a block boundary
+            size_t limit = _bufSize - (_fd->curPosition() & 511);
+            if (size - done >= limit) {
+                size_t r = _read(buf + done, size - done);
+                done += r;
+                break;
+            }
+            _bufPos = 0;
+            _bufLen = _read(_buf.get(), limit);
+            if (!_bufLen) {
+                break;
+            }
+        }
+        return done;
     }
 
     void flush() override
     {
         if (_opened) {
+            _flushWrite();
             _fd->flush();
             _fd->sync();
         }
@@ -291,6 +406,18 @@ public:
         if (!_opened) {
             return false;
         }
+        if (_bufSize) {
+            if (mode == SeekCur) {
+                // The card position runs ahead of or behind the buffer
+                pos += position();
+                mode = SeekSet;
+            }
+            if (!_flushWrite()) {
+                return false;
+            }
+            _bufWrite = false;
+            _dropReadAhead();
+        }
         switch (mode) {
             case SeekSet:
                 return _fd->seekSet(pos);
@@ -308,12 +435,21 @@ public:
 
     size_t position() const override
     {
-        return _opened ? _fd->curPosition() : 0;
+        if (!_opened) {
+            return 0;
+        }
+        if (_bufWrite) {
+            return _fd->curPosition() + _bufLen;
+        }
+        return _fd->curPosition() - (_bufLen - _bufPos);
     }
 
     size_t size() const override
     {
-        return _opened ? _fd->fileSize() : 0;
+        if (!_opened) {
+            return 0;
+        }
+        return _bufWrite ? std::max((size_t)_fd->fileSize(), position()) : _fd->fileSize();
     }
 
     bool truncate(uint32_t size) override
@@ -322,12 +458,18 @@ public:
             DEBUGV("SDFSFileImpl::truncate: file not opened\n");
             return false;
         }
+        if (!_flushWrite()) {
+            return false;
+        }
+        _bufWrite = false;
+        _dropReadAhead();
         return _fd->truncate(size);
     }
 
     void close() override
     {
         if (_opened) {
+            _flushWrite();
             _fd->close();
             _opened = false;
         }
@@ -389,10 +531,64 @@ public:
 
 
 protected:
+    size_t _read(uint8_t* buf, size_t size)
+    {
+        uint32_t start = micros();
+        int r = _fd->read(buf, size);
+        _fs->_stats.readMicros += micros() - start;
+        _fs->_stats.readCalls++;
+        if (r <= 0) {
+            return 0;
+        }
+        _fs->_stats.bytesRead += r;
+        return r;
+    }
+
+    size_t _write(const uint8_t* buf, size_t size)
+    {
+        uint32_t start = micros();
+        size_t w = _fd->write(buf, size);
+        if (w > size) {
+            w = 0; // -1 from SdFat on error
+        }
+        _fs->_stats.writeMicros += micros() - start;
+        _fs->_stats.writeCalls++;
+        _fs->_stats.bytesWritten += w;
+        return w;
+    }
+
+    bool _flushWrite(size_t* written = nullptr)
+    {
+        size_t len = (_bufWrite) ? _bufLen : 0;
+        size_t w = len ? _write(_buf.get(), len) : 0;
+        if (len) {
+            _bufLen = 0;
+        }
+        if (written) {
+            *written = w;
+        }
+        return w == len;
+    }
+
+    void _dropReadAhead()
+    {
+        if (!_bufWrite && _bufPos < _bufLen) {
+            // Put the card position back where the reader is
+            _fd->seekSet(position());
+        }
+        _bufLen = 0;
+        _bufPos = 0;
+    }
+
     SDFSImpl*                     _fs;
     std::shared_ptr<sdfat::File>  _fd;
     std::shared_ptr<char>         _name;
     bool                          _opened;
+    std::unique_ptr<uint8_t[]>    _buf;
+    size_t                        _bufSize;
+    size_t                        _bufLen;  // bytes in _buf
+    size_t                        _bufPos;  // read-ahead: next byte to return
+    bool                          _bufWrite; // _buf holds data not yet written
 };
 
 class SDFSDirImpl : public DirImpl
@@ -21,6 +21,7 @@
 
 #include "SPI.h"
 #include "HardwareSerial.h"
+#include "Schedule.h"
 
 #define SPI_PINS_HSPI			0 // Normal HSPI mode (MISO = GPIO12, MOSI = GPIO13, SCLK = GPIO14);
 #define SPI_PINS_HSPI_OVERLAP	1 // HSPI Overllaped in spi0 pins (MISO = SD0, MOSI = SDD1, SCLK = CLK);
@@ -42,6 +43,16 @@ typedef union {
 SPIClass::SPIClass() {
     useHwCs = false;
     pinSet = SPI_PINS_HSPI;
+    _head = nullptr;
+    _tail = nullptr;
+    _current = nullptr;
+    _polling = false;
+    _isrAttached = false;
+    _savedClock = 0;
+    _savedMux = 0;
+    _savedCtrl = 0;
+    _savedUser = 0;
+    _savedPin = 0;
 }
 
 bool SPIClass::pins(int8_t sck, int8_t miso, int8_t mosi, int8_t ss)
@@ -87,6 +98,13 @@ void SPIClass::begin() {
 }
 
 void SPIClass::end() {
+    flushQueue();
+    if (_isrAttached) {
+        ETS_SPI_INTR_DISABLE();
+        SPI1S &= ~SPISTRIE;
+        ETS_SPI_INTR_ATTACH(NULL, NULL);
+        _isrAttached = false;
+    }
     switch (pinSet) {
     case SPI_PINS_HSPI:
         pinMode(SCK, INPUT);
@@ -107,6 +125,7 @@ void SPIClass::end() {
 }
 
 void SPIClass::setHwCs(bool use) {
+    flushQueue();
     switch (pinSet) {
     case SPI_PINS_HSPI:
         if (use) {
@@ -140,6 +159,7 @@ void SPIClass::setHwCs(bool use) {
 }
 
 void SPIClass::beginTransaction(SPISettings settings) {
+    flushQueue();
     while(SPI1CMD & SPIBUSY) {}
     setFrequency(settings._clock);
     setBitOrder(settings._bitOrder);
@@ -150,6 +170,7 @@ void SPIClass::endTransaction() {
 }
 
 void SPIClass::setDataMode(uint8_t dataMode) {
+    flushQueue();
 
     /**
      SPI_MODE0 0x00 - CPOL: 0  CPHA: 0
@@ -182,6 +203,7 @@ void SPIClass::setDataMode(uint8_t dataMode) {
 }
 
 void SPIClass::setBitOrder(uint8_t bitOrder) {
+    flushQueue();
     if(bitOrder == MSBFIRST) {
         SPI1C &= ~(SPICWBO | SPICRBO);
     } else {
@@ -198,28 +220,21 @@ static uint32_t ClkRegToFreq(spiClk_t * reg) {
     return (ESP8266_CLOCK / ((reg->regPre + 1) * (reg->regN + 1)));
 }
 
-void SPIClass::setFrequency(uint32_t freq) {
-    static uint32_t lastSetFrequency = 0;
-    static uint32_t lastSetRegister = 0;
-
+/**
+ * calculate the clock register value for a Frequency
+ * @param freq
+ * @return
+ */
+static uint32_t FreqToClkReg(uint32_t freq) {
     if(freq >= ESP8266_CLOCK) {
-        setClockDivider(0x80000000);
-        return;
-    }
-
-    if(lastSetFrequency == freq && lastSetRegister == SPI1CLK) {
-        // do nothing (speed optimization)
-        return;
+        return 0x80000000;
     }
 
     const spiClk_t minFreqReg = { 0x7FFFF020 };
     uint32_t minFreq = ClkRegToFreq((spiClk_t*) &minFreqReg);
     if(freq < minFreq) {
         // use minimum possible clock
-        setClockDivider(minFreqReg.regValue);
-        lastSetRegister = SPI1CLK;
-        lastSetFrequency = freq;
-        return;
+        return minFreqReg.regValue;
     }
 
     uint8_t calN = 1;
@@ -275,13 +290,32 @@ void SPIClass::setFrequency(uint32_t freq) {
 
     // os_printf("[0x%08X][%d]\t EQU: %d\t Pre: %d\t N: %d\t H: %d\t L: %d\t - Real Frequency: %d\n", bestReg.regValue, freq, bestReg.regEQU, bestReg.regPre, bestReg.regN, bestReg.regH, bestReg.regL, ClkRegToFreq(&bestReg));
 
-    setClockDivider(bestReg.regValue);
+    return bestReg.regValue;
+}
+
+void SPIClass::setFrequency(uint32_t freq) {
+    static uint32_t lastSetFrequency = 0;
+    static uint32_t lastSetRegister = 0;
+
+    flushQueue();
+
+    if(freq >= ESP8266_CLOCK) {
+        setClockDivider(0x80000000);
+        return;
+    }
+
+    if(lastSetFrequency == freq && lastSetRegister == SPI1CLK) {
+        // do nothing (speed optimization)
+        return;
+    }
+
+    setClockDivider(FreqToClkReg(freq));
     lastSetRegister = SPI1CLK;
     lastSetFrequency = freq;
-
 }
 
 void SPIClass::setClockDivider(uint32_t clockDiv) {
+    flushQueue();
     if(clockDiv == 0x80000000) {
         GPMUX |= (1 << 9); // Set bit 9 if sysclock required
     } else {
@@ -297,6 +331,7 @@ inline void SPIClass::setDataBits(uint16_t bits) {
 }
 
 uint8_t SPIClass::transfer(uint8_t data) {
+    flushQueue();
     while(SPI1CMD & SPIBUSY) {}
     // reset to 8Bit mode
     setDataBits(8);
@@ -315,6 +350,7 @@ uint16_t SPIClass::transfer16(uint16_t data) {
             };
     } in, out;
     in.val = data;
+    flushQueue();
 
     if((SPI1C & (SPICWBO | SPICRBO))) {
         //LSBFIRST
@@ -330,6 +366,7 @@ uint16_t SPIClass::transfer16(uint16_t data) {
 
 void SPIClass::transfer(void *buf, uint16_t count) {
     uint8_t *cbuf = reinterpret_cast<uint8_t*>(buf);
+    flushQueue();
 
     // cbuf may not be 32bits-aligned
     for (; (((unsigned long)cbuf) & 3) && count; cbuf++, count--)
@@ -348,6 +385,7 @@ void SPIClass::transfer(void *buf, uint16_t count) {
 }
 
 void SPIClass::write(uint8_t data) {
+    flushQueue();
     while(SPI1CMD & SPIBUSY) {}
     // reset to 8Bit mode
     setDataBits(8);
@@ -357,10 +395,12 @@ void SPIClass::write(uint8_t data) {
 }
 
 void SPIClass::write16(uint16_t data) {
+    flushQueue();
     write16(data, !(SPI1C & (SPICWBO | SPICRBO)));
 }
 
 void SPIClass::write16(uint16_t data, bool msb) {
+    flushQueue();
     while(SPI1CMD & SPIBUSY) {}
     // Set to 16Bits transfer
     setDataBits(16);
@@ -376,10 +416,12 @@ void SPIClass::write16(uint16_t data, bool msb) {
 }
 
 void SPIClass::write32(uint32_t data) {
+    flushQueue();
     write32(data, !(SPI1C & (SPICWBO | SPICRBO)));
 }
 
 void SPIClass::write32(uint32_t data, bool msb) {
+    flushQueue();
     while(SPI1CMD & SPIBUSY) {}
     // Set to 32Bits transfer
     setDataBits(32);
@@ -405,6 +447,7 @@ void SPIClass::write32(uint32_t data, bool msb) {
  * @param size uint32_t
  */
 void SPIClass::writeBytes(const uint8_t * data, uint32_t size) {
+    flushQueue();
     while(size) {
         if(size > 64) {
             writeBytes_(data, 64);
@@ -444,6 +487,7 @@ void SPIClass::writeBytes_(const uint8_t * data, uint8_t size) {
  */
 void SPIClass::writePattern(const uint8_t * data, uint8_t size, uint32_t repeat) {
     if(size > 64) return; //max Hardware FIFO
+    flushQueue();
 
     while(SPI1CMD & SPIBUSY) {}
 
@@ -519,6 +563,7 @@ void SPIClass::writePattern(const uint8_t * data, uint8_t size, uint32_t repeat)
  * @param size uint32_t
  */
 void SPIClass::transferBytes(const uint8_t * out, uint8_t * in, uint32_t size) {
+    flushQueue();
     while(size) {
         if(size > 64) {
             transferBytes_(out, in, 64);
@@ -606,6 +651,189 @@ void SPIClass::transferBytes_(const uint8_t * out, uint8_t * in, uint8_t size) {
     }
 }
 
+bool SPIClass::queue(SPITransaction& t) {
+    if (!t.size) {
+        return false;
+    }
+    for (SPITransaction * q = _head; q; q = q->_next) {
+        if (q == &t) {
+            return false;
+        }
+    }
+
+    // Register values, so that the interrupt only has to copy them
+    t._clock = FreqToClkReg(t.settings._clock);
+    t._ctrl = (t.settings._bitOrder == MSBFIRST) ? 0 : (SPICWBO | SPICRBO);
+    bool CPOL = (t.settings._dataMode & 0x10);
+    bool CPHA = (t.settings._dataMode & 0x01);
+    if(CPOL)          // Same as setDataMode()
+        CPHA ^= 1;
+    t._user = CPHA ? SPIUSME : 0;
+    t._pin = CPOL ? (1 << 29) : 0;
+    if (t.csPin >= 0) {
+        pinMode(t.csPin, OUTPUT);
+        digitalWrite(t.csPin, HIGH);
+    }
+    t.pending = true;
+    t._next = nullptr;
+    if (_tail) {
+        _tail->_next = &t;
+    } else {
+        _head = &t;
+    }
+    _tail = &t;
+
+    if (!_polling) {
+        _polling = true;
+        schedule_recurrent_function_us([this]() { return pollQueue(); }, 0);
+    }
+    if (!_isrAttached) {
+        _isrAttached = true;
+        ETS_SPI_INTR_ATTACH(onInterrupt, this);
+    }
+
+    ETS_SPI_INTR_DISABLE();
+    if (!_current) {
+        // Idle: the interrupt saw the end of the queue before t was linked
+        while(SPI1CMD & SPIBUSY) {}
+        _savedClock = SPI1CLK;
+        _savedMux = GPMUX & (1 << 9);
+        _savedCtrl = SPI1C & (SPICWBO | SPICRBO);
+        _savedUser = SPI1U & SPIUSME;
+        _savedPin = SPI1P & (1 << 29);
+        _current = &t;
+        SPI1S = (SPI1S & ~SPISTRIS) | SPISTRIE;
+        startTransaction(&t);
+    }
+    ETS_SPI_INTR_ENABLE();
+    return true;
+}
+
+size_t SPIClass::queued() {
+    size_t n = 0;
+    for (SPITransaction * q = _head; q; q = q->_next) {
+        n += q->pending;
+    }
+    return n;
+}
+
+void SPIClass::flushQueue() {
+    while (_current) {
+        optimistic_yield(1000);
+    }
+}
+
+// Runs the callbacks of the completed transactions, from CONT
+bool SPIClass::pollQueue() {
+    while (_head && !_head->pending) {
+        SPITransaction * t = _head;
+        _head = t->_next;
+        if (!_head) {
+            _tail = nullptr;
+        }
+        if (t->onDone) {
+            t->onDone(*t);
+        }
+    }
+    if (!_head) {
+        _polling = false;
+    }
+    return _polling;
+}
+
+void ICACHE_RAM_ATTR SPIClass::startTransaction(SPITransaction * t) {
+    if(t->_clock == 0x80000000) {
+        GPMUX |= (1 << 9);
+    } else {
+        GPMUX &= ~(1 << 9);
+    }
+    SPI1CLK = t->_clock;
+    SPI1C = (SPI1C & ~(SPICWBO | SPICRBO)) | t->_ctrl;
+    SPI1U = (SPI1U & ~SPIUSME) | t->_user;
+    SPI1P = (SPI1P & ~(1 << 29)) | t->_pin;
+    if (t->csPin >= 0) {
+        digitalWrite(t->csPin, LOW);
+    }
+    t->_pos = 0;
+    startChunk(t);
+}
+
+// Loads the FIFO with the next (up to) 64 bytes and starts them
+void ICACHE_RAM_ATTR SPIClass::startChunk(SPITransaction * t) {
+    uint32_t size = std::min(t->size - t->_pos, (uint32_t)64);
+    // setDataBits(), which may not be in IRAM
+    const uint32_t mask = ~((SPIMMOSI << SPILMOSI) | (SPIMMISO << SPILMISO));
+    const uint32_t bits = size * 8 - 1;
+    SPI1U1 = ((SPI1U1 & mask) | ((bits << SPILMOSI) | (bits << SPILMISO)));
+    volatile uint32_t * fifoPtr = &SPI1W0;
+    uint32_t words = (size + 3) / 4;
+    const uint8_t * out = t->out ? t->out + t->_pos : nullptr;
+    if (!out) {
+        while (words--) {
+            *(fifoPtr++) = 0xFFFFFFFF;
+        }
+    } else if (!((uint32_t)out & 3)) {
+        const uint32_t * dataPtr = (const uint32_t *)out;
+        while (words--) {
+            *(fifoPtr++) = *(dataPtr++);
+        }
+    } else {
+        // Misaligned, out is in RAM
+        for (uint32_t i = 0; i < words; i++) {
+            *(fifoPtr++) = out[4 * i] | (out[4 * i + 1] << 8) | (out[4 * i + 2] << 16) | (out[4 * i + 3] << 24);
+        }
+    }
+    __sync_synchronize();
+    SPI1CMD |= SPIBUSY;
+}
+
+void ICACHE_RAM_ATTR SPIClass::onInterrupt(void * arg) {
+    if (!(SPIIR & (1 << SPII1))) {
+        return;
+    }
+    SPI1S &= ~SPISTRIS;
+    SPIClass * self = (SPIClass *)arg;
+    SPITransaction * t = self->_current;
+    if (!t || (SPI1CMD & SPIBUSY)) {
+        return; // not ours: a synchronous transfer
+    }
+
+    uint32_t size = std::min(t->size - t->_pos, (uint32_t)64);
+    if (t->in) {
+        volatile uint8_t * fifoPtrB = (volatile uint8_t *)&SPI1W0;
+        uint8_t * in = t->in + t->_pos;
+        for (uint32_t i = 0; i < size; i++) {
+            in[i] = fifoPtrB[i];
+        }
+    }
+    t->_pos += size;
+    if (t->_pos < t->size) {
+        self->startChunk(t);
+        return;
+    }
+
+    if (t->csPin >= 0) {
+        digitalWrite(t->csPin, HIGH);
+    }
+    // Move along first: CONT may recycle t as soon as it is not pending
+    SPITransaction * next = t->_next;
+    if (next) {
+        self->_current = next;
+        t->pending = false;
+        self->startTransaction(next);
+        return;
+    }
+    // Drained: back to the synchronous calls' settings, with the done
+    // interrupt off so that their transfers don't come here
+    SPI1S &= ~(SPISTRIE | SPISTRIS);
+    GPMUX = (GPMUX & ~(1 << 9)) | self->_savedMux;
+    SPI1CLK = self->_savedClock;
+    SPI1C = (SPI1C & ~(SPICWBO | SPICRBO)) | self->_savedCtrl;
+    SPI1U = (SPI1U & ~SPIUSME) | self->_savedUser;
+    SPI1P = (SPI1P & ~(1 << 29)) | self->_savedPin;
+    self->_current = nullptr;
+    t->pending = false;
+}
 
 #if !defined(NO_GLOBAL_INSTANCES) && !defined(NO_GLOBAL_SPI)
 SPIClass SPI;
@@ -23,6 +23,7 @@
 
 #include <Arduino.h>
 #include <stdlib.h>
+#include <functional>
 
 #define SPI_HAS_TRANSACTION 1
 
@@ -50,6 +51,29 @@ public:
   uint8_t  _dataMode;
 };
 
+// A transfer run in the background by SPIClass::queue(): csPin (if any) is
+// driven low, size bytes are sent from out (0xff when nullptr) while the
+// received ones are stored into in (unless nullptr), then csPin goes high
+// and onDone is called from loop context. The transaction and its buffers
+// belong to the queue until then.
+struct SPITransaction {
+  SPISettings settings;
+  int8_t csPin = -1;
+  const uint8_t * out = nullptr;
+  uint8_t * in = nullptr;
+  uint32_t size = 0;
+  std::function<void(SPITransaction&)> onDone;
+  volatile bool pending = false;
+
+  // Internal, prepared by SPIClass::queue()
+  uint32_t _clock;
+  uint32_t _ctrl;
+  uint32_t _user;
+  uint32_t _pin;
+  uint32_t _pos;
+  SPITransaction * _next;
+};
+
 class SPIClass {
 public:
   SPIClass();
@@ -74,9 +98,33 @@ public:
   void writePattern(const uint8_t * data, uint8_t size, uint32_t repeat);
   void transferBytes(const uint8_t * out, uint8_t * in, uint32_t size);
   void endTransaction(void);
+
+  // Runs transactions one after the other from the HSPI interrupt, 64 bytes
+  // per interrupt, returns false if t is already queued or empty
+  bool queue(SPITransaction& t);
+  // Transactions not completed
+  size_t queued();
+  // Waits for the queue to be empty, the settings of the synchronous calls
+  // are back once it is
+  void flushQueue();
 private:
   bool useHwCs;
   uint8_t pinSet;
+  SPITransaction * _head;
+  SPITransaction * _tail;
+  SPITransaction * volatile _current;
+  bool _polling;
+  bool _isrAttached;
+  // Registers of the synchronous calls, put back when the queue drains
+  uint32_t _savedClock;
+  uint32_t _savedMux;
+  uint32_t _savedCtrl;
+  uint32_t _savedUser;
+  uint32_t _savedPin;
+  static void ICACHE_RAM_ATTR onInterrupt(void * arg);
+  void ICACHE_RAM_ATTR startChunk(SPITransaction * t);
+  void ICACHE_RAM_ATTR startTransaction(SPITransaction * t);
+  bool pollQueue();
   void writeBytes_(const uint8_t * data, uint8_t size);
   void transferBytes_(const uint8_t * out, uint8_t * in, uint8_t size);
   void transferBytesAligned_(const uint8_t * out, uint8_t * in, uint8_t size);
@@ -0,0 +1,52 @@
+// Wire Async Reader
+
+// Reads a register of an I2C sensor in the background: the transaction is
+// clocked by the timer1 interrupt while loop() keeps running, and its
+// callback prints the result from loop context.
+// Any slave answering 2 bytes works, an LM75 temperature sensor at 0x48 is
+// used here.
+
+// This example code is in the public domain.
+
+
+#include <Wire.h>
+#include <twi.h>
+#include <PolledTimeout.h>
+
+#define SDA_PIN 4
+#define SCL_PIN 5
+const int16_t I2C_SLAVE = 0x48;
+
+uint8_t reg = 0x00;
+uint8_t temp[2];
+uint32_t loops;
+
+void printTemp(twi_async_t* t) {
+  if (t->status == 0) {
+    Serial.printf("%.1f C, %u loops meanwhile\n", (int16_t)((temp[0] << 8) | temp[1]) / 256.0, loops);
+  } else {
+    Serial.printf("error %u\n", t->status);
+  }
+}
+
+twi_async_t readTemp = { I2C_SLAVE, &reg, 1, temp, 2, printTemp, nullptr, 0, nullptr };
+
+void setup() {
+  Serial.begin(115200);
+  Wire.begin(SDA_PIN, SCL_PIN);
+  Wire.setClock(50000);  // the fastest clock of asynchronous transactions
+}
+
+void loop() {
+  using periodic = esp8266::polledTimeout::periodicMs;
+  static periodic nextRead(1000);
+
+  loops++;
+  if (nextRead && readTemp.status != TWI_ASYNC_PENDING) {
+    loops = 0;
+    if (!twi_queue(&readTemp)) {
+      // timer1 is used by something else (see setTimer1Callback())
+      Serial.println("busy");
+    }
+  }
+}
@@ -0,0 +1,52 @@
+/*
+  Records A0 at 500 samples per second and prints, every second, the
+  statistics of the readings, then a short burst taken with WiFi off.
+
+  Released to the public domain
+*/
+
+#include <ESP8266WiFi.h>
+#include <adc_sampler.h>
+
+uint32_t last;
+
+void printStats(const char* what) {
+  adc_sampler_stats_t stats;
+  adc_sampler_stats(&stats);
+  Serial.printf("%s: %u/s, %u samples, %u dropped, min %u max %u mean %u\n",
+                what, stats.rate, stats.samples, stats.dropped,
+                stats.min, stats.max, stats.mean);
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println();
+
+  // Burst: the fastest readings, WiFi must be off
+  WiFi.forceSleepBegin();
+  delay(1);
+  adc_sampler_begin(0, 1024);
+  adc_sampler_burst(1000, 8);
+  printStats("burst");
+  WiFi.forceSleepWake();
+
+  if (!adc_sampler_begin(500, 256)) {
+    Serial.println("cannot sample at this rate");
+  }
+  last = millis();
+}
+
+void loop() {
+  // Readings are taken while loop() returns or yields: empty the ring
+  // often enough that it doesn't fill up
+  uint16_t samples[64];
+  while (adc_sampler_read(samples, 64)) {
+    // process the samples
+  }
+
+  if (millis() - last >= 1000) {
+    last += 1000;
+    printStats("paced");
+    adc_sampler_reset_stats();
+  }
+}
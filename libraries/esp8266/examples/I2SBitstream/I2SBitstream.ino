@@ -0,0 +1,40 @@
+/*
+   WS2812 LED strip driven by the I2S DMA bitstream, no CPU time per bit
+   and no interrupt latency issue with WiFi running.
+
+   Connect the strip data input to GPIO3 (RX0), Serial can only transmit.
+
+   Released to the Public Domain
+*/
+
+#include <i2s.h>
+
+#define LEDS 30
+
+uint8_t pixels[LEDS * 3]; // G, R, B
+
+void setup() {
+  Serial.begin(115200, SERIAL_8N1, SERIAL_TX_ONLY);
+
+  // 3 bits per data bit at 2.4Mbit/s: 0 => 100 (417ns high), 1 => 110 (833ns high)
+  i2s_bitstream_begin(2400000, false);
+  Serial.printf("bit rate %u\n", i2s_bitstream_get_rate());
+}
+
+void loop() {
+  static uint8_t hue;
+  for (int i = 0; i < LEDS; i++) {
+    uint8_t v = hue + i * 8;
+    pixels[i * 3 + 0] = v < 128 ? v : 255 - v;
+    pixels[i * 3 + 1] = v < 128 ? 127 - v : v - 128;
+    pixels[i * 3 + 2] = 16;
+  }
+  hue++;
+
+  // Wait for the previous frame and the reset time (DMA sends low when idle)
+  while (!i2s_is_empty()) {
+    yield();
+  }
+  i2s_bitstream_write_encoded(pixels, sizeof(pixels), 3, 0b100, 0b110);
+  delay(20);
+}
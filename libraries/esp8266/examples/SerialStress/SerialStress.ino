@@ -180,6 +180,9 @@ void loop() {
     int bwkbps_avg = ((((uint64_t)in_total) * 8000) / (now_ms - start_ms)) >> 10;
     int bwkbps_now = (((in_total - in_prev) * 8000) / (now_ms - last_ms)) >> 10 ;
     logger->printf("bwavg=%d bwnow=%d kbps maxavail=%i\n", bwkbps_avg, bwkbps_now, maxavail);
+    uart_rx_stats_t stats = Serial.getRxStats();
+    logger->printf("dropped=%u fifo_overflows=%u peak=%u isr_max=%uus\n",
+                   stats.dropped, stats.fifo_overflows, stats.peak, stats.isr_max_cycles / ESP.getCpuFreqMHz());
 
     in_prev = in_total;
     timeout = (last_ms = now_ms) + TIMEOUT;
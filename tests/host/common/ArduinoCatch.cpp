@@ -18,3 +18,7 @@
 #include <sys/time.h>
 #include "Arduino.h"
 
+
+extern "C" void esp_schedule()
+{
+}
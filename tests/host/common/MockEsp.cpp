@@ -36,6 +36,9 @@
 
 #include <stdlib.h>
 
+#include <map>
+#include <vector>
+
 unsigned long long operator"" _kHz(unsigned long long x) {
     return x * 1000;
 }
@@ -142,9 +145,20 @@ void EspClass::getHeapStats(uint32_t* hfree, uint16_t* hmax, uint8_t* hfrag) {
   if (hfrag) *hfrag = 100 - (sqrt(hm) * 100) / hf;
 }
 
+// Flash is emulated sector by sector, sectors never written read as erased
+static std::map<uint32_t, std::vector<uint8_t>> mockFlash;
+
+static uint8_t* mockFlashSector (uint32_t sector)
+{
+	auto& data = mockFlash[sector];
+	if (data.empty())
+		data.resize(FLASH_SECTOR_SIZE, 0xff);
+	return data.data();
+}
+
 bool EspClass::flashEraseSector(uint32_t sector)
 {
-	(void) sector;
+	memset(mockFlashSector(sector), 0xff, FLASH_SECTOR_SIZE);
 	return true;
 }
 
@@ -161,17 +175,18 @@ FlashMode_t EspClass::magicFlashChipMode(uint8_t byte)
 
 bool EspClass::flashWrite(uint32_t offset, uint32_t *data, size_t size)
 {
-	(void)offset;
-	(void)data;
-	(void)size;
+	// like real flash, writing can only clear bits
+	const uint8_t* src = (const uint8_t*)data;
+	for (size_t i = 0; i < size; i++, offset++)
+		mockFlashSector(offset / FLASH_SECTOR_SIZE)[offset % FLASH_SECTOR_SIZE] &= src[i];
 	return true;
 }
 
 bool EspClass::flashRead(uint32_t offset, uint32_t *data, size_t size)
 {
-	(void)offset;
-	(void)data;
-	(void)size;
+	uint8_t* dst = (uint8_t*)data;
+	for (size_t i = 0; i < size; i++, offset++)
+		dst[i] = mockFlashSector(offset / FLASH_SECTOR_SIZE)[offset % FLASH_SECTOR_SIZE];
 	return true;
 }
 
@@ -61,6 +61,7 @@ struct uart_
 	bool tx_enabled;
 	bool rx_overrun;
 	struct uart_rx_buffer_ * rx_buffer;
+	size_t tx_buffer_size; // writes are never buffered on host
 };
 
 bool serial_timestamp = false;
@@ -251,6 +252,46 @@ uart_get_rx_buffer_size(uart_t* uart)
 	return uart && uart->rx_enabled ? uart->rx_buffer->size : 0;
 }
 
+void
+uart_set_rx_thresholds(uart_t* uart, uint8_t fifo_full, uint8_t timeout)
+{
+	(void) uart;
+	(void) fifo_full;
+	(void) timeout;
+}
+
+bool
+uart_get_rx_stats(uart_t* uart, uart_rx_stats_t* stats)
+{
+	if(uart == NULL || !uart->rx_enabled)
+		return false;
+
+	memset(stats, 0, sizeof(*stats));
+	return true;
+}
+
+void
+uart_reset_rx_stats(uart_t* uart)
+{
+	(void) uart;
+}
+
+size_t
+uart_resize_tx_buffer(uart_t* uart, size_t new_size)
+{
+	if(uart == NULL || !uart->tx_enabled)
+		return 0;
+
+	uart->tx_buffer_size = new_size == 1? 0: new_size;
+	return uart->tx_buffer_size;
+}
+
+size_t
+uart_get_tx_buffer_size(uart_t* uart)
+{
+	return uart ? uart->tx_buffer_size : 0;
+}
+
 size_t
 uart_write_char(uart_t* uart, char c)
 {
@@ -282,7 +323,7 @@ uart_tx_free(uart_t* uart)
 	if(uart == NULL || !uart->tx_enabled)
 		return 0;
 
-	return UART_TX_FIFO_SIZE;
+	return UART_TX_FIFO_SIZE + uart->tx_buffer_size;
 }
 
 void
@@ -343,6 +384,7 @@ uart_init(int uart_nr, int baudrate, int config, int mode, int tx_pin, size_t rx
 
 	uart->uart_nr = uart_nr;
 	uart->rx_overrun = false;
+	uart->tx_buffer_size = 0;
 
 	switch(uart->uart_nr)
 	{
@@ -3,6 +3,8 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "flash_hal_mock.h"
+
 extern "C"
 {
     uint32_t s_phys_addr = 0;
@@ -12,12 +14,18 @@ extern "C"
     uint8_t* s_phys_data = nullptr;
 }
 
+flash_hal_mock_stats s_phys_stats;
+
 int32_t flash_hal_read(uint32_t addr, uint32_t size, uint8_t *dst) {
+    s_phys_stats.reads++;
+    s_phys_stats.readBytes += size;
     memcpy(dst, s_phys_data + addr, size);
     return 0;
 }
 
 int32_t flash_hal_write(uint32_t addr, uint32_t size, const uint8_t *src) {
+    s_phys_stats.writes++;
+    s_phys_stats.writeBytes += size;
     memcpy(s_phys_data + addr, src, size);
     return 0;
 }
@@ -29,6 +37,7 @@ int32_t flash_hal_erase(uint32_t addr, uint32_t size) {
     }
     const uint32_t sector = addr / FLASH_SECTOR_SIZE;
     const uint32_t sectorCount = size / FLASH_SECTOR_SIZE;
+    s_phys_stats.erases += sectorCount;
     for (uint32_t i = 0; i < sectorCount; ++i) {
         memset(s_phys_data + (sector + i) * FLASH_SECTOR_SIZE, 0xff, FLASH_SECTOR_SIZE);
     }
@@ -12,6 +12,18 @@ extern "C"
     extern uint8_t* s_phys_data;
 }
 
+// Flash operations done through the HAL, for benchmarks
+struct flash_hal_mock_stats
+{
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t erases; // sectors
+    uint64_t readBytes;
+    uint64_t writeBytes;
+};
+
+extern flash_hal_mock_stats s_phys_stats;
+
 extern int32_t flash_hal_read(uint32_t addr, uint32_t size, uint8_t *dst);
 extern int32_t flash_hal_write(uint32_t addr, uint32_t size, const uint8_t *src);
 extern int32_t flash_hal_erase(uint32_t addr, uint32_t size);
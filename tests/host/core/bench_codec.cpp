@@ -0,0 +1,116 @@
+/*
+ bench_codec.cpp - base64 and base16 benchmarks for host side testing
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+// Encodes and decodes a 48 byte auth header sized blob and a 4KB sensor
+// blob, printing one JSON object per line:
+//   {"test":"base64_encode","impl":"libb64","bytes":4096,"us":1.2,"MBps":340.0}
+// "bytes" is the size of the binary data, "us" the time per call.
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <base64.h>
+#include <base16.h>
+#include <libb64/cencode.h>
+#include <libb64/cdecode.h>
+
+#define TOTAL (16 << 20) // bytes processed per test
+
+typedef void (*Workload)(const std::vector<uint8_t>& data, std::string& text, std::vector<uint8_t>& out);
+
+static void libb64Encode(const std::vector<uint8_t>& data, std::string& text, std::vector<uint8_t>&)
+{
+    base64_encodestate state;
+    base64_init_encodestate_nonewlines(&state);
+    int len = base64_encode_block((const char*)data.data(), data.size(), &text[0], &state);
+    base64_encode_blockend(&text[len], &state);
+}
+
+static void base64Encode(const std::vector<uint8_t>& data, std::string& text, std::vector<uint8_t>&)
+{
+    base64::encode(data.data(), data.size(), &text[0], text.size());
+}
+
+static void base64EncodeString(const std::vector<uint8_t>& data, std::string&, std::vector<uint8_t>&)
+{
+    String s = base64::encode(data.data(), data.size(), false);
+}
+
+static void libb64Decode(const std::vector<uint8_t>&, std::string& text, std::vector<uint8_t>& out)
+{
+    base64_decode_chars(text.c_str(), strlen(text.c_str()), (char*)out.data());
+}
+
+static void base64Decode(const std::vector<uint8_t>&, std::string& text, std::vector<uint8_t>& out)
+{
+    base64::decode(text.c_str(), strlen(text.c_str()), out.data(), out.size());
+}
+
+static void sprintfHex(const std::vector<uint8_t>& data, std::string& text, std::vector<uint8_t>&)
+{
+    // what MD5Builder::getChars() did
+    for (size_t i = 0; i < data.size(); i++)
+        sprintf(&text[2 * i], "%02x", data[i]);
+}
+
+static void base16Encode(const std::vector<uint8_t>& data, std::string& text, std::vector<uint8_t>&)
+{
+    base16::encode(data.data(), data.size(), &text[0]);
+}
+
+static void base16Decode(const std::vector<uint8_t>& data, std::string& text, std::vector<uint8_t>& out)
+{
+    base16::decode(text.c_str(), 2 * data.size(), out.data(), out.size());
+}
+
+static void run(const char* test, const char* impl, Workload workload, size_t size)
+{
+    std::vector<uint8_t> data(size), out(size + 3);
+    uint32_t seed = 1;
+    for (auto& b : data)
+    {
+        seed = seed * 1103515245 + 12345;
+        b = seed >> 16;
+    }
+    std::string text(2 * size + 1, 0);
+    if (strncmp(test, "base64", 6) == 0)
+        base64::encode(data.data(), size, &text[0], text.size());
+    else
+        base16::encode(data.data(), size, &text[0]);
+
+    size_t rounds = TOTAL / size;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; i++)
+        workload(data, text, out);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    printf("{\"test\":\"%s\",\"impl\":\"%s\",\"bytes\":%zu,\"us\":%.3f,\"MBps\":%.1f}\n",
+           test, impl, size, ns / 1000.0 / rounds, ns ? (double)size * rounds * 1000 / ns : 0.0);
+}
+
+int main ()
+{
+    for (size_t size : { 48, 4096 })
+    {
+        run("base64_encode", "libb64", libb64Encode, size);
+        run("base64_encode", "base64", base64Encode, size);
+        run("base64_encode_string", "base64", base64EncodeString, size);
+        run("base64_decode", "libb64", libb64Decode, size);
+        run("base64_decode", "base64", base64Decode, size);
+        run("base16_encode", "sprintf", sprintfHex, size);
+        run("base16_encode", "base16", base16Encode, size);
+        run("base16_decode", "base16", base16Decode, size);
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ bench_crc32.cpp - crc32() benchmark for host side testing
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+// Hashes a 1MB image, like checkFlashCRC() does at boot, and 64 byte log
+// records with every table size, printing one JSON object per line:
+//   {"test":"image","slices":4,"bytes":1048576,"us":1234,"MBps":850.0}
+// "slices":0 is the former bit by bit implementation.
+
+#include <chrono>
+#include <vector>
+#include <coredecls.h>
+#include <pgmspace.h>
+
+namespace bitwise
+{
+static uint32_t crc32 (const void* data, size_t length, uint32_t crc = 0xffffffff)
+{
+    const uint8_t* ldata = (const uint8_t*)data;
+    while (length--)
+    {
+        uint8_t c = pgm_read_byte(ldata++);
+        for (uint32_t i = 0x80; i > 0; i >>= 1)
+        {
+            bool bit = crc & 0x80000000;
+            if (c & i)
+                bit = !bit;
+            crc <<= 1;
+            if (bit)
+                crc ^= 0x04c11db7;
+        }
+    }
+    return crc;
+}
+}
+
+#define CRC32_SLICES 1
+namespace slices1
+{
+#include "../../../cores/esp8266/crc32.cpp"
+}
+#undef CRC32_SLICES
+#define CRC32_SLICES 4
+namespace slices4
+{
+#include "../../../cores/esp8266/crc32.cpp"
+}
+#undef CRC32_SLICES
+#define CRC32_SLICES 8
+namespace slices8
+{
+#include "../../../cores/esp8266/crc32.cpp"
+}
+
+typedef uint32_t (*Crc32)(const void*, size_t, uint32_t);
+
+static void bench(const char* test, int slices, Crc32 fn, const std::vector<uint8_t>& data, size_t chunk, uint32_t expected)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < data.size(); i += chunk)
+        crc = chunk == data.size()? fn(&data[i], chunk, crc): fn(&data[i], chunk, 0xffffffff);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+    if (crc != expected)
+        fprintf(stderr, "%s slices %d: wrong crc %08x\n", test, slices, crc);
+    printf("{\"test\":\"%s\",\"slices\":%d,\"bytes\":%zu,\"us\":%lld,\"MBps\":%.1f}\n",
+           test, slices, data.size(), (long long)us, us? data.size() / (double)us: 0.0);
+}
+
+int main ()
+{
+    std::vector<uint8_t> image(1 << 20);
+    uint32_t seed = 1;
+    for (auto& b : image)
+    {
+        seed = seed * 1103515245 + 12345;
+        b = seed >> 16;
+    }
+
+    const struct { int slices; Crc32 fn; } impls[] = {
+        { 0, bitwise::crc32 },
+        { 1, slices1::crc32 },
+        { 4, slices4::crc32 },
+        { 8, slices8::crc32 },
+    };
+    uint32_t imageCrc = bitwise::crc32(image.data(), image.size());
+    uint32_t lastRecordCrc = bitwise::crc32(&image[image.size() - 64], 64);
+    for (const auto& impl : impls)
+    {
+        bench("image", impl.slices, impl.fn, image, image.size(), imageCrc);
+        bench("records_64", impl.slices, impl.fn, image, 64, lastRecordCrc);
+    }
+    return 0;
+}
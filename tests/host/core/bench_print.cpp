@@ -0,0 +1,146 @@
+/*
+ bench_print.cpp - Print formatting benchmarks for host side testing
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+// Formats typical log lines into a Print that drops the data, and prints one
+// JSON object per line:
+//   {"test":"log_short","impl":"vsnprintf","bytes":42,"ns":120.5,"writes":1,"allocs":0}
+// "ns", "writes" (calls to the Print) and "allocs" are per line. "vsnprintf"
+// is the former printf(): format into 64 bytes, allocate and format again
+// when longer.
+
+#include <chrono>
+#include <Print.h>
+
+#define ROUNDS 200000
+
+class NullPrint: public Print
+{
+public:
+    size_t write(uint8_t) override
+    {
+        writes++;
+        bytes++;
+        return 1;
+    }
+    size_t write(const uint8_t*, size_t size) override
+    {
+        writes++;
+        bytes += size;
+        return size;
+    }
+    size_t writes = 0;
+    size_t bytes = 0;
+};
+
+static size_t allocs;
+
+static size_t baselinePrintf(Print& out, const char *format, ...)
+{
+    va_list arg;
+    va_start(arg, format);
+    char temp[64];
+    char* buffer = temp;
+    size_t len = vsnprintf(temp, sizeof(temp), format, arg);
+    va_end(arg);
+    if (len > sizeof(temp) - 1) {
+        buffer = new char[len + 1];
+        allocs++;
+        va_start(arg, format);
+        vsnprintf(buffer, len + 1, format, arg);
+        va_end(arg);
+    }
+    len = out.write((const uint8_t*) buffer, len);
+    if (buffer != temp) {
+        delete[] buffer;
+    }
+    return len;
+}
+
+static const char* name = "temperature";
+
+static void logShort(NullPrint& out, bool baseline, int i)
+{
+    if (baseline)
+        baselinePrintf(out, "%lu ms: %s=%d status %s\r\n", 1000UL + i, name, i & 255, "ok");
+    else
+        out.printf("%lu ms: %s=%d status %s\r\n", 1000UL + i, name, i & 255, "ok");
+}
+
+static void logLong(NullPrint& out, bool baseline, int i)
+{
+    if (baseline)
+        baselinePrintf(out, "{\"t\":%lu,\"id\":\"%08x\",\"rssi\":%d,\"heap\":%u,\"uptime\":%lu,\"name\":\"%s\",\"count\":%d}\r\n",
+                       1000UL + i, 0xdeadbeef ^ i, -60 - (i & 15), 40000u - i % 1000, 123456UL + i, name, i);
+    else
+        out.printf("{\"t\":%lu,\"id\":\"%08x\",\"rssi\":%d,\"heap\":%u,\"uptime\":%lu,\"name\":\"%s\",\"count\":%d}\r\n",
+                   1000UL + i, 0xdeadbeef ^ i, -60 - (i & 15), 40000u - i % 1000, 123456UL + i, name, i);
+}
+
+static void logFloats(NullPrint& out, bool baseline, int i)
+{
+    double x = i * 0.001;
+    if (baseline)
+        baselinePrintf(out, "%.3f,%.3f,%.2f\r\n", x, -x * 3.7, 20.0 + x);
+    else
+        out.printf("%.3f,%.3f,%.2f\r\n", x, -x * 3.7, 20.0 + x);
+}
+
+static void printNumbers(NullPrint& out, bool, int i)
+{
+    out.print((long)i * 12345);
+    out.print(',');
+    out.print((unsigned long)i, HEX);
+    out.print(',');
+    out.println(-(long)i);
+}
+
+static void printFloats(NullPrint& out, bool, int i)
+{
+    out.print(i * 0.001, 3);
+    out.print(',');
+    out.println(-i * 0.0037, 3);
+}
+
+typedef void (*Workload)(NullPrint&, bool, int);
+
+static void run(const char* test, const char* impl, Workload workload, bool baseline)
+{
+    NullPrint out;
+    allocs = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++)
+        workload(out, baseline, i);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    printf("{\"test\":\"%s\",\"impl\":\"%s\",\"bytes\":%zu,\"ns\":%.1f,\"writes\":%.2f,\"allocs\":%.2f}\n",
+           test, impl, out.bytes / ROUNDS, (double)ns / ROUNDS, (double)out.writes / ROUNDS, (double)allocs / ROUNDS);
+}
+
+int main ()
+{
+    const struct { const char* test; Workload workload; bool compare; } tests[] = {
+        { "log_short", logShort, true },
+        { "log_long", logLong, true },
+        { "log_floats", logFloats, true },
+        { "print_numbers", printNumbers, false },
+        { "print_floats", printFloats, false },
+    };
+    for (const auto& t : tests)
+    {
+        if (t.compare)
+            run(t.test, "vsnprintf", t.workload, true);
+        run(t.test, "Print", t.workload, false);
+    }
+    return 0;
+}
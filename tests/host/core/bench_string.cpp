@@ -0,0 +1,116 @@
+/*
+ bench_string.cpp - String building benchmarks for host side testing
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+// Builds a 4KB response out of small pieces the way web server and JSON code
+// does, and prints one JSON object per line:
+//   {"test":"concat_geometric","piece":32,"bytes":4096,"us":12,"reallocs":14}
+// "reallocs" counts buffer (re)allocations of the String (or chunk
+// allocations of the StringBuilder) for one build.
+
+#include <chrono>
+#include <WString.h>
+#include <StringBuilder.h>
+
+#define RESPONSE_SIZE 4096
+#define ROUNDS        1000
+
+// Gives access to the buffer capacity
+class ProbeString: public String {
+public:
+    unsigned int cap() const { return buffer() ? capacity() : 0; }
+};
+
+static char piece[256];
+
+typedef unsigned int (*Workload)(size_t pieceLen);
+
+// What every append did before the geometric growth policy: make exactly
+// enough room for the new length
+static unsigned int concatExact (size_t pieceLen)
+{
+    ProbeString s;
+    unsigned int reallocs = 0, cap = s.cap();
+    while (s.length() < RESPONSE_SIZE)
+    {
+        s.reserve(s.length() + pieceLen);
+        s.concat(piece, pieceLen);
+        if (s.cap() != cap)
+        {
+            reallocs++;
+            cap = s.cap();
+        }
+    }
+    return reallocs;
+}
+
+static unsigned int concatGeometric (size_t pieceLen)
+{
+    ProbeString s;
+    unsigned int reallocs = 0, cap = s.cap();
+    while (s.length() < RESPONSE_SIZE)
+    {
+        s.concat(piece, pieceLen);
+        if (s.cap() != cap)
+        {
+            reallocs++;
+            cap = s.cap();
+        }
+    }
+    s.shrink_to_fit();
+    return reallocs + 1;
+}
+
+static unsigned int concatReserved (size_t pieceLen)
+{
+    String s;
+    s.reserve(RESPONSE_SIZE + pieceLen);
+    while (s.length() < RESPONSE_SIZE)
+        s.concat(piece, pieceLen);
+    return 1;
+}
+
+static unsigned int builder (size_t pieceLen)
+{
+    StringBuilder b;
+    while (b.length() < RESPONSE_SIZE)
+        b.write((const uint8_t*)piece, pieceLen);
+    String s = b.toString();
+    return (b.length() + 255) / 256 + 1;
+}
+
+static void run (const char* name, Workload workload, size_t pieceLen)
+{
+    unsigned int reallocs = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++)
+        reallocs = workload(pieceLen);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+    printf("{\"test\":\"%s\",\"piece\":%zu,\"bytes\":%d,\"us\":%.2f,\"reallocs\":%u}\n",
+           name, pieceLen, RESPONSE_SIZE, (double)us / ROUNDS, reallocs);
+}
+
+int main ()
+{
+    for (size_t i = 0; i < sizeof(piece); i++)
+        piece[i] = 'a' + i % 26;
+    for (size_t pieceLen: { 1, 8, 32, 128 })
+    {
+        run("concat_exact", concatExact, pieceLen);
+        run("concat_geometric", concatGeometric, pieceLen);
+        run("concat_reserved", concatReserved, pieceLen);
+        run("string_builder", builder, pieceLen);
+    }
+    return 0;
+}
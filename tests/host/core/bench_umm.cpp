@@ -0,0 +1,241 @@
+/*
+ bench_umm.cpp - umm_malloc benchmarks for host side testing
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+// Replays allocation traces through the firmware's umm_malloc (TEST_BUILD,
+// 64KB heap) and prints one JSON object per trace:
+//   {"allocator":"umm_size_classes","trace":"synthetic","ops":200000,
+//    "us":..,"malloc_p50_ns":..,"malloc_p99_ns":..,"malloc_max_ns":..,"free_max_ns":..,"realloc_max_ns":..,
+//    "size_class_hits":..,"size_class_misses":..,"size_class_flushes":..,
+//    "failed":..,"free_heap":..,"max_free_block":..}
+// The *_max_ns figures come from UMM_CRITICAL_METRICS (time_stats), i.e. the
+// longest time interrupts would have been masked, the percentiles are timed
+// around each malloc() call.
+//
+// Usage: bench_umm [trace...]
+// A trace is a text file with one operation per line, ids are arbitrary:
+//   m <id> <size>      malloc
+//   r <id> <size>      realloc
+//   f <id>             free
+// Without arguments a synthetic trace modelled on a web server sketch is
+// used (short Strings, pbuf headers, std::function captures, a few large
+// buffers). bench_umm_baseline is the same program with the size class
+// cache disabled.
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+// Host replacements for what umm_malloc expects from the SDK
+#define ets_memcpy  memcpy
+#define ets_memmove memmove
+#define ets_memset  memset
+#define ets_strcpy  strcpy
+#define ets_strlen  strlen
+#define ets_vprintf(putc, fmt, ap) vprintf(fmt, ap)
+#define ets_uart_printf printf
+
+static uint32_t esp_get_cycle_count ()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+#define TEST_BUILD
+#define UMM_CRITICAL_METRICS
+// The allocator is renamed so that the host one keeps working
+#define malloc  bench_umm_malloc
+#define calloc  bench_umm_calloc
+#define realloc bench_umm_realloc
+#define free    bench_umm_free
+#include "../../../cores/esp8266/umm_malloc/umm_malloc.cpp"
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+
+char test_umm_heap[UMM_MALLOC_CFG_HEAP_SIZE];
+int umm_critical_depth;
+int umm_max_critical_depth;
+
+#ifndef UMM_BENCH_NAME
+#define UMM_BENCH_NAME "umm_size_classes"
+#endif
+
+struct Op
+{
+    char op;
+    uint32_t id;
+    uint32_t size;
+};
+
+static bool loadTrace (const char* path, std::vector<Op>& ops)
+{
+    FILE* f = fopen(path, "r");
+    if (!f)
+    {
+        fprintf(stderr, "%s: can not open\n", path);
+        return false;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), f))
+    {
+        Op op = { 0, 0, 0 };
+        if (sscanf(line, " %c %u %u", &op.op, &op.id, &op.size) >= 2 && strchr("mrf", op.op))
+            ops.push_back(op);
+    }
+    fclose(f);
+    return true;
+}
+
+// Requests of a busy web server: most are small and short lived, a few
+// large buffers live long enough to fragment the heap
+static void syntheticTrace (std::vector<Op>& ops)
+{
+    uint32_t seed = 1;
+    auto rnd = [&seed](uint32_t n) { seed = seed * 1103515245 + 12345; return (seed >> 8) % n; };
+    std::vector<uint32_t> live;
+    uint32_t nextId = 1;
+    for (int i = 0; i < 200000; i++)
+    {
+        uint32_t r = rnd(100);
+        if (live.size() > 200 || (r < 45 && !live.empty()))
+        {
+            size_t k = rnd(live.size());
+            // LIFO most of the time, like stack unwinding
+            if (rnd(4))
+                k = live.size() - 1;
+            ops.push_back({ 'f', live[k], 0 });
+            live[k] = live.back();
+            live.pop_back();
+            continue;
+        }
+        uint32_t size;
+        if (r < 70)
+            size = 12 + rnd(53);        // String SSO overflow, small objects
+        else if (r < 85)
+            size = 16 + 4 * rnd(5);     // std::function captures, pbuf headers
+        else if (r < 97)
+            size = 64 + rnd(256);       // medium Strings
+        else
+            size = 512 + rnd(1536);     // pbuf payloads, response buffers
+        if (r >= 60 && r < 62 && !live.empty())
+        {
+            // Grow an existing String
+            uint32_t id = live[rnd(live.size())];
+            ops.push_back({ 'r', id, size * 2 });
+            continue;
+        }
+        ops.push_back({ 'm', nextId, size });
+        live.push_back(nextId++);
+    }
+    for (uint32_t id: live)
+        ops.push_back({ 'f', id, 0 });
+}
+
+static void replay (const char* name, const std::vector<Op>& ops)
+{
+    umm_init();
+    memset(&time_stats, 0, sizeof(time_stats));
+    time_stats.id_malloc.min = time_stats.id_realloc.min = time_stats.id_free.min = 0xffffffff;
+
+    std::map<uint32_t, void*> ptrs;
+    std::vector<uint32_t> mallocNs;
+    uint32_t failed = 0;
+    mallocNs.reserve(ops.size());
+    auto t0 = std::chrono::steady_clock::now();
+    for (const Op& op: ops)
+    {
+        uint32_t start = esp_get_cycle_count();
+        switch (op.op)
+        {
+        case 'm':
+        {
+            void* p = bench_umm_malloc(op.size);
+            mallocNs.push_back(esp_get_cycle_count() - start);
+            if (p)
+                ptrs[op.id] = p;
+            else
+                failed++;
+            break;
+        }
+        case 'r':
+        {
+            auto it = ptrs.find(op.id);
+            void* p = bench_umm_realloc(it == ptrs.end() ? nullptr : it->second, op.size);
+            if (p)
+                ptrs[op.id] = p;
+            else
+                failed++;
+            break;
+        }
+        case 'f':
+        {
+            auto it = ptrs.find(op.id);
+            if (it != ptrs.end())
+            {
+                bench_umm_free(it->second);
+                ptrs.erase(it);
+            }
+            break;
+        }
+        }
+    }
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+    UMM_TIME_STATS stats = time_stats;
+    // The maximum is disturbed by the host scheduler, the percentiles less so
+    std::sort(mallocNs.begin(), mallocNs.end());
+    auto percentile = [&mallocNs](size_t p) { return mallocNs.empty() ? 0 : mallocNs[(mallocNs.size() - 1) * p / 100]; };
+
+    printf("{\"allocator\":\"%s\",\"trace\":\"%s\",\"ops\":%zu,\"us\":%lld,"
+           "\"malloc_p50_ns\":%u,\"malloc_p99_ns\":%u,"
+           "\"malloc_max_ns\":%u,\"free_max_ns\":%u,\"realloc_max_ns\":%u,",
+           UMM_BENCH_NAME, name, ops.size(), (long long)us,
+           percentile(50), percentile(99),
+           stats.id_malloc.max, stats.id_free.max, stats.id_realloc.max);
+#if defined(UMM_SIZE_CLASSES) && UMM_SIZE_CLASS_DEPTH > 0
+    printf("\"size_class_hits\":%u,\"size_class_misses\":%u,\"size_class_flushes\":%u,",
+           stats.size_class_hits, stats.size_class_misses, stats.size_class_flushes);
+#endif
+    // umm_info() gives the cached blocks back first
+    printf("\"failed\":%u,\"free_heap\":%zu,\"max_free_block\":%zu}\n",
+           failed, umm_free_heap_size(), umm_max_block_size());
+    for (auto& it: ptrs)
+        bench_umm_free(it.second);
+}
+
+int main (int argc, char* argv[])
+{
+    std::vector<Op> ops;
+    if (argc < 2)
+    {
+        syntheticTrace(ops);
+        replay("synthetic", ops);
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        ops.clear();
+        if (!loadTrace(argv[i], ops))
+            return 1;
+        replay(argv[i], ops);
+    }
+    return 0;
+}
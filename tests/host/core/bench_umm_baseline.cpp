@@ -0,0 +1,18 @@
+/*
+ bench_umm_baseline.cpp - umm_malloc benchmarks without the size class cache
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#define UMM_SIZE_CLASS_DEPTH 0
+#define UMM_BENCH_NAME "umm_best_fit"
+#include "bench_umm.cpp"
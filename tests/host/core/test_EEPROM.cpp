@@ -0,0 +1,122 @@
+/*
+ test_EEPROM.cpp - EEPROM journal tests
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <vector>
+
+// The real library, on the flash of MockEsp.cpp
+#define NO_GLOBAL_EEPROM
+#include "../../../libraries/EEPROM/EEPROM.cpp"
+
+static const uint32_t first = 0x180;
+
+static void eraseJournal(uint32_t count)
+{
+    for (uint32_t s = 0; s < count; s++)
+        ESP.flashEraseSector(first + s);
+}
+
+static std::vector<uint8_t> readSector(uint32_t sector)
+{
+    std::vector<uint8_t> data(SPI_FLASH_SEC_SIZE);
+    ESP.flashRead(sector * SPI_FLASH_SEC_SIZE, (uint32_t*)data.data(), data.size());
+    return data;
+}
+
+TEST_CASE("EEPROM journal commits survive begin()", "[core][EEPROM]")
+{
+    eraseJournal(3);
+    {
+        EEPROMClass e(first, 3);
+        e.begin(64);
+        for (int i = 0; i < 64; i++)
+            e.write(i, i);
+        REQUIRE(e.commit());
+        // Enough small commits to fill and wrap the sectors
+        for (int n = 0; n < 1500; n++) {
+            e.put(n % 15 * 4, (uint32_t)n);
+            REQUIRE(e.commit());
+        }
+    }
+    EEPROMClass e(first, 3);
+    e.begin(64);
+    uint32_t value;
+    REQUIRE(e.get(1499 % 15 * 4, value) == 1499);
+    REQUIRE(e.get(1498 % 15 * 4, value) == 1498);
+    REQUIRE(e.read(63) == 63);
+}
+
+TEST_CASE("EEPROM journal ends at a torn record", "[core][EEPROM]")
+{
+    eraseJournal(2);
+    {
+        EEPROMClass e(first, 2);
+        e.begin(64);
+        e.write(0, 1);
+        REQUIRE(e.commit());  // sector header and snapshot, in the second sector
+        e.write(8, 2);
+        REQUIRE(e.commit());  // record of 4 bytes
+        e.write(16, 3);
+        REQUIRE(e.commit());  // torn below
+    }
+    // Power lost while the data of the last record was written
+    const uint32_t torn = (first + 1) * SPI_FLASH_SEC_SIZE + sizeof(EEPROMSectorHeader) +
+                          2 * sizeof(EEPROMRecordHeader) + 64 + 4 + sizeof(EEPROMRecordHeader);
+    uint32_t zero = 0;
+    ESP.flashWrite(torn, &zero, sizeof(zero));
+
+    {
+        EEPROMClass e(first, 2);
+        e.begin(64);
+        REQUIRE(e.read(0) == 1);
+        REQUIRE(e.read(8) == 2);
+        REQUIRE(e.read(16) == 0xff);
+        // Nothing is appended after the torn record
+        e.write(24, 4);
+        REQUIRE(e.commit());
+    }
+    EEPROMClass e(first, 2);
+    e.begin(64);
+    REQUIRE(e.read(8) == 2);
+    REQUIRE(e.read(16) == 0xff);
+    REQUIRE(e.read(24) == 4);
+}
+
+TEST_CASE("EEPROM journal takes over a legacy sector", "[core][EEPROM]")
+{
+    eraseJournal(2);
+    std::vector<uint8_t> legacy(64);
+    for (size_t i = 0; i < legacy.size(); i++)
+        legacy[i] = 0x80 + i;
+    ESP.flashWrite(first * SPI_FLASH_SEC_SIZE, (uint32_t*)legacy.data(), legacy.size());
+    std::vector<uint8_t> before = readSector(first);
+
+    {
+        EEPROMClass e(first, 2);
+        e.begin(64);
+        REQUIRE(e.read(0) == 0x80);
+        REQUIRE(e.read(63) == 0x80 + 63);
+        e.write(1, 0);
+        REQUIRE(e.commit());
+    }
+    // The only copy of the legacy content is kept until the journal holds it
+    REQUIRE(readSector(first) == before);
+
+    EEPROMClass e(first, 2);
+    e.begin(64);
+    REQUIRE(e.read(0) == 0x80);
+    REQUIRE(e.read(1) == 0);
+    REQUIRE(e.read(63) == 0x80 + 63);
+}
@@ -0,0 +1,149 @@
+/*
+ test_FlashHash.cpp - cached and incremental flash hashing tests
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <MD5Builder.h>
+
+// BearSSL is not part of the host build, the flash is the one of MockEsp.cpp
+#define FLASH_HASH_NO_SHA256
+#include "../../../cores/esp8266/FlashHash.cpp"
+
+#define REGION 0x100000
+#define REGION_SIZE (3 * FLASH_SECTOR_SIZE + 100)
+
+static uint8_t image[REGION_SIZE];
+
+static void writeRegion(uint32_t seed)
+{
+    for (size_t i = 0; i < sizeof(image); i++) {
+        image[i] = (seed + i) * 2654435761u >> 24;
+    }
+    for (uint32_t s = 0; s < 4; s++) {
+        ESP.flashEraseSector(REGION / FLASH_SECTOR_SIZE + s);
+    }
+    ESP.flashWrite(REGION, (uint32_t*)image, (sizeof(image) + 3) & ~3);
+    FlashHash.invalidate(REGION, 4 * FLASH_SECTOR_SIZE);
+}
+
+static String crcOf(const uint8_t* data, size_t size)
+{
+    char hex[9];
+    sprintf(hex, "%08x", crc32(data, size));
+    return hex;
+}
+
+static String md5Of(const uint8_t* data, size_t size)
+{
+    MD5Builder md5;
+    md5.begin();
+    md5.add(data, size);
+    md5.calculate();
+    return md5.toString();
+}
+
+TEST_CASE("FlashHash computes CRC32 and MD5 of a region", "[core][FlashHash]")
+{
+    uint8_t digest[FLASH_HASH_MAX_LENGTH];
+    writeRegion(1);
+
+    REQUIRE(FlashHash.get(FlashHashType::CRC32, REGION, REGION_SIZE, digest));
+    REQUIRE(FlashHashClass::toString(digest, 4) == crcOf(image, REGION_SIZE));
+
+    REQUIRE(FlashHash.get(FlashHashType::MD5, REGION, REGION_SIZE, digest));
+    REQUIRE(FlashHashClass::toString(digest, 16) == md5Of(image, REGION_SIZE));
+
+    // sizes not multiple of 4 and unaligned addresses
+    REQUIRE(FlashHash.get(FlashHashType::MD5, REGION, 5, digest));
+    REQUIRE(FlashHashClass::toString(digest, 16) == md5Of(image, 5));
+    REQUIRE_FALSE(FlashHash.get(FlashHashType::MD5, REGION + 2, 5, digest));
+    REQUIRE_FALSE(FlashHash.get(FlashHashType::SHA256, REGION, 5, digest));
+}
+
+TEST_CASE("FlashHash caches results until the region is written", "[core][FlashHash]")
+{
+    uint8_t digest[FLASH_HASH_MAX_LENGTH];
+    writeRegion(2);
+
+    REQUIRE_FALSE(FlashHash.cached(FlashHashType::MD5, REGION, REGION_SIZE, digest));
+    REQUIRE(FlashHash.get(FlashHashType::MD5, REGION, REGION_SIZE, digest));
+    REQUIRE(FlashHash.cached(FlashHashType::MD5, REGION, REGION_SIZE, digest));
+    REQUIRE(FlashHashClass::toString(digest, 16) == md5Of(image, REGION_SIZE));
+
+    // other regions do not invalidate it
+    FlashHash.invalidate(REGION + 4 * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE);
+    REQUIRE(FlashHash.cached(FlashHashType::MD5, REGION, REGION_SIZE, digest));
+
+    writeRegion(3);
+    REQUIRE_FALSE(FlashHash.cached(FlashHashType::MD5, REGION, REGION_SIZE, digest));
+    REQUIRE(FlashHash.get(FlashHashType::MD5, REGION, REGION_SIZE, digest));
+    REQUIRE(FlashHashClass::toString(digest, 16) == md5Of(image, REGION_SIZE));
+
+    // least recently used entries are dropped first
+    for (int i = 0; i < FLASH_HASH_CACHE_SIZE; i++) {
+        REQUIRE(FlashHash.get(FlashHashType::CRC32, REGION, 4 * (i + 1), digest));
+        if (i == 1) {
+            REQUIRE(FlashHash.cached(FlashHashType::MD5, REGION, REGION_SIZE, digest));
+        }
+    }
+    REQUIRE(FlashHash.cached(FlashHashType::MD5, REGION, REGION_SIZE, digest));
+    REQUIRE_FALSE(FlashHash.cached(FlashHashType::CRC32, REGION, 4, digest));
+}
+
+TEST_CASE("FlashHash hashes requests in the background", "[core][FlashHash]")
+{
+    uint8_t digest[FLASH_HASH_MAX_LENGTH];
+    writeRegion(4);
+
+    int calls = 0;
+    String result;
+    REQUIRE(FlashHash.request(FlashHashType::MD5, REGION, REGION_SIZE, [&](const uint8_t* d, size_t len) {
+        calls++;
+        result = FlashHashClass::toString(d, len);
+    }));
+    REQUIRE(FlashHash.pending() == 1);
+
+    // one slice per scheduler run
+    int runs = 0;
+    while (FlashHash.pending() && runs < 100) {
+        run_scheduled_recurrent_functions();
+        runs++;
+    }
+    REQUIRE(runs == (REGION_SIZE + FLASH_HASH_SLICE_BYTES - 1) / FLASH_HASH_SLICE_BYTES);
+    REQUIRE(calls == 1);
+    REQUIRE(result == md5Of(image, REGION_SIZE));
+
+    // cache hits call back immediately
+    REQUIRE(FlashHash.request(FlashHashType::MD5, REGION, REGION_SIZE, [&](const uint8_t*, size_t) { calls++; }));
+    REQUIRE(calls == 2);
+    REQUIRE(FlashHash.pending() == 0);
+
+    // get() finishes a started request, writes restart it
+    REQUIRE(FlashHash.request(FlashHashType::CRC32, REGION, REGION_SIZE, [&](const uint8_t* d, size_t len) {
+        calls++;
+        result = FlashHashClass::toString(d, len);
+    }));
+    run_scheduled_recurrent_functions();
+    writeRegion(5);
+    run_scheduled_recurrent_functions();
+    REQUIRE(FlashHash.get(FlashHashType::CRC32, REGION, REGION_SIZE, digest));
+    REQUIRE(FlashHash.pending() == 0);
+    REQUIRE(calls == 3);
+    REQUIRE(result == crcOf(image, REGION_SIZE));
+    REQUIRE(FlashHashClass::toString(digest, 4) == result);
+
+    // nothing left to schedule
+    run_scheduled_recurrent_functions();
+    REQUIRE(get_scheduled_recurrent_delay_us() == ~0U);
+}
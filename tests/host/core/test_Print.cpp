@@ -15,6 +15,9 @@
 
 #include <catch.hpp>
 #include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <string>
 #include <FS.h>
 #include "../common/spiffs_mock.h"
 #include <spiffs/spiffs.h>
@@ -78,3 +81,150 @@ TEST_CASE("Print::write overrides all compile properly", "[core][Print]")
     REQUIRE(buff[13] == 0);
     REQUIRE(buff[14] == 1);
 }
+
+// Counts the calls reaching the device
+class CountingPrint: public Print
+{
+public:
+    size_t write(uint8_t c) override
+    {
+        bytes++;
+        out += (char)c;
+        return 1;
+    }
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        size_t n = std::min(size, limit - out.size());
+        blocks++;
+        largest = std::max(largest, size);
+        out.append((const char*)buffer, n);
+        return n;
+    }
+    std::string out;
+    size_t bytes = 0;
+    size_t blocks = 0;
+    size_t largest = 0;
+    size_t limit = SIZE_MAX;
+};
+
+template <typename... Args>
+static void checkPrintf(const char *format, Args... args)
+{
+    char expected[1024];
+    int len = snprintf(expected, sizeof(expected), format, args...);
+    CountingPrint p;
+    INFO(format);
+    REQUIRE(p.printf(format, args...) == (size_t)len);
+    REQUIRE(p.out == expected);
+    REQUIRE(p.bytes == 0);
+}
+
+TEST_CASE("Print::printf matches the C library", "[core][Print]")
+{
+    checkPrintf("plain text");
+    checkPrintf("%d %i %u %x %X %o %%", 42, -42, 42u, 0xbeefu, 0xbeefu, 8u);
+    checkPrintf("[%5d] [%-5d] [%05d] [%+d] [% d] [%.3d] [%5.3d] [%-+6d]", 42, 42, -42, 42, 42, 7, -7, 9);
+    checkPrintf("[%#x] [%#X] [%#o] [%#o] [%#x] [%08.3x]", 255u, 255u, 8u, 0u, 0u, 10u);
+    checkPrintf("[%.0d] [%.0x] [%#.0o] [%5.0u]", 0, 0u, 0u, 0u);
+    checkPrintf("%d %d %u %u", INT_MIN, INT_MAX, UINT_MAX, 0u);
+    checkPrintf("%ld %lu %lld %llu %llx", LONG_MIN, ULONG_MAX, LLONG_MIN, ULLONG_MAX, 0x123456789abcdefULL);
+    checkPrintf("%hhd %hhu %hd %hu %zu %zd %jd", 300, 300, 70000, 70000, (size_t)12345, (ssize_t)-5, (intmax_t)-9);
+    checkPrintf("%llu %llu %llu", 999999999ULL, 1000000000ULL, 10000000000000000000ULL);
+    checkPrintf("[%c] [%3c] [%-3c]", 'a', 'b', 'c');
+    checkPrintf("[%s] [%8s] [%-8s] [%.2s] [%*s] [%-*.*s]", "str", "str", "str", "str", 5, "ab", 6, 3, "abcdef");
+    checkPrintf("%p", (void*)0x1234);
+    checkPrintf("%*d|%-*d|%.*d", -4, 1, 3, 2, -1, 3);
+
+    // longer than any buffer
+    std::string big(300, 'x');
+    checkPrintf("<%s> %d <%s>", big.c_str(), 1, big.c_str());
+}
+
+TEST_CASE("Print::printf floating point", "[core][Print]")
+{
+    checkPrintf("%f %F %.0f %.1f %.9f", 3.14159, -2.5, 2.5, 0.25, 1.0 / 3);
+    checkPrintf("[%10.3f] [%-10.3f] [%010.3f] [%+.2f] [% .2f] [%#.0f]", 3.14159, 3.14159, -3.14159, 1.0, 1.0, 7.0);
+    checkPrintf("%.2f %.2f %.2f %.2f %.0f %.0f %.0f", 0.125, 0.375, 1.005, 2.675, 0.5, 1.5, -0.5);
+    checkPrintf("%f %f %.3f", -0.0, 2147483647.5, 2147483647.9999);
+    checkPrintf("%f %.3f %.12f %.20f", 1e20, -3e9, 1.0 / 7, 0.1);
+    checkPrintf("%e %E %.3e %g %G %.10g %g %g", 12345.678, 1e-10, -0.5, 0.0001, 1e30, M_PI, 100000.0, 1000000.0);
+    checkPrintf("%f %f %f %e", INFINITY, -INFINITY, NAN, INFINITY);
+    checkPrintf("%Lf %a", (long double)1.5, 1.0);
+    checkPrintf("%.2f", 1e300);
+
+    // round to nearest, ties to even on the exact binary value
+    uint64_t seed = 1;
+    for (int i = 0; i < 20000; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double x = (double)(seed >> 11) / (1ULL << (seed & 31));
+        int prec = i % 10;
+        if (i & 1)
+        {
+            // short decimal values, which often land on ties
+            x = (double)(seed >> 40) / 1000;
+            prec = (i >> 1) % 4;
+        }
+        char format[8];
+        snprintf(format, sizeof(format), "%%.%df", prec);
+        checkPrintf(format, x);
+    }
+}
+
+TEST_CASE("Print::printf writes in blocks", "[core][Print]")
+{
+    CountingPrint p;
+    std::string big(1000, 'y');
+    for (int i = 0; i < 10; i++)
+    {
+        p.printf("%d:%s,", i, "abcdefghij");
+    }
+    REQUIRE(p.blocks == 10);
+    p.blocks = 0;
+    p.printf("%s", big.c_str());
+    REQUIRE(p.blocks == 1);
+    p.blocks = 0;
+    p.largest = 0;
+    p.printf("%d%s%d", 1, big.c_str(), 2);
+    REQUIRE(p.blocks == 3);
+    p.printf("%200d", 5);
+    REQUIRE(p.largest <= 1000);
+    REQUIRE(p.bytes == 0);
+
+    p.printf_P(PSTR("%s=%d"), PSTR("flash"), 12);
+    REQUIRE(p.out.substr(p.out.size() - 8) == "flash=12");
+
+    // stops at the first short write
+    CountingPrint full;
+    full.limit = 70;
+    REQUIRE(full.printf("%100d|%d", 1, 2) == 70);
+    REQUIRE(full.blocks == 2);
+}
+
+TEST_CASE("Print::print numbers", "[core][Print]")
+{
+    CountingPrint p;
+    p.print(0L);
+    p.print(" ");
+    p.print(-1234567890L);
+    p.print(" ");
+    p.print(LONG_MIN);
+    p.print(" ");
+    p.print(ULONG_MAX, HEX);
+    p.print(" ");
+    p.print(5u, BIN);
+    p.print(" ");
+    p.print(64u, OCT);
+    p.print(" ");
+    p.print(100u, 7);
+    p.print(" ");
+    p.print(-255, HEX);
+    p.print(" ");
+    p.print(12, 1);
+    p.print(" ");
+    p.print(3.14159);
+    p.print(" ");
+    p.print(-1.999, 2);
+    REQUIRE(p.out == "0 -1234567890 " + std::to_string(LONG_MIN) + " FFFFFFFFFFFFFFFF 101 100 202 FFFFFFFFFFFFFF01 12 3.14 -2.00");
+    REQUIRE(p.bytes == 0);
+}
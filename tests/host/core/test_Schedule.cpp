@@ -0,0 +1,196 @@
+/*
+ test_Schedule.cpp - scheduled functions tests
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <thread>
+#include <vector>
+#include <Schedule.h>
+
+// Selects the interrupt ring for the calling thread (Schedule.cpp)
+extern thread_local bool mock_schedule_from_isr;
+
+static std::vector<uintptr_t> calls;
+
+static void record(void* arg)
+{
+    calls.push_back((uintptr_t)arg);
+}
+
+TEST_CASE("ISR scheduled functions run in order", "[core][Schedule]")
+{
+    calls.clear();
+    REQUIRE(!schedule_isr_function(nullptr));
+    REQUIRE(schedule_isr_function(record, (void*)1));
+    REQUIRE(schedule_isr_function(record, (void*)2));
+    REQUIRE(schedule_function([]() { calls.push_back(4); }));
+    REQUIRE(schedule_isr_function([](void*) { schedule_isr_function(record, (void*)5); }));
+    REQUIRE(schedule_isr_function(record, (void*)3));
+    run_scheduled_functions();
+    // functions scheduled while running wait for the next run
+    REQUIRE(calls == std::vector<uintptr_t>({ 1, 2, 3, 4 }));
+    run_scheduled_functions();
+    REQUIRE(calls == std::vector<uintptr_t>({ 1, 2, 3, 4, 5 }));
+}
+
+TEST_CASE("ISR scheduled functions overflow", "[core][Schedule]")
+{
+    calls.clear();
+    scheduled_isr_stats_t before = get_scheduled_isr_stats();
+    for (uintptr_t i = 0; i < SCHEDULED_ISR_FN_MAX_COUNT; i++)
+        REQUIRE(schedule_isr_function(record, (void*)i));
+    REQUIRE(!schedule_isr_function(record, nullptr));
+    REQUIRE(!schedule_isr_function(record, nullptr));
+
+    // the interrupt ring is independent
+    mock_schedule_from_isr = true;
+    REQUIRE(schedule_isr_function(record, (void*)SCHEDULED_ISR_FN_MAX_COUNT));
+    mock_schedule_from_isr = false;
+
+    scheduled_isr_stats_t after = get_scheduled_isr_stats();
+    REQUIRE((after.scheduled - before.scheduled) == SCHEDULED_ISR_FN_MAX_COUNT + 1);
+    REQUIRE((after.overflows - before.overflows) == 2);
+    REQUIRE(after.maxQueued == SCHEDULED_ISR_FN_MAX_COUNT);
+
+    run_scheduled_functions();
+    REQUIRE(calls.size() == SCHEDULED_ISR_FN_MAX_COUNT + 1);
+    for (uintptr_t i = 0; i <= SCHEDULED_ISR_FN_MAX_COUNT; i++)
+        REQUIRE(calls[i] == i);
+    REQUIRE(schedule_isr_function(record, nullptr));
+    run_scheduled_functions();
+}
+
+// One thread per producer context, the consumer runs in the test thread
+static uint32_t expected[2];
+static uint32_t misordered;
+
+static void check(void* arg)
+{
+    uintptr_t ring = (uintptr_t)arg & 1;
+    uint32_t seq = (uintptr_t)arg >> 1;
+    if (seq != expected[ring])
+        misordered++;
+    expected[ring] = seq + 1;
+}
+
+TEST_CASE("ISR scheduled functions stress", "[core][Schedule]")
+{
+    const uint32_t count = 200000;
+    expected[0] = expected[1] = misordered = 0;
+    scheduled_isr_stats_t before = get_scheduled_isr_stats();
+
+    auto producer = [count](bool isr)
+    {
+        mock_schedule_from_isr = isr;
+        for (uintptr_t seq = 0; seq < count; )
+            if (schedule_isr_function(check, (void*)((seq << 1) | isr)))
+                seq++;
+            else
+                std::this_thread::yield();
+    };
+    std::thread task(producer, false);
+    std::thread isr(producer, true);
+    while (expected[0] < count || expected[1] < count)
+        run_scheduled_functions();
+    task.join();
+    isr.join();
+
+    REQUIRE(misordered == 0);
+    REQUIRE(expected[0] == count);
+    REQUIRE(expected[1] == count);
+    scheduled_isr_stats_t after = get_scheduled_isr_stats();
+    REQUIRE((after.scheduled - before.scheduled) == 2 * count);
+    INFO("overflows: " << after.overflows - before.overflows);
+    REQUIRE(after.maxQueued <= SCHEDULED_ISR_FN_MAX_COUNT);
+}
+
+TEST_CASE("Recurrent functions run by deadline", "[core][Schedule]")
+{
+    REQUIRE(get_scheduled_recurrent_delay_us() == ~0U);
+
+    int slow = 0, fast = 0, always = 0;
+    recurrent_fn_id_t idSlow = schedule_recurrent_function_us([&]() { return ++slow; }, 200000);
+    recurrent_fn_id_t idFast = schedule_recurrent_function_us([&]() { return ++fast; }, 20000);
+    REQUIRE(idSlow);
+    REQUIRE(idFast);
+    REQUIRE(idSlow != idFast);
+    uint32_t delay = get_scheduled_recurrent_delay_us();
+    REQUIRE(delay > 0);
+    REQUIRE(delay <= 20000);
+
+    run_scheduled_recurrent_functions();
+    REQUIRE(fast == 0);
+    delayMicroseconds(delay + 1000);
+    run_scheduled_recurrent_functions();
+    REQUIRE(fast == 1);
+    REQUIRE(slow == 0);
+    REQUIRE(get_scheduled_recurrent_delay_us() > 0);
+
+    // runs once per run, even when due again
+    recurrent_fn_id_t idAlways = schedule_recurrent_function_us([&]() { return ++always; }, 0);
+    REQUIRE(get_scheduled_recurrent_delay_us() == 0);
+    run_scheduled_recurrent_functions();
+    run_scheduled_recurrent_functions();
+    REQUIRE(always == 2);
+
+    REQUIRE(cancel_recurrent_function(idAlways));
+    REQUIRE(!cancel_recurrent_function(idAlways));
+    run_scheduled_recurrent_functions();
+    REQUIRE(always == 2);
+
+    REQUIRE(cancel_recurrent_function(idSlow));
+    REQUIRE(cancel_recurrent_function(idFast));
+    REQUIRE(get_scheduled_recurrent_delay_us() == ~0U);
+}
+
+TEST_CASE("Recurrent functions cancelled while running", "[core][Schedule]")
+{
+    int first = 0, second = 0, once = 0;
+    recurrent_fn_id_t idFirst = 0, idSecond = 0;
+    // cancels itself, and the next one which is due in the same run
+    idFirst = schedule_recurrent_function_us([&]()
+    {
+        ++first;
+        REQUIRE(cancel_recurrent_function(idSecond));
+        REQUIRE(cancel_recurrent_function(idFirst));
+        return true;
+    }, 0);
+    idSecond = schedule_recurrent_function_us([&]() { return ++second; }, 0);
+    recurrent_fn_id_t idOnce = schedule_recurrent_function_us([&]() { ++once; return false; }, 0);
+
+    run_scheduled_recurrent_functions();
+    run_scheduled_recurrent_functions();
+    REQUIRE(first == 1);
+    REQUIRE(second == 0);
+    REQUIRE(once == 1);
+    REQUIRE(!cancel_recurrent_function(idOnce));
+    REQUIRE(get_scheduled_recurrent_delay_us() == ~0U);
+}
+
+TEST_CASE("Recurrent functions with alarm", "[core][Schedule]")
+{
+    bool ring = false;
+    int calls = 0;
+    recurrent_fn_id_t id = schedule_recurrent_function_us([&]() { return ++calls; }, 1000000, [&]() { return ring; });
+    REQUIRE(get_scheduled_recurrent_delay_us() == 0);
+    run_scheduled_recurrent_functions();
+    REQUIRE(calls == 0);
+    ring = true;
+    run_scheduled_recurrent_functions();
+    run_scheduled_recurrent_functions();
+    REQUIRE(calls == 2);
+    REQUIRE(cancel_recurrent_function(id));
+    run_scheduled_recurrent_functions();
+    REQUIRE(calls == 2);
+}
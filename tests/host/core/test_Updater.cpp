@@ -15,6 +15,8 @@
 
 #include <catch.hpp>
 #include <Updater.h>
+#include <MD5Builder.h>
+#include <vector>
 
 
 // Use a SPIFFS file because we can't instantiate a virtual class like Print
@@ -54,3 +56,172 @@ TEST_CASE("Updater fails when writes overflow requested size", "[core][Updater]"
     REQUIRE(!u->write(buff, 2048));
     delete u;
 }
+
+TEST_CASE("Updater with erase ahead writes the whole image", "[core][Updater]")
+{
+    UpdaterClass *u;
+    uint8_t buff[4096];
+    memset(buff, 0, sizeof(buff));
+
+    u = new UpdaterClass();
+    u->eraseAhead(true, true);
+    REQUIRE(u->begin(10000));
+    REQUIRE(u->write(buff, 4096));
+    REQUIRE(u->write(buff, 4096));
+    REQUIRE(u->write(buff, 1808));
+    REQUIRE(u->remaining() == 0);
+    REQUIRE(!u->hasError());
+    REQUIRE(!u->write(buff, 1));
+    delete u;
+}
+
+extern "C" uint32_t _FS_start;
+
+static void deltaU32(std::vector<uint8_t>& out, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        out.push_back(v >> (8 * i));
+}
+
+static void deltaMD5(std::vector<uint8_t>& out, std::vector<uint8_t> image, bool base)
+{
+    if (base)
+        image[2] = image[3] = 0;
+    MD5Builder md5;
+    md5.begin();
+    md5.add(image.data(), image.size());
+    md5.calculate();
+    uint8_t bytes[16];
+    md5.getBytes(bytes);
+    out.insert(out.end(), bytes, bytes + sizeof(bytes));
+}
+
+static void deltaCopy(std::vector<uint8_t>& out, uint32_t offset, uint32_t len)
+{
+    out.push_back('C');
+    deltaU32(out, offset);
+    deltaU32(out, len);
+}
+
+static void deltaData(std::vector<uint8_t>& out, const std::vector<uint8_t>& image, uint32_t offset, uint32_t len)
+{
+    out.push_back('D');
+    deltaU32(out, len);
+    out.insert(out.end(), image.begin() + offset, image.begin() + offset + len);
+}
+
+TEST_CASE("Updater applies delta patches against the running sketch", "[core][Updater]")
+{
+    // Running sketch, with the flash mode rewritten as esptool does
+    std::vector<uint8_t> oldImage(20000);
+    for (size_t i = 0; i < oldImage.size(); i++)
+        oldImage[i] = (i * 7919) >> 5;
+    oldImage[0] = 0xe9;
+    oldImage[3] = 0x20;
+    for (uint32_t s = 0; s < 5; s++)
+        ESP.flashEraseSector(s);
+    std::vector<uint8_t> flashed = oldImage;
+    flashed[2] = 0x03;
+    ESP.flashWrite(0, (uint32_t*)flashed.data(), flashed.size());
+
+    // New sketch: a few changed bytes and an inserted block
+    std::vector<uint8_t> newImage(oldImage.begin(), oldImage.begin() + 9000);
+    for (int i = 0; i < 300; i++)
+        newImage.push_back(i);
+    newImage.insert(newImage.end(), oldImage.begin() + 9000, oldImage.end());
+    newImage[5000] ^= 0xff;
+
+    std::vector<uint8_t> patch;
+    deltaU32(patch, 0x544c44d1);
+    deltaU32(patch, oldImage.size());
+    deltaU32(patch, newImage.size());
+    deltaMD5(patch, oldImage, true);
+    deltaMD5(patch, newImage, false);
+    deltaData(patch, newImage, 0, 16);
+    deltaCopy(patch, 16, 4984);
+    deltaData(patch, newImage, 5000, 1);
+    deltaCopy(patch, 5001, 3999);
+    deltaData(patch, newImage, 9000, 300);
+    deltaCopy(patch, 9000, 11000);
+
+    UpdaterClass *u = new UpdaterClass();
+    REQUIRE(u->begin(patch.size()));
+    for (size_t i = 0; i < patch.size(); i += 100) {
+        size_t len = std::min((size_t)100, patch.size() - i);
+        REQUIRE(u->write(patch.data() + i, len) == len);
+    }
+    REQUIRE(u->isFinished());
+    REQUIRE(u->end());
+    delete u;
+
+    // Staged right below the filesystem
+    uint32_t staged = (uintptr_t)&_FS_start - 0x40200000 - ((newImage.size() + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1));
+    std::vector<uint8_t> result(newImage.size());
+    ESP.flashRead(staged, (uint32_t*)result.data(), result.size());
+    REQUIRE(result == newImage);
+
+    // A patch made for another sketch is refused
+    patch[12] ^= 1;
+    u = new UpdaterClass();
+    REQUIRE(u->begin(patch.size()));
+    REQUIRE(u->write(patch.data(), patch.size()) == 0);
+    REQUIRE(u->getError() == UPDATE_ERROR_DELTA);
+    delete u;
+}
+
+static void writeFile(const char* name, const std::vector<uint8_t>& data)
+{
+    FILE* f = fopen(name, "wb");
+    REQUIRE(f);
+    REQUIRE(fwrite(data.data(), 1, data.size(), f) == data.size());
+    fclose(f);
+}
+
+TEST_CASE("Updater applies patches made by tools/delta.py", "[core][Updater]")
+{
+    std::vector<uint8_t> oldImage(30000);
+    for (size_t i = 0; i < oldImage.size(); i++)
+        oldImage[i] = (i * 2654435761U) >> 13;
+    oldImage[0] = 0xe9;
+    oldImage[3] = 0x20;
+    for (uint32_t s = 0; s < 8; s++)
+        ESP.flashEraseSector(s);
+    std::vector<uint8_t> flashed = oldImage;
+    flashed[2] = 0x02;
+    ESP.flashWrite(0, (uint32_t*)flashed.data(), flashed.size());
+
+    // A moved function, a grown table and a few patched constants
+    std::vector<uint8_t> newImage(oldImage.begin(), oldImage.begin() + 4000);
+    newImage.insert(newImage.end(), oldImage.begin() + 20000, oldImage.begin() + 22000);
+    newImage.insert(newImage.end(), oldImage.begin() + 4000, oldImage.begin() + 20000);
+    for (int i = 0; i < 500; i++)
+        newImage.push_back(i * 3);
+    newImage.insert(newImage.end(), oldImage.begin() + 22000, oldImage.end());
+    newImage[100] ^= 0x55;
+    newImage[15000] ^= 0x55;
+
+    writeFile("bin/delta-old.bin", oldImage);
+    writeFile("bin/delta-new.bin", newImage);
+    REQUIRE(system("python3 ../../tools/delta.py -o bin/delta-old.bin -n bin/delta-new.bin -p bin/delta.patch 2>/dev/null") == 0);
+    std::vector<uint8_t> patch(newImage.size());
+    FILE* f = fopen("bin/delta.patch", "rb");
+    REQUIRE(f);
+    patch.resize(fread(patch.data(), 1, patch.size(), f));
+    fclose(f);
+    REQUIRE(patch[0] == DELTA_MAGIC_BYTE);
+    REQUIRE(patch.size() < newImage.size() / 4);
+
+    UpdaterClass *u = new UpdaterClass();
+    REQUIRE(u->begin(patch.size()));
+    for (size_t i = 0; i < patch.size(); i += 256) {
+        size_t len = std::min((size_t)256, patch.size() - i);
+        REQUIRE(u->write(patch.data() + i, len) == len);
+    }
+    REQUIRE(u->end());
+    delete u;
+
+    uint32_t staged = (uintptr_t)&_FS_start - 0x40200000 - ((newImage.size() + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1));
+    std::vector<uint8_t> result(newImage.size());
+    ESP.flashRead(staged, (uint32_t*)result.data(), result.size());
+    REQUIRE(result == newImage);
+}
@@ -0,0 +1,221 @@
+/*
+ test_base64.cpp - base64 and base16 codec tests
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <string>
+#include <StreamString.h>
+#include <base64.h>
+#include <base16.h>
+#include <libb64/cencode.h>
+
+static std::string data(size_t length, uint32_t seed)
+{
+    std::string s;
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        s += (char)(seed >> 16);
+    }
+    return s;
+}
+
+// What base64::encode() returned when it used libb64
+static std::string libb64(const std::string& in, bool doNewLines)
+{
+    base64_encodestate state;
+    if (doNewLines) {
+        base64_init_encodestate(&state);
+    } else {
+        base64_init_encodestate_nonewlines(&state);
+    }
+    std::string out(base64_encode_expected_len(in.size()) + 1, 0);
+    int len = base64_encode_block(in.data(), in.size(), &out[0], &state);
+    len += base64_encode_blockend(&out[len], &state);
+    out.resize(len);
+    return out;
+}
+
+TEST_CASE("base64 test vectors", "[core][base64]")
+{
+    const char* vectors[][2] = {
+        { "", "" },
+        { "f", "Zg==" },
+        { "fo", "Zm8=" },
+        { "foo", "Zm9v" },
+        { "foob", "Zm9vYg==" },
+        { "fooba", "Zm9vYmE=" },
+        { "foobar", "Zm9vYmFy" },
+        { "user:pass", "dXNlcjpwYXNz" },
+        { "\xff\xfe\xfd", "//79" },
+    };
+    for (auto& v : vectors) {
+        const uint8_t* in = (const uint8_t*)v[0];
+        size_t len = strlen(v[0]);
+        REQUIRE(base64::encode(in, len, false) == v[1]);
+        REQUIRE(base64::encodedLength(len) == strlen(v[1]));
+
+        char out[16];
+        REQUIRE(base64::encode(in, len, out, sizeof(out)) == strlen(v[1]));
+        REQUIRE(std::string(out) == v[1]);
+
+        uint8_t decoded[16];
+        REQUIRE(base64::decode(v[1], strlen(v[1]), decoded, sizeof(decoded)) == (int)len);
+        REQUIRE(std::string((char*)decoded, len) == v[0]);
+    }
+    REQUIRE(base64::encode(String("foob"), false) == "Zm9vYg==");
+}
+
+TEST_CASE("base64 encodes like libb64", "[core][base64]")
+{
+    for (size_t len = 0; len < 300; len++) {
+        std::string in = data(len, len);
+        for (bool nl : { false, true }) {
+            std::string expected = libb64(in, nl);
+            INFO("length " << len << " newlines " << nl);
+            REQUIRE(base64::encodedLength(len, nl) == expected.size());
+            REQUIRE(base64::encode((const uint8_t*)in.data(), len, nl) == expected.c_str());
+
+            char out[512];
+            REQUIRE(base64::encode((const uint8_t*)in.data(), len, out, expected.size(), nl) == 0);
+            REQUIRE(base64::encode((const uint8_t*)in.data(), len, out, expected.size() + 1, nl) == expected.size());
+            REQUIRE(out == expected);
+
+            StreamString s;
+            REQUIRE(base64::encode((const uint8_t*)in.data(), len, s, nl) == expected.size());
+            REQUIRE(s == expected.c_str());
+
+            uint8_t decoded[300];
+            REQUIRE(base64::decode(expected.c_str(), expected.size(), decoded, sizeof(decoded)) == (int)len);
+            REQUIRE(std::string((char*)decoded, len) == in);
+        }
+    }
+}
+
+TEST_CASE("base64 decoding", "[core][base64]")
+{
+    uint8_t out[16];
+    auto decode = [&](const char* in) {
+        return base64::decode(in, strlen(in), out, sizeof(out));
+    };
+    // whitespace, missing padding, URL safe alphabet
+    REQUIRE(decode("Zm9v\r\nYmE=\n") == 5);
+    REQUIRE(decode(" Zm 9v Yg ") == 4);
+    REQUIRE(decode("Zm9vYmE") == 5);
+    REQUIRE(memcmp(out, "fooba", 5) == 0);
+    REQUIRE(decode("-_-_") == 3);
+    REQUIRE(memcmp(out, "\xfb\xff\xbf", 3) == 0);
+    // invalid
+    REQUIRE(decode("Zm9v!") == -1);
+    REQUIRE(decode("Z") == -1);
+    REQUIRE(decode("Zm9vY") == -1);
+    REQUIRE(decode("Z===") == -1);
+    REQUIRE(decode("Zg=") == -1);
+    REQUIRE(decode("Zg===") == -1);
+    REQUIRE(decode("Zg==Zg==") == -1);
+    REQUIRE(decode("Zg=a") == -1);
+    REQUIRE(decode("Zm9v\xc3\xa9") == -1);
+    // does not fit
+    REQUIRE(base64::decode("Zm9vYmFy", 8, out, 5) == -1);
+    REQUIRE(base64::decode("Zm9vYmE=", 8, out, 4) == -1);
+    REQUIRE(base64::decode("Zm9vYmE=", 8, out, 5) == 5);
+    REQUIRE(base64::decodedLength(8) >= 6);
+}
+
+TEST_CASE("base64 streaming", "[core][base64]")
+{
+    std::string in = data(1000, 7);
+    for (bool nl : { false, true }) {
+        std::string expected = libb64(in, nl);
+        for (size_t chunk : { 1, 2, 3, 5, 47, 48, 49, 200, 1000 }) {
+            INFO("chunk " << chunk << " newlines " << nl);
+            StreamString encoded;
+            Base64Encoder encoder(encoded, nl);
+            for (size_t i = 0; i < in.size(); i += chunk) {
+                size_t n = std::min(chunk, in.size() - i);
+                REQUIRE(encoder.write((const uint8_t*)in.data() + i, n) == n);
+            }
+            REQUIRE(encoder.end() == expected.size());
+            REQUIRE(encoded == expected.c_str());
+
+            StreamString decoded;
+            Base64Decoder decoder(decoded);
+            for (size_t i = 0; i < expected.size(); i += chunk) {
+                size_t n = std::min(chunk, expected.size() - i);
+                REQUIRE(decoder.write((const uint8_t*)expected.data() + i, n) == n);
+            }
+            REQUIRE(decoder.end());
+            REQUIRE(decoded.length() == in.size());
+            REQUIRE(memcmp(decoded.c_str(), in.data(), in.size()) == 0);
+        }
+    }
+
+    // from a Stream
+    StreamString source, encoded;
+    source.setTimeout(0);
+    source.print("foobar");
+    REQUIRE(base64::encode(source, encoded) == 8);
+    REQUIRE(encoded == "Zm9vYmFy");
+    source.print("foobar");
+    encoded.clear();
+    REQUIRE(base64::encode(source, encoded, 4) == 8);
+    REQUIRE(encoded == "Zm9vYg==");
+
+    // Print API and errors
+    StreamString decoded;
+    Base64Decoder decoder(decoded);
+    decoder.print("Zm9v");
+    decoder.print("YmE");
+    REQUIRE(decoder.end());
+    REQUIRE(decoded == "fooba");
+    Base64Decoder bad(decoded);
+    REQUIRE(bad.print("Zm9v$") == 0);
+    REQUIRE(bad.getWriteError());
+    REQUIRE_FALSE(bad.end());
+    Base64Decoder truncated(decoded);
+    truncated.print("Zm9vY");
+    REQUIRE_FALSE(truncated.end());
+}
+
+TEST_CASE("base16 encoding and decoding", "[core][base16]")
+{
+    const uint8_t bytes[] = { 0x00, 0x01, 0x7f, 0x80, 0xab, 0xcd, 0xef, 0xff };
+    char out[17];
+    REQUIRE(base16::encode(bytes, sizeof(bytes), out) == 16);
+    REQUIRE(std::string(out) == "00017f80abcdefff");
+    REQUIRE(base16::encode(bytes, sizeof(bytes), true) == "00017F80ABCDEFFF");
+    StreamString s;
+    REQUIRE(base16::encode(bytes, sizeof(bytes), s) == 16);
+    REQUIRE(s == "00017f80abcdefff");
+
+    uint8_t decoded[8];
+    REQUIRE(base16::decode("00017f80ABCDefFF", 16, decoded, sizeof(decoded)) == 8);
+    REQUIRE(memcmp(decoded, bytes, 8) == 0);
+    REQUIRE(base16::decode(String("ab"), decoded, 1) == 1);
+    REQUIRE(decoded[0] == 0xab);
+    REQUIRE(base16::decode("abc", 3, decoded, sizeof(decoded)) == -1);
+    REQUIRE(base16::decode("0g", 2, decoded, sizeof(decoded)) == -1);
+    REQUIRE(base16::decode("\xc3\xa9", 2, decoded, sizeof(decoded)) == -1);
+    REQUIRE(base16::decode("abcd", 4, decoded, 1) == -1);
+
+    // longer than the internal blocks
+    std::string in = data(300, 3);
+    String hex = base16::encode((const uint8_t*)in.data(), in.size());
+    REQUIRE(hex.length() == 600);
+    s.clear();
+    base16::encode((const uint8_t*)in.data(), in.size(), s);
+    REQUIRE(s == hex);
+    uint8_t back[300];
+    REQUIRE(base16::decode(hex, back, sizeof(back)) == 300);
+    REQUIRE(memcmp(back, in.data(), 300) == 0);
+}
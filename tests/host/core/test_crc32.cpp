@@ -0,0 +1,81 @@
+/*
+ test_crc32.cpp - crc32() and CRC32Builder tests
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include <coredecls.h>
+#include <CRC32Builder.h>
+
+// The bit by bit implementation eboot and elf2bin.py agree with
+static uint32_t crc32_bitwise(const void* data, size_t length, uint32_t crc = 0xffffffff)
+{
+    const uint8_t* ldata = (const uint8_t*)data;
+    while (length--)
+    {
+        uint8_t c = *ldata++;
+        for (uint32_t i = 0x80; i > 0; i >>= 1)
+        {
+            bool bit = crc & 0x80000000;
+            if (c & i)
+                bit = !bit;
+            crc <<= 1;
+            if (bit)
+                crc ^= 0x04c11db7;
+        }
+    }
+    return crc;
+}
+
+TEST_CASE("crc32 test vectors", "[core][crc32]")
+{
+    REQUIRE(crc32("", 0) == 0xffffffff);
+    REQUIRE(crc32("123456789", 9) == 0x0376e6e7);
+    REQUIRE(crc32("The quick brown fox jumps over the lazy dog", 43) == crc32_bitwise("The quick brown fox jumps over the lazy dog", 43));
+    REQUIRE(crc32("123456789", 9, 0) == crc32_bitwise("123456789", 9, 0));
+}
+
+TEST_CASE("crc32 matches the bitwise version at any alignment", "[core][crc32]")
+{
+    uint8_t buf[256 + 8];
+    uint32_t seed = 1;
+    for (auto& b : buf)
+    {
+        seed = seed * 1103515245 + 12345;
+        b = seed >> 16;
+    }
+    for (size_t offset = 0; offset < 8; offset++)
+        for (size_t len = 0; len <= 256; len++)
+            if (crc32(buf + offset, len) != crc32_bitwise(buf + offset, len))
+                FAIL("offset " << offset << " length " << len);
+
+    // chained calls, the way checkFlashCRC() hashes around the length/crc words
+    uint32_t crc = crc32(buf, 13);
+    crc = crc32(buf + 13, 100, crc);
+    crc = crc32(buf + 113, 150, crc);
+    REQUIRE(crc == crc32(buf, 263));
+}
+
+TEST_CASE("CRC32Builder", "[core][crc32]")
+{
+    CRC32Builder crc;
+    REQUIRE(crc.getCRC() == 0xffffffff);
+    crc.add("1234", 4);
+    crc.print(5);
+    crc.printf("%d%c%s", 67, '8', "9");
+    REQUIRE(crc.getCRC() == 0x0376e6e7);
+    crc.begin();
+    crc.print("123456789");
+    REQUIRE(crc.getCRC() == 0x0376e6e7);
+}
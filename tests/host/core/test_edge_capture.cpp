@@ -0,0 +1,197 @@
+/*
+ test_edge_capture.cpp - GPIO edge capture ring and decoders tests
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+
+// The interrupt is called by hand here, with a fake cycle counter, and the
+// pins are not configured
+static uint32_t cycles;
+#define EDGE_CAPTURE_CYCLES() cycles
+#include "../../../cores/esp8266/edge_capture.cpp"
+
+extern "C" void edge_capture_attach(uint8_t, int) {}
+extern "C" void edge_capture_detach(uint8_t) {}
+
+static const uint32_t us = clockCyclesPerMicrosecond();
+
+// An edge of pin at time t us
+static void edge(uint8_t pin, uint8_t level, uint32_t t)
+{
+    edge_capture_isr(1 << pin, level << pin, t * us);
+}
+
+TEST_CASE("Edge capture ring keeps order and counts overflows", "[core][edge_capture]")
+{
+    edge_capture_event_t events[8];
+
+    REQUIRE(edge_capture_begin(4));
+    // Two pins in the same interrupt share the timestamp
+    edge_capture_isr((1 << 4) | (1 << 5), 1 << 5, 1000);
+    edge_capture_isr(1 << 4, 1 << 4, 2000);
+    edge_capture_isr(1 << 4, 0, 3000);
+    REQUIRE(edge_capture_available() == 3);
+    REQUIRE(edge_capture_overflows() == 1);
+    REQUIRE(edge_capture_read(events, 8) == 3);
+    REQUIRE(events[0].pin == 4);
+    REQUIRE(events[0].level == 0);
+    REQUIRE(events[0].cycles == 1000);
+    REQUIRE(events[1].pin == 5);
+    REQUIRE(events[1].level == 1);
+    REQUIRE(events[1].cycles == 1000);
+    REQUIRE(events[2].cycles == 2000);
+
+    // Wrapping around
+    for (uint32_t i = 0; i < 3; i++) {
+        edge_capture_isr(1 << 2, 0, 4000 + i);
+    }
+    REQUIRE(edge_capture_read(events, 2) == 2);
+    edge_capture_isr(1 << 2, 0, 5000);
+    REQUIRE(edge_capture_available() == 2);
+    REQUIRE(edge_capture_read(events, 8) == 2);
+    REQUIRE(events[0].cycles == 4002);
+    REQUIRE(events[1].cycles == 5000);
+    edge_capture_end();
+}
+
+TEST_CASE("Edge capture frequency and duty cycle", "[core][edge_capture]")
+{
+    EdgeFrequency flow(5, 100);
+    EdgeDecoder* decoders[] = { &flow };
+
+    REQUIRE(edge_capture_begin(32));
+    // 1kHz, 25% duty
+    for (uint32_t t = 0; t < 5000; t += 1000) {
+        edge(5, 1, t);
+        edge(5, 0, t + 250);
+        edge(6, 1, t + 500);
+    }
+    cycles = 5000 * us;
+    REQUIRE(edge_capture_dispatch(decoders, 1) == 15);
+    REQUIRE(flow.pulses() == 5);
+    REQUIRE(flow.periodMicros() == 1000);
+    REQUIRE(flow.highMicros() == 250);
+    REQUIRE(flow.frequency() == Approx(1000));
+    REQUIRE(flow.duty() == Approx(0.25));
+    REQUIRE(flow.missed() == 0);
+
+    // A pulse too short for the interrupt
+    edge(5, 1, 5000);
+    edge(5, 1, 6000);
+    REQUIRE(edge_capture_dispatch(decoders, 1) == 2);
+    REQUIRE(flow.missed() == 1);
+
+    // Stopped
+    cycles = 106001 * us;
+    edge_capture_dispatch(decoders, 1);
+    REQUIRE(flow.frequency() == 0);
+    REQUIRE(flow.pulses() == 7);
+    edge_capture_end();
+}
+
+TEST_CASE("Edge capture pulse trains and NEC", "[core][edge_capture]")
+{
+    EdgePulseTrain ir(14, 10000, 100);
+    EdgeQuadrature encoder(12, 13, 0, 0);
+    EdgeDecoder* decoders[] = { &ir, &encoder };
+
+    REQUIRE(edge_capture_begin(128));
+    // NEC frame of an active low receiver: address 0x04, command 0x08
+    const uint32_t code = 0x04 | (0xfb << 8) | (0x08 << 16) | (0xf7 << 24);
+    uint32_t t = 1000;
+    edge(14, 0, t);
+    edge(14, 1, t += 9000);
+    edge(14, 0, t += 4500);
+    for (int bit = 0; bit < 32; bit++) {
+        edge(14, 1, t += 560);
+        edge(14, 0, t += (code & (1UL << bit)) ? 1690 : 560);
+    }
+    edge(14, 1, t += 560);
+    cycles = (t + 5000) * us;
+    REQUIRE(edge_capture_dispatch(decoders, 2) == 68);
+    REQUIRE_FALSE(ir.available());
+    cycles = (t + 10001) * us;
+    edge_capture_dispatch(decoders, 2);
+    REQUIRE(ir.available());
+    REQUIRE(ir.size() == 67);
+    REQUIRE(ir.firstLevel() == 0);
+    REQUIRE(ir.pulses()[0] == 9000);
+    uint32_t decoded = 0;
+    REQUIRE(ir.decodeNEC(&decoded));
+    REQUIRE(decoded == code);
+
+    // The next frame waits for clear()
+    edge(14, 0, t += 40000);
+    edge(14, 1, t += 9000);
+    edge_capture_dispatch(decoders, 2);
+    REQUIRE(ir.dropped() == 2);
+    ir.clear();
+    REQUIRE_FALSE(ir.available());
+
+    // Encoder: 2 cycles forward, 1 back, then a merged pulse
+    const uint8_t forward[][2] = { { 12, 1 }, { 13, 1 }, { 12, 0 }, { 13, 0 } };
+    for (int i = 0; i < 8; i++) {
+        edge(forward[i % 4][0], forward[i % 4][1], t += 10);
+    }
+    for (int i = 3; i >= 0; i--) {
+        edge(forward[i][0], !forward[i][1], t += 10);
+    }
+    edge(12, 0, t += 10);
+    edge_capture_dispatch(decoders, 2);
+    REQUIRE(encoder.position() == 4);
+    REQUIRE(encoder.errors() == 1);
+    edge_capture_end();
+}
+
+TEST_CASE("Edge capture pulse train without room stays inert", "[core][edge_capture]")
+{
+    EdgePulseTrain ir(14, 10000, 0);
+    EdgeDecoder* decoders[] = { &ir };
+
+    REQUIRE(edge_capture_begin(16));
+    uint32_t t = 1000;
+    for (int i = 0; i < 8; i++) {
+        edge(14, i & 1, t += 500);
+    }
+    cycles = (t + 20000) * us;
+    REQUIRE(edge_capture_dispatch(decoders, 1) == 8);
+    REQUIRE_FALSE(ir.available());
+    REQUIRE(ir.size() == 0);
+    REQUIRE(ir.dropped() == 0);
+    edge_capture_end();
+}
+
+TEST_CASE("Edge capture quadrature with A and B in one interrupt", "[core][edge_capture]")
+{
+    EdgeQuadrature encoder(12, 13, 0, 0);
+    EdgeDecoder* decoders[] = { &encoder };
+
+    REQUIRE(edge_capture_begin(16));
+    uint32_t t = 1000;
+    edge(12, 1, t += 10);
+    REQUIRE(edge_capture_dispatch(decoders, 1) == 1);
+    REQUIRE(encoder.position() == 1);
+    // 10 to 01: both changed, which first is unknown
+    edge_capture_isr((1 << 12) | (1 << 13), 1 << 13, (t += 10) * us);
+    REQUIRE(edge_capture_dispatch(decoders, 1) == 2);
+    REQUIRE(encoder.position() == 1);
+    REQUIRE(encoder.errors() == 1);
+    // Back in step from 01: forward is B falling
+    edge(13, 0, t += 10);
+    edge(12, 1, t += 10);
+    edge_capture_dispatch(decoders, 1);
+    REQUIRE(encoder.position() == 3);
+    REQUIRE(encoder.errors() == 1);
+    edge_capture_end();
+}
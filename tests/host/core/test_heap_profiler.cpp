@@ -0,0 +1,130 @@
+/*
+ test_heap_profiler.cpp - allocation site heap profiler tests
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <StreamString.h>
+
+// The profiler is only built with UMM_HEAP_PROFILER, its tables are fed
+// fake pointers here instead of going through the heap wrappers
+#define UMM_HEAP_PROFILER
+#include "../../../cores/esp8266/heap_profiler.cpp"
+
+static char heap[8 * UMM_HEAP_PROFILER_ALLOCS];
+
+static void* block(int i)
+{
+    return heap + 8 * i;
+}
+
+// Forgets blocks [0, n) and restarts the counts, leaving the tables empty
+static void cleanup(int n)
+{
+    for (int i = 0; i < n; i++) {
+        heap_profiler_forget(block(i));
+    }
+    heap_profiler_reset();
+    heap_profiler_site_t site;
+    REQUIRE(heap_profiler_snapshot(&site, 1) == 0);
+}
+
+TEST_CASE("Heap profiler charges allocations to their site", "[core][heap_profiler]")
+{
+    heap_profiler_site_t sites[4];
+
+    heap_profiler_record(block(0), 100, nullptr, 0x40201000);
+    heap_profiler_record(block(1), 20, "a.cpp", 12);
+    heap_profiler_record(block(2), 30, "a.cpp", 12);
+    heap_profiler_record(nullptr, 50, "a.cpp", 12);
+    REQUIRE(heap_profiler_snapshot(sites, 4) == 2);
+    REQUIRE(sites[0].where == 0x40201000);
+    REQUIRE(sites[0].live_bytes == 100);
+    REQUIRE(sites[1].file == std::string("a.cpp"));
+    REQUIRE(sites[1].live_bytes == 50);
+    REQUIRE(sites[1].live_count == 2);
+    REQUIRE(sites[1].allocs == 2);
+
+    // Frees in the probe chain of other pointers keep them reachable
+    heap_profiler_forget(block(1));
+    heap_profiler_forget(block(7)); // never recorded
+    REQUIRE(heap_profiler_snapshot(sites, 4) == 2);
+    REQUIRE(sites[1].live_bytes == 30);
+    REQUIRE(sites[1].peak_bytes == 50);
+    REQUIRE(sites[1].live_count == 1);
+
+    // operator new and _malloc_r move the allocation to their caller
+    heap_profiler_retag(block(0), nullptr, 0x40202000);
+    REQUIRE(heap_profiler_snapshot(sites, 4) == 2);
+    REQUIRE(sites[0].where == 0x40202000);
+    REQUIRE(sites[0].allocs == 1);
+
+    heap_profiler_reset();
+    REQUIRE(heap_profiler_snapshot(sites, 4) == 2);
+    REQUIRE(sites[0].allocs == 0);
+    REQUIRE(sites[0].peak_bytes == 100);
+    REQUIRE(sites[1].peak_bytes == 30);
+
+    cleanup(3);
+}
+
+TEST_CASE("Heap profiler overflows into the other site and untracked", "[core][heap_profiler]")
+{
+    heap_profiler_site_t sites[UMM_HEAP_PROFILER_SITES];
+
+    for (int i = 0; i < UMM_HEAP_PROFILER_SITES + 4; i++) {
+        heap_profiler_record(block(i), 1 + i, nullptr, 0x40200000 + 4 * i);
+    }
+    REQUIRE(heap_profiler_snapshot(sites, UMM_HEAP_PROFILER_SITES) == UMM_HEAP_PROFILER_SITES);
+    // The overflow holds the last 5 sites, the largest ones
+    REQUIRE(sites[0].file == nullptr);
+    REQUIRE(sites[0].where == 0);
+    REQUIRE(sites[0].live_count == 5);
+
+    // Every pointer is found again after many removals
+    for (int i = 0; i < UMM_HEAP_PROFILER_SITES + 4; i += 2) {
+        heap_profiler_forget(block(i));
+    }
+    for (int i = 1; i < UMM_HEAP_PROFILER_SITES + 4; i += 2) {
+        heap_profiler_forget(block(i));
+    }
+    REQUIRE(heap_profiler_snapshot(sites, UMM_HEAP_PROFILER_SITES) == UMM_HEAP_PROFILER_SITES);
+    for (int i = 0; i < UMM_HEAP_PROFILER_SITES; i++) {
+        REQUIRE(sites[i].live_bytes == 0);
+    }
+    heap_profiler_reset();
+
+    for (int i = 0; i < UMM_HEAP_PROFILER_ALLOCS; i++) {
+        heap_profiler_record(block(i), 4, "b.cpp", 1);
+    }
+    REQUIRE(heap_profiler_untracked() == UMM_HEAP_PROFILER_ALLOCS / 4);
+    REQUIRE(heap_profiler_snapshot(sites, 1) == 1);
+    REQUIRE(sites[0].live_count == UMM_HEAP_PROFILER_ALLOCS * 3 / 4);
+
+    cleanup(UMM_HEAP_PROFILER_ALLOCS);
+    REQUIRE(heap_profiler_untracked() == 0);
+}
+
+TEST_CASE("Heap profiler report", "[core][heap_profiler]")
+{
+    StreamString out;
+    heap_profiler_record(block(0), 64, "/path/to/WString.cpp", 203);
+    heap_profiler_record(block(1), 2048, nullptr, 0x40204a1c);
+    heap_profiler_report(out);
+    REQUIRE(out ==
+            "   live    peak count  allocs site\r\n"
+            "   2048    2048     1       1 0x40204a1c\r\n"
+            "     64      64     1       1 WString.cpp:203\r\n"
+            "2112 bytes in 2 allocations, 0 untracked\r\n");
+    cleanup(2);
+}
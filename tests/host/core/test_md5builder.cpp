@@ -51,6 +51,25 @@ TEST_CASE("MD5Builder::addHexString works as expected", "[core][MD5Builder]")
       builder.calculate();
       REQUIRE(builder.toString() == "47b937a6f9f12a4c389fa5854e023efb");
     }
+
+    WHEN("An invalid digit or a lone last digit ends the data"){
+      // 72 valid digits, across the 64 digit blocks
+      String valid("1234567890abcdeffedcba98765432106469676974616c7369676e61747572656170706c");
+      MD5Builder builder;
+      builder.begin();
+      builder.addHexString(valid);
+      builder.calculate();
+      MD5Builder invalid;
+      invalid.begin();
+      invalid.addHexString(valid + "6x69636174696f6e73");
+      invalid.calculate();
+      REQUIRE(invalid.toString() == builder.toString());
+      MD5Builder odd;
+      odd.begin();
+      odd.addHexString(valid + "6");
+      odd.calculate();
+      REQUIRE(odd.toString() == builder.toString());
+    }
 }
 
 TEST_CASE("MD5Builder::addStream works", "[core][MD5Builder]"){
@@ -18,6 +18,7 @@
 #include <WString.h>
 #include <limits.h>
 #include <StreamString.h>
+#include <StringBuilder.h>
 
 TEST_CASE("String::trim", "[core][String]")
 {
@@ -528,3 +529,66 @@ TEST_CASE("Replace and string expansion", "[core][String]")
     REQUIRE(l.length() == strlen(buff));
   }
 }
+
+TEST_CASE("String grows geometrically and shrinks to fit", "[core][String]")
+{
+  String s;
+  const char *last = s.c_str();
+  int moves = 0;
+  for (int i = 0; i < 4096; i++) {
+    s += (char)('a' + i % 26);
+    if (s.c_str() != last) {
+      moves++;
+      last = s.c_str();
+    }
+  }
+  REQUIRE(s.length() == 4096);
+  REQUIRE(moves < 40);
+  for (int i = 0; i < 4096; i++)
+    REQUIRE(s[i] == (char)('a' + i % 26));
+  s.shrink_to_fit();
+  REQUIRE(s.length() == 4096);
+  REQUIRE(s[4095] == (char)('a' + 4095 % 26));
+  REQUIRE(s.c_str()[4096] == 0);
+  // Back into SSO
+  s.remove(5);
+  s.shrink_to_fit();
+  REQUIRE(s == "abcde");
+  s += "fghijklmnopqrstuvwxyz";
+  REQUIRE(s == "abcdefghijklmnopqrstuvwxyz");
+  String t;
+  t.shrink_to_fit();
+  REQUIRE(t == "");
+}
+
+TEST_CASE("StringBuilder", "[core][String]")
+{
+  StringBuilder b(16);
+  REQUIRE(b.length() == 0);
+  REQUIRE(b.toString() == "");
+  b += "Hello";
+  b += ',';
+  b += String(" world ");
+  b.print(42);
+  b.print(F(" items"));
+  REQUIRE(b.toString() == "Hello, world 42 items");
+  REQUIRE(b.length() == 21);
+  StreamString out;
+  REQUIRE(b.printTo(out) == 21);
+  REQUIRE(out == "Hello, world 42 items");
+  b.clear();
+  REQUIRE(b.length() == 0);
+  String ref;
+  for (int i = 0; i < 1000; i++) {
+    b.print(i);
+    ref += i;
+  }
+  REQUIRE(b.length() == ref.length());
+  REQUIRE(b.toString() == ref);
+  const uint8_t nuls[] = { 'a', 0, 'b' };
+  StringBuilder n;
+  n.write(nuls, sizeof(nuls));
+  String withNul = n.toString();
+  REQUIRE(withNul.length() == 3);
+  REQUIRE(!memcmp(withNul.c_str(), nuls, 3));
+}
@@ -0,0 +1,154 @@
+/*
+ test_task_profiler.cpp - cooperative task profiler tests
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <StreamString.h>
+
+// The profiler is only built with CORE_TASK_PROFILER, it is driven here by
+// hand with a fake cycle counter instead of the core's hooks
+static uint32_t cycles;
+#define TASK_PROFILER_CYCLES() cycles
+#define CORE_TASK_PROFILER
+#include "../../../cores/esp8266/task_profiler.cpp"
+
+static void cleanup()
+{
+    task_profiler_reset();
+    _taskCount = 0;
+    _running = false;
+    REQUIRE(_depth == 0);
+}
+
+TEST_CASE("Task profiler charges own time to tasks and contexts", "[core][task_profiler]")
+{
+    const uint32_t us = clockCyclesPerMicrosecond();
+    task_profiler_task_t contexts[TASK_PROFILER_CONTEXTS];
+    task_profiler_task_t tasks[4];
+
+    // loop() with a named task waiting 300us in yield()
+    cycles = 1000;
+    task_profiler_resume(TASK_PROFILER_SYS); // first loop(), nothing to charge
+    task_profiler_begin(TASK_PROFILER_LOOP, nullptr, 0, 0);
+    cycles += 100 * us;
+    {
+        TaskProfilerScope scope("mqtt");
+        cycles += 50 * us;
+        task_profiler_suspend(TASK_PROFILER_YIELD);
+        cycles += 300 * us;
+        task_profiler_resume(TASK_PROFILER_YIELD);
+        cycles += 20 * us;
+    }
+    task_profiler_end();
+
+    // loop_end(): two calls of the same scheduled function, run late
+    task_profiler_begin(TASK_PROFILER_SCHEDULED, nullptr, 0x40201000, 700);
+    cycles += 10 * us;
+    task_profiler_end();
+    task_profiler_begin(TASK_PROFILER_SCHEDULED, nullptr, 0x40201000, 200);
+    cycles += 30 * us;
+    task_profiler_end();
+    task_profiler_suspend(TASK_PROFILER_SYS);
+    cycles += 1000 * us;
+    task_profiler_resume(TASK_PROFILER_SYS);
+
+    task_profiler_contexts(contexts);
+    REQUIRE(contexts[TASK_PROFILER_LOOP].name == std::string("loop"));
+    REQUIRE(contexts[TASK_PROFILER_LOOP].calls == 2);
+    REQUIRE(contexts[TASK_PROFILER_LOOP].cycles == 170 * us);
+    REQUIRE(contexts[TASK_PROFILER_LOOP].max_cycles == 470 * us);
+    REQUIRE(contexts[TASK_PROFILER_YIELD].calls == 1);
+    REQUIRE(contexts[TASK_PROFILER_YIELD].cycles == 300 * us);
+    // CONT ran 150us before yielding, then 20 + 40us before returning
+    REQUIRE(contexts[TASK_PROFILER_YIELD].max_latency == 150);
+    REQUIRE(contexts[TASK_PROFILER_SYS].max_latency == 60);
+    REQUIRE(contexts[TASK_PROFILER_SYS].cycles == 1000 * us);
+    REQUIRE(contexts[TASK_PROFILER_SCHEDULED].calls == 2);
+    REQUIRE(contexts[TASK_PROFILER_SCHEDULED].cycles == 40 * us);
+    REQUIRE(contexts[TASK_PROFILER_SCHEDULED].max_latency == 700);
+
+    REQUIRE(task_profiler_snapshot(tasks, 4) == 2);
+    REQUIRE(tasks[0].name == std::string("mqtt"));
+    REQUIRE(tasks[0].context == TASK_PROFILER_LOOP);
+    REQUIRE(tasks[0].cycles == 70 * us);
+    REQUIRE(tasks[0].max_cycles == 370 * us);
+    REQUIRE(tasks[1].where == 0x40201000);
+    REQUIRE(tasks[1].calls == 2);
+    REQUIRE(tasks[1].max_cycles == 30 * us);
+    REQUIRE(tasks[1].max_latency == 700);
+
+    task_profiler_reset();
+    REQUIRE(task_profiler_snapshot(tasks, 4) == 2);
+    REQUIRE(tasks[1].calls == 0);
+    REQUIRE(tasks[1].cycles == 0);
+    task_profiler_contexts(contexts);
+    REQUIRE(contexts[TASK_PROFILER_LOOP].cycles == 0);
+
+    cleanup();
+}
+
+TEST_CASE("Task profiler overflows into the other task", "[core][task_profiler]")
+{
+    task_profiler_task_t tasks[TASK_PROFILER_TASKS];
+
+    for (int i = 0; i < TASK_PROFILER_TASKS + 4; i++) {
+        task_profiler_begin(TASK_PROFILER_RECURRENT, nullptr, 0x40200000 + 4 * i, 0);
+        cycles += 1;
+        task_profiler_end();
+    }
+    REQUIRE(task_profiler_snapshot(tasks, TASK_PROFILER_TASKS) == TASK_PROFILER_TASKS);
+    REQUIRE(tasks[TASK_PROFILER_TASKS - 2].where == 0x40200000 + 4 * (TASK_PROFILER_TASKS - 2));
+    REQUIRE(tasks[TASK_PROFILER_TASKS - 1].where == 0);
+    REQUIRE(tasks[TASK_PROFILER_TASKS - 1].calls == 5);
+
+    // Tasks nested too deep are not counted, but the stack stays balanced
+    for (int i = 0; i < TASK_PROFILER_DEPTH + 2; i++) {
+        task_profiler_begin(TASK_PROFILER_RECURRENT, nullptr, 0x40200000, 0);
+    }
+    for (int i = 0; i < TASK_PROFILER_DEPTH + 2; i++) {
+        task_profiler_end();
+    }
+    REQUIRE(tasks[0].calls == 1);
+    REQUIRE(task_profiler_snapshot(tasks, 1) == 1);
+    REQUIRE(tasks[0].calls == 1 + TASK_PROFILER_DEPTH);
+
+    cleanup();
+}
+
+TEST_CASE("Task profiler report", "[core][task_profiler]")
+{
+    const uint32_t us = clockCyclesPerMicrosecond();
+    StreamString out;
+
+    task_profiler_begin(TASK_PROFILER_LOOP, nullptr, 0, 0);
+    cycles += 2000 * us;
+    task_profiler_end();
+    task_profiler_begin(TASK_PROFILER_RECURRENT, nullptr, 0x40204a1c, 15);
+    cycles += 3000 * us;
+    task_profiler_end();
+    task_profiler_begin(TASK_PROFILER_SCHEDULED, "ota", 0, 0);
+    cycles += 1000 * us;
+    task_profiler_end();
+    task_profiler_report(out);
+    REQUIRE(out ==
+            "   calls    own ms   max us   lat us context   task\r\n"
+            "       1         2     2000        0 loop\r\n"
+            "       1         1     1000        0 scheduled\r\n"
+            "       1         3     3000       15 recurrent\r\n"
+            "       0         0        0        0 yield\r\n"
+            "       0         0        0        0 sys\r\n"
+            "       1         3     3000       15 recurrent 0x40204a1c\r\n"
+            "       1         1     1000        0 scheduled ota\r\n");
+    cleanup();
+}
@@ -0,0 +1,168 @@
+/*
+ test_uart.cpp - UART tx buffer tests
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <map>
+#include <string>
+
+// The real uart.cpp runs on fake registers: the tx fifo takes what is
+// written to USF, and sends one byte every 4 reads of the status.
+// Its functions are renamed, MockUART provides the usual ones.
+#undef RANDOM_REG32
+#include "../../../cores/esp8266/esp8266_peri.h"
+#include <ets_sys.h>
+
+static std::string fifo;
+static std::string wire;
+static bool withinISR;
+static int yields;
+static int statusReads;
+
+// UART1
+static const uint32_t USF_ADDR = 0xf00;
+static const uint32_t USS_ADDR = 0xf1c;
+
+struct FakeReg
+{
+    uint32_t addr;
+    uint32_t value;
+
+    operator uint32_t ()
+    {
+        if (addr == USS_ADDR) {
+            // One byte left the fifo meanwhile
+            if (++statusReads % 4 == 0 && !fifo.empty()) {
+                wire += fifo[0];
+                fifo.erase(0, 1);
+            }
+            return fifo.size() << USTXC;
+        }
+        return value;
+    }
+    FakeReg& operator= (uint64_t v)
+    {
+        if (addr == USF_ADDR) {
+            REQUIRE(fifo.size() < 0x80);
+            fifo += (char)v;
+        }
+        value = v;
+        return *this;
+    }
+    FakeReg& operator|= (uint64_t v) { value |= v; return *this; }
+    FakeReg& operator&= (uint64_t v) { value &= v; return *this; }
+};
+
+static FakeReg& fakeReg(uint32_t addr)
+{
+    static std::map<uint32_t, FakeReg> regs;
+    FakeReg& reg = regs[addr];
+    reg.addr = addr;
+    return reg;
+}
+
+#undef ESP8266_REG
+#define ESP8266_REG(addr) fakeReg(addr)
+#undef ETS_UART_INTR_ATTACH
+#define ETS_UART_INTR_ATTACH(func, arg) (void)(func)
+#undef ETS_UART_INTR_ENABLE
+#define ETS_UART_INTR_ENABLE()
+#undef ETS_UART_INTR_DISABLE
+#define ETS_UART_INTR_DISABLE()
+#define UART_TX_CAN_YIELD() (!withinISR)
+#define optimistic_yield(us) (void)(us), yields++
+#define esp_get_cycle_count() 0
+
+#define uart_init test_uart_init
+#define uart_uninit test_uart_uninit
+#define uart_write test_uart_write
+#define uart_write_char test_uart_write_char
+#define uart_resize_tx_buffer test_uart_resize_tx_buffer
+#define uart_get_tx_buffer_size test_uart_get_tx_buffer_size
+#define uart_tx_free test_uart_tx_free
+#define uart_wait_tx_empty test_uart_wait_tx_empty
+#define uart_flush test_uart_flush
+#define uart_swap test_uart_swap
+#define uart_set_tx test_uart_set_tx
+#define uart_set_pins test_uart_set_pins
+#define uart_tx_enabled test_uart_tx_enabled
+#define uart_rx_enabled test_uart_rx_enabled
+#define uart_set_baudrate test_uart_set_baudrate
+#define uart_get_baudrate test_uart_get_baudrate
+#define uart_resize_rx_buffer test_uart_resize_rx_buffer
+#define uart_get_rx_buffer_size test_uart_get_rx_buffer_size
+#define uart_set_rx_thresholds test_uart_set_rx_thresholds
+#define uart_peek_char test_uart_peek_char
+#define uart_read_char test_uart_read_char
+#define uart_read test_uart_read
+#define uart_rx_available test_uart_rx_available
+#define uart_has_overrun test_uart_has_overrun
+#define uart_has_rx_error test_uart_has_rx_error
+#define uart_get_rx_stats test_uart_get_rx_stats
+#define uart_reset_rx_stats test_uart_reset_rx_stats
+#define uart_set_debug test_uart_set_debug
+#define uart_get_debug test_uart_get_debug
+#define uart_start_detect_baudrate test_uart_start_detect_baudrate
+#define uart_detect_baudrate test_uart_detect_baudrate
+#define uart_get_bit_length test_uart_get_bit_length
+// uart.h was already seen under the usual names
+extern "C" size_t uart_read(uart_t* uart, char* buffer, size_t size);
+#include "../../../cores/esp8266/uart.cpp"
+
+extern "C" bool gdbstub_has_uart_isr_control(void) { return false; }
+extern "C" void gdbstub_set_uart_isr_callback(void (*)(void*, uint8_t), void*) {}
+extern "C" void gdbstub_set_putc1_callback(void (*)(char)) {}
+extern "C" bool gdbstub_has_putc1_control(void) { return false; }
+extern "C" void uart_buff_switch(uint8) {}
+extern "C" void system_set_os_print(uint8) {}
+extern "C" void ets_install_putc1(fp_putc_t) {}
+extern "C" int uart_baudrate_detect(int, int) { return 0; }
+
+TEST_CASE("UART tx buffer full", "[core][uart]")
+{
+    uart_t* uart = uart_init(UART1, 115200, UART_8N1, UART_TX_ONLY, 2, 0, false);
+    REQUIRE(uart);
+    REQUIRE(uart_resize_tx_buffer(uart, 16) == 16);
+
+    std::string sent;
+    for (int i = 0; i < 300; i++) {
+        sent += (char)('a' + i % 26);
+    }
+
+    SECTION("from CONT, yields while the ring is full") {
+        withinISR = false;
+        yields = 0;
+        REQUIRE(uart_write(uart, sent.c_str(), sent.size()) == sent.size());
+        REQUIRE(yields > 0);
+    }
+    SECTION("from an ISR, only spins on the fifo") {
+        withinISR = true;
+        yields = 0;
+        REQUIRE(uart_write(uart, sent.c_str(), sent.size()) == sent.size());
+        REQUIRE(yields == 0);
+        for (int i = 0; i < 20; i++) {
+            REQUIRE(uart_write_char(uart, '!') == 1);
+        }
+        sent += std::string(20, '!');
+        REQUIRE(yields == 0);
+    }
+
+    // What is still buffered goes out with the fifo
+    while (!fifo.empty() || uart->tx_buffer->rpos != uart->tx_buffer->wpos) {
+        uart_tx_copy_buffer_to_fifo_unsafe(uart);
+    }
+    REQUIRE(wire == sent);
+    wire.clear();
+    uart_uninit(uart);
+}
@@ -0,0 +1,112 @@
+/*
+ test_umm_malloc.cpp - umm_malloc size class tests
+ Copyright (c) 2019 esp8266/Arduino community. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <string.h>
+
+// The firmware's umm_malloc on a 64KB test heap, renamed like in bench_umm
+#define ets_memcpy  memcpy
+#define ets_memmove memmove
+#define ets_memset  memset
+#define ets_strcpy  strcpy
+#define ets_strlen  strlen
+#define ets_vprintf(putc, fmt, ap) vprintf(fmt, ap)
+#define ets_uart_printf printf
+
+#define TEST_BUILD
+#define malloc  test_umm_malloc
+#define calloc  test_umm_calloc
+#define realloc test_umm_realloc
+#define free    test_umm_free
+// Its statistics print size_t with %u, as on the chip
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat"
+#include "../../../cores/esp8266/umm_malloc/umm_malloc.cpp"
+#pragma GCC diagnostic pop
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+
+char test_umm_heap[UMM_MALLOC_CFG_HEAP_SIZE];
+int umm_critical_depth;
+int umm_max_critical_depth;
+
+TEST_CASE("umm_malloc size classes", "[core][umm_malloc]")
+{
+    umm_init();
+    umm_info(NULL, 0);
+    const UMM_HEAP_INFO empty = ummHeapInfo;
+    REQUIRE(empty.usedEntries == 0);
+    REQUIRE(empty.freeEntries == 1);
+
+    SECTION("a freed small block serves the next malloc of its size") {
+        void* p = test_umm_malloc(20);
+        REQUIRE(p);
+        test_umm_free(p);
+        void* other = test_umm_malloc(40);
+        REQUIRE(other != p);
+        REQUIRE(test_umm_malloc(20) == p);
+        test_umm_free(p);
+        test_umm_free(other);
+    }
+    SECTION("realloc keeps the data through the cache") {
+        char* p = (char*)test_umm_malloc(16);
+        REQUIRE(p);
+        memcpy(p, "0123456789abcde", 16);
+        // The block left behind goes to the cache
+        char* grown = (char*)test_umm_realloc(p, 200);
+        REQUIRE(grown);
+        REQUIRE(memcmp(grown, "0123456789abcde", 16) == 0);
+        char* shrunk = (char*)test_umm_realloc(grown, 16);
+        REQUIRE(shrunk);
+        REQUIRE(memcmp(shrunk, "0123456789abcde", 16) == 0);
+        test_umm_free(shrunk);
+    }
+    SECTION("cached blocks coalesce once flushed") {
+        void* p[64];
+        for (int i = 0; i < 64; i++) {
+            p[i] = test_umm_malloc(8 + i % 8 * 8);
+            REQUIRE(p[i]);
+        }
+        for (int i = 0; i < 64; i++) {
+            test_umm_free(p[i]);
+        }
+        // Some are cached, still counted as used by the heap
+        REQUIRE(umm_size_class_head[umm_blocks(8)]);
+    }
+    SECTION("umm_init() forgets the cached blocks") {
+        test_umm_free(test_umm_malloc(20));
+        REQUIRE(umm_size_class_head[umm_blocks(20)]);
+        umm_init();
+        REQUIRE(test_umm_malloc(20));
+        umm_info(NULL, 0);
+        REQUIRE(ummHeapInfo.usedEntries == 1);
+        umm_init();
+    }
+
+    // umm_info() flushes the cache: everything is free in one block again
+    umm_info(NULL, 0);
+    REQUIRE(ummHeapInfo.usedEntries == 0);
+    REQUIRE(ummHeapInfo.freeEntries == 1);
+    REQUIRE(ummHeapInfo.freeBlocks == empty.freeBlocks);
+    REQUIRE(ummHeapInfo.totalBlocks == empty.totalBlocks);
+    REQUIRE(ummHeapInfo.maxFreeContiguousBlocks == empty.maxFreeContiguousBlocks);
+    REQUIRE(umm_free_heap_size() == empty.freeBlocks * sizeof(umm_block));
+    for (int i = 1; i <= UMM_SIZE_CLASS_BLOCKS; i++) {
+        REQUIRE(umm_size_class_head[i] == 0);
+        REQUIRE(umm_size_class_count[i] == 0);
+    }
+}
@@ -0,0 +1,282 @@
+/*
+ bench_fs.cpp - filesystem benchmarks for host side testing
+ Copyright (c) 2019 Earle F. Philhower, III
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+// Runs the same workloads on every filesystem through the fs::FS API and
+// prints one JSON object per line:
+//   {"fs":"LittleFS","test":"seq_write","ops":256,"bytes":65536,"us":1234,
+//    "io":"flash","reads":...,"writes":...,"erases":...,"read_bytes":...,"write_bytes":...}
+// SPIFFS and LittleFS count operations of the emulated flash HAL, SDFS counts
+// the file level reads and writes reaching SdFat. Lines not starting with
+// "{" come from the mocks and can be ignored.
+
+#include <chrono>
+#include <FS.h>
+#include "../common/spiffs_mock.h"
+#include "../common/littlefs_mock.h"
+#include "../common/sdfs_mock.h"
+#include <spiffs/spiffs.h>
+#include <LittleFS.h>
+#include "../../../libraries/SDFS/src/SDFS.h"
+
+#define FS_KB       512     // size of the emulated filesystem
+#define FILE_SIZE   65536   // sequential and random workloads
+#define CHUNK       256
+#define RANDOM_OPS  1000
+#define RECORDS     500     // append workload
+#define RECORD_SIZE 32
+#define FILES       40      // create/delete, listing and rename workloads
+
+struct Counters
+{
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t erases;
+    uint64_t readBytes;
+    uint64_t writeBytes;
+};
+
+class Bench
+{
+public:
+    Bench (const char* name, FS& fs, sdfs::SDFSImpl* sd = nullptr): _name(name), _fs(fs), _sd(sd) { }
+
+    void run ()
+    {
+        seqWrite();
+        seqRead();
+        randomRead();
+        appendRecords();
+        createDelete();
+        listDir();
+        rename();
+    }
+
+protected:
+    Counters counters ()
+    {
+        Counters c;
+        if (_sd)
+        {
+            const SDFSStats& s = _sd->getStats();
+            c = { s.readCalls, s.writeCalls, 0, s.bytesRead, s.bytesWritten };
+        }
+        else
+            c = { s_phys_stats.reads, s_phys_stats.writes, s_phys_stats.erases, s_phys_stats.readBytes, s_phys_stats.writeBytes };
+        return c;
+    }
+
+    void start ()
+    {
+        _start = counters();
+        _t0 = std::chrono::steady_clock::now();
+    }
+
+    void report (const char* test, size_t ops, size_t bytes)
+    {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _t0).count();
+        Counters c = counters();
+        printf("{\"fs\":\"%s\",\"test\":\"%s\",\"ops\":%zu,\"bytes\":%zu,\"us\":%lld,\"io\":\"%s\","
+               "\"reads\":%llu,\"writes\":%llu,\"erases\":%llu,\"read_bytes\":%llu,\"write_bytes\":%llu}\n",
+               _name, test, ops, bytes, (long long)us, _sd ? "file" : "flash",
+               (unsigned long long)(c.reads - _start.reads),
+               (unsigned long long)(c.writes - _start.writes),
+               (unsigned long long)(c.erases - _start.erases),
+               (unsigned long long)(c.readBytes - _start.readBytes),
+               (unsigned long long)(c.writeBytes - _start.writeBytes));
+        fflush(stdout);
+    }
+
+    static void fill (uint8_t* buf, size_t len, uint32_t seed)
+    {
+        for (size_t i = 0; i < len; i++)
+            buf[i] = (seed + i) * 2654435761u >> 24;
+    }
+
+    void seqWrite ()
+    {
+        uint8_t buf[CHUNK];
+        start();
+        File f = _fs.open("/seq.bin", "w");
+        size_t done = 0;
+        for (size_t i = 0; i < FILE_SIZE / CHUNK; i++)
+        {
+            fill(buf, sizeof(buf), i);
+            done += f.write(buf, sizeof(buf));
+        }
+        f.close();
+        report("seq_write", FILE_SIZE / CHUNK, done);
+    }
+
+    void seqRead ()
+    {
+        uint8_t buf[CHUNK];
+        start();
+        File f = _fs.open("/seq.bin", "r");
+        size_t done = 0, ops = 0;
+        while (f.available())
+        {
+            done += f.read(buf, sizeof(buf));
+            ops++;
+        }
+        f.close();
+        report("seq_read", ops, done);
+    }
+
+    void randomRead ()
+    {
+        uint8_t buf[64];
+        uint32_t seed = 1;
+        start();
+        File f = _fs.open("/seq.bin", "r");
+        size_t done = 0;
+        for (int i = 0; i < RANDOM_OPS; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            f.seek((seed >> 8) % (FILE_SIZE - sizeof(buf)), SeekSet);
+            done += f.read(buf, sizeof(buf));
+        }
+        f.close();
+        report("random_read", RANDOM_OPS, done);
+    }
+
+    void appendRecords ()
+    {
+        uint8_t buf[RECORD_SIZE];
+        start();
+        size_t done = 0;
+        for (int i = 0; i < RECORDS; i++)
+        {
+            fill(buf, sizeof(buf), i);
+            File f = _fs.open("/log.bin", "a");
+            done += f.write(buf, sizeof(buf));
+            f.close();
+        }
+        report("append_small_records", RECORDS, done);
+    }
+
+    void createDelete ()
+    {
+        char name[32];
+        start();
+        for (int i = 0; i < FILES; i++)
+        {
+            snprintf(name, sizeof(name), "/tmp%d.txt", i);
+            File f = _fs.open(name, "w");
+            f.print(name);
+            f.close();
+        }
+        for (int i = 0; i < FILES; i++)
+        {
+            snprintf(name, sizeof(name), "/tmp%d.txt", i);
+            _fs.remove(name);
+        }
+        report("create_delete", 2 * FILES, 0);
+    }
+
+    void listDir ()
+    {
+        char name[32];
+        for (int i = 0; i < FILES; i++)
+        {
+            snprintf(name, sizeof(name), "/dir/f%d.txt", i);
+            File f = _fs.open(name, "w");
+            f.print(name);
+            f.close();
+        }
+        start();
+        size_t entries = 0;
+        for (int i = 0; i < 10; i++)
+        {
+            Dir dir = _fs.openDir("/dir");
+            while (dir.next())
+                entries++;
+        }
+        report("dir_list", entries, 0);
+    }
+
+    void rename ()
+    {
+        char from[32], to[32];
+        start();
+        for (int i = 0; i < FILES; i++)
+        {
+            snprintf(from, sizeof(from), "/dir/f%d.txt", i);
+            snprintf(to, sizeof(to), "/dir/g%d.txt", i);
+            _fs.rename(from, to);
+        }
+        report("rename", FILES, 0);
+    }
+
+    const char* _name;
+    FS& _fs;
+    sdfs::SDFSImpl* _sd;
+    Counters _start;
+    std::chrono::steady_clock::time_point _t0;
+};
+
+// A filesystem that doesn't mount is a failure, not a missing row
+static void mountFailed (const char* name)
+{
+    printf("{\"fs\":\"%s\",\"test\":\"begin\",\"error\":\"begin() failed\"}\n", name);
+}
+
+static bool benchSpiffs ()
+{
+    SPIFFS_MOCK_DECLARE(FS_KB, 8, 256, "");
+    bool ok = SPIFFS.begin();
+    if (ok)
+        Bench("SPIFFS", SPIFFS).run();
+    else
+        mountFailed("SPIFFS");
+    SPIFFS.end();
+    return ok;
+}
+
+static bool benchLittleFS ()
+{
+    LITTLEFS_MOCK_DECLARE(FS_KB, 8, 256, "");
+    bool ok = LittleFS.begin();
+    if (ok)
+        Bench("LittleFS", LittleFS).run();
+    else
+        mountFailed("LittleFS");
+    LittleFS.end();
+    return ok;
+}
+
+static bool benchSDFS ()
+{
+    SDFS_MOCK_DECLARE(FS_KB, 8, 512, "");
+    bool ok = SDFS.begin();
+    if (ok)
+    {
+        sdfs::SDFSImpl* sd = static_cast<sdfs::SDFSImpl*>(SDFS.getImpl().get());
+        sd->resetStats();
+        Bench("SDFS", SDFS, sd).run();
+    }
+    else
+        mountFailed("SDFS");
+    SDFS.end();
+    return ok;
+}
+
+int main ()
+{
+    // All of them run, the exit status tells if one could not
+    bool ok = benchSpiffs();
+    ok = benchLittleFS() && ok;
+    ok = benchSDFS() && ok;
+    return ok ? 0 : 1;
+}
@@ -125,6 +125,43 @@ TEST_CASE("SDFS checks the config object passed in", "[fs]")
     REQUIRE_FALSE(SDFS.setConfig(l));
 }
 
+TEST_CASE("SDFS buffered small reads and writes", "[fs]")
+{
+    SDFS_MOCK_DECLARE(64, 8, 512, "");
+    REQUIRE(SDFS.setConfig(SDFSConfig().setAutoFormat(true).setBuffer(2048)));
+    REQUIRE(SDFS.begin());
+    sdfs::SDFSImpl* sd = static_cast<sdfs::SDFSImpl*>(SDFS.getImpl().get());
+    sd->resetStats();
+
+    File f = SDFS.open("/log.bin", "w");
+    for (uint32_t i = 0; i < 1000; i++) {
+        REQUIRE(f.write((const uint8_t*)&i, sizeof(i)) == sizeof(i));
+        REQUIRE(f.position() == (i + 1) * sizeof(i));
+        REQUIRE(f.size() == (i + 1) * sizeof(i));
+    }
+    f.close();
+    REQUIRE(sd->getStats().bytesWritten == 4000);
+    REQUIRE(sd->getStats().writeCalls < 10);
+
+    f = SDFS.open("/log.bin", "r+");
+    uint32_t v;
+    for (uint32_t i = 0; i < 500; i++) {
+        REQUIRE(f.read((uint8_t*)&v, sizeof(v)) == sizeof(v));
+        REQUIRE(v == i);
+    }
+    REQUIRE(f.position() == 2000);
+    // Writing after reading ahead lands at the reader's position
+    v = 0xdeadbeef;
+    REQUIRE(f.write((const uint8_t*)&v, sizeof(v)) == sizeof(v));
+    REQUIRE(f.read((uint8_t*)&v, sizeof(v)) == sizeof(v));
+    REQUIRE(v == 501);
+    REQUIRE(f.seek(-8, SeekCur));
+    REQUIRE(f.read((uint8_t*)&v, sizeof(v)) == sizeof(v));
+    REQUIRE(v == 0xdeadbeef);
+    f.close();
+    REQUIRE(sd->getStats().bytesRead > 0);
+}
+
 // Also a SD specific test to check that FILE_OPEN is really an append operation:
 
 TEST_CASE("SD.h FILE_WRITE macro is append", "[fs]")
@@ -50,6 +50,9 @@
 #define pgm_read_dword_far(addr)        pgm_read_dword(addr)
 #define pgm_read_float_far(addr)        pgm_read_float(addr)
 #define pgm_read_ptr_far(addr)          pgm_read_ptr(addr)
+#define pgm_read_dword_aligned(addr)    pgm_read_dword(addr)
+#define pgm_read_float_aligned(addr)    pgm_read_float(addr)
+#define pgm_read_ptr_aligned(addr)      pgm_read_ptr(addr)
 
 // Wrapper inlines for _P functions
 #include <stdio.h>
@@ -57,6 +60,7 @@
 inline const char *strstr_P(const char *haystack, const char *needle) { return strstr(haystack, needle); }
 inline char *strcpy_P(char *dest, const char *src) { return strcpy(dest, src); }
 inline size_t strlen_P(const char *s) { return strlen(s); }
+inline size_t strnlen_P(const char *s, size_t n) { return strnlen(s, n); }
 inline int vsnprintf_P(char *str, size_t size, const char *format, va_list ap) { return vsnprintf(str, size, format, ap); }
 
 #define memcpy_P memcpy
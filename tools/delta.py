@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# Generate a delta patch applied by the Updater against the running sketch.
+# The patch can be sent through any OTA method (ArduinoOTA, ESP8266httpUpdate,
+# ESP8266HTTPUpdateServer) in place of the full binary.
+#
+# Format (little endian), see cores/esp8266/Updater.cpp:
+#   header: magic "\xd1DLT", u32 old size, u32 new size,
+#           MD5 of the old image with bytes 2 and 3 set to zero,
+#           MD5 of the new image
+#   commands: 'C' u32 offset, u32 length   copy from the old image
+#             'D' u32 length, data         literal bytes
+#
+import argparse
+import hashlib
+import struct
+import sys
+
+MAGIC = b'\xd1DLT'
+KEY = 8          # bytes used to look up a match in the old image
+MIN_COPY = 24    # shorter matches cost more than the literal bytes
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Delta OTA patch generator')
+    parser.add_argument('-o', '--old', required=True, help='Binary running on the device')
+    parser.add_argument('-n', '--new', required=True, help='New binary')
+    parser.add_argument('-p', '--patch', required=True, help='Output patch file')
+    return parser.parse_args()
+
+def match_length(old, o, new, n):
+    length = 0
+    limit = min(len(old) - o, len(new) - n)
+    while length < limit and old[o + length] == new[n + length]:
+        length += 1
+    return length
+
+def diff(old, new):
+    """Returns a list of ('C', offset, length) and ('D', bytes) commands."""
+    # Bytes 2 and 3 (flash mode and size) of the running image may have been
+    # rewritten when it was flashed, they are never copied
+    index = {}
+    for o in range(len(old) - KEY, 3, -1):
+        index[old[o:o + KEY]] = o
+
+    commands = []
+    literal_start = 0
+    shift = None  # old - new offset of the last copy
+    n = 0
+    while n < len(new):
+        best_o, best_len = None, 0
+        if shift is not None and 4 <= n + shift < len(old):
+            best_len = match_length(old, n + shift, new, n)
+            best_o = n + shift
+        if best_len < MIN_COPY:
+            o = index.get(bytes(new[n:n + KEY]))
+            if o is not None:
+                length = match_length(old, o, new, n)
+                if length > best_len:
+                    best_o, best_len = o, length
+        if best_len >= MIN_COPY:
+            if literal_start < n:
+                commands.append(('D', new[literal_start:n]))
+            commands.append(('C', best_o, best_len))
+            shift = best_o - n
+            n += best_len
+            literal_start = n
+        else:
+            n += 1
+    if literal_start < len(new):
+        commands.append(('D', new[literal_start:]))
+    return commands
+
+def old_md5(old):
+    data = bytearray(old)
+    data[2:4] = b'\x00\x00'
+    return hashlib.md5(data).digest()
+
+def make_patch(old, new):
+    out = bytearray(MAGIC)
+    out += struct.pack('<II', len(old), len(new))
+    out += old_md5(old)
+    out += hashlib.md5(new).digest()
+    for cmd in diff(old, new):
+        if cmd[0] == 'C':
+            out += b'C' + struct.pack('<II', cmd[1], cmd[2])
+        else:
+            out += b'D' + struct.pack('<I', len(cmd[1])) + cmd[1]
+    return out
+
+def main():
+    args = parse_args()
+    with open(args.old, 'rb') as f:
+        old = f.read()
+    with open(args.new, 'rb') as f:
+        new = f.read()
+    patch = make_patch(old, new)
+    with open(args.patch, 'wb') as f:
+        f.write(patch)
+    sys.stderr.write("Delta patch: " + args.patch + " " + str(len(patch)) + " bytes (" +
+                     str(len(new)) + " bytes image, " + str(100 * len(patch) // max(len(new), 1)) + "%)\n")
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())